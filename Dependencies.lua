@@ -55,4 +55,30 @@ Library["SPIRV_Cross_GLSL_Release"] = "%{LibraryDir.VulkanSDK}/spirv-cross-glsl.
 SharedLibrary = {}
 SharedLibrary["optick"] = "%{LibraryDir.optick}/OptickCore.dll"
 SharedLibrary["shaderc_Release"] = "%{LibraryDir.VulkanSDK_DebugDLL}/shaderc_shared.dll"
-SharedLibrary["shaderc_Debug"] = "%{LibraryDir.VulkanSDK_DebugDLL}/shaderc_sharedd.dll"
\ No newline at end of file
+SharedLibrary["shaderc_Debug"] = "%{LibraryDir.VulkanSDK_DebugDLL}/shaderc_sharedd.dll"
+
+if os.target() == "linux" then
+	-- The Linux SDK uses lowercase directories and ships no separate debug builds of shaderc or SPIRV-Cross
+	IncludeDir["VulkanSDK"] = "%{VULKAN_SDK}/include"
+
+	LibraryDir["VulkanSDK"] = "%{VULKAN_SDK}/lib"
+	LibraryDir["VulkanSDK_Debug"] = "%{VULKAN_SDK}/lib"
+	LibraryDir["VulkanSDK_DebugDLL"] = "%{VULKAN_SDK}/lib"
+
+	Library["optick"] = "OptickCore"
+
+	Library["Vulkan"] = "vulkan"
+
+	Library["ShaderC_Debug"] = "shaderc_shared"
+	Library["SPIRV_Cross_Debug"] = "spirv-cross-core"
+	Library["SPIRV_Cross_GLSL_Debug"] = "spirv-cross-glsl"
+	Library["SPIRV_Tools_Debug"] = "SPIRV-Tools"
+
+	Library["ShaderC_Release"] = "shaderc_shared"
+	Library["SPIRV_Cross_Release"] = "spirv-cross-core"
+	Library["SPIRV_Cross_GLSL_Release"] = "spirv-cross-glsl"
+
+	SharedLibrary["optick"] = "%{LibraryDir.optick}/libOptickCore.so"
+	SharedLibrary["shaderc_Release"] = "%{LibraryDir.VulkanSDK}/libshaderc_shared.so.1"
+	SharedLibrary["shaderc_Debug"] = "%{LibraryDir.VulkanSDK}/libshaderc_shared.so.1"
+end
@@ -42,9 +42,7 @@ void AccelerationStructureExample::OnAttach()
 		),
 		{
 			{"TLAS", ResourceType::AccelerationStructure, ShaderType::Defaults::RayGeneration, m_TopLevelAS, 0, 0},
-			{"storage", ResourceType::StorageImage, ShaderType::Defaults::RayGeneration, storageImage, 0, 1, {
-				ImageLayout::Undefined, ImageLayout::General,
-			}},
+			{"storage", ResourceType::StorageImage, ShaderType::Defaults::RayGeneration, storageImage, 0, 1},
 			{"storage", ResourceType::Uniform, ShaderType::Defaults::RayGeneration, m_ViewProjection, 0, 2},
 		},
 		{storageImage->GetWidth(), storageImage->GetHeight(), 1}
@@ -64,9 +62,7 @@ void AccelerationStructureExample::OnAttach()
 			},
 		}),
 		{
-			{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, Texture::Create(storageImage), 0, 0, {
-				ImageLayout::General, ImageLayout::ColorAttachmentOptimal,
-			}},
+			{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, Texture::Create(storageImage), 0, 0},
 		},
 		{{"SwapchainImage", AttachmentType::Swapchain, true, {ImageLayout::ColorAttachmentOptimal, ImageLayout::PresentSrcKHR}},},
 		});
@@ -51,6 +51,38 @@ project "DeferredExample"
 	filter "system:windows"
 		systemversion "latest"
 
+	filter "system:linux"
+		defines
+		{
+			"HG_PLATFORM_LINUX",
+		}
+
+		libdirs
+		{
+			"%{LibraryDir.VulkanSDK}",
+		}
+
+		runpathdirs
+		{
+			"%{LibraryDir.VulkanSDK}",
+		}
+
+		-- Static libraries do not carry their dependencies on Linux, so they are linked after Hog-Core
+		links
+		{
+			"GLFW",
+			"yaml-cpp",
+			"ImGui",
+			"%{Library.ShaderC_Release}",
+			"%{Library.SPIRV_Cross_GLSL_Release}",
+			"%{Library.SPIRV_Cross_Release}",
+			"dl",
+			"pthread",
+		}
+
+	filter { "system:windows", "configurations:Asan" }
+		buildoptions { "/Zi /DEBUG:FULL /Ob0 /Oy-" }
+
 	filter "configurations:Debug"
 		defines "HG_DEBUG"
 		runtime "Debug"
@@ -68,7 +100,6 @@ project "DeferredExample"
 		symbols "on"
 		flags { "NoRuntimeChecks" }
 		editAndContinue "Off"
-		buildoptions { "/Zi /DEBUG:FULL /Ob0 /Oy-" }
 		
 		postbuildcommands
 		{
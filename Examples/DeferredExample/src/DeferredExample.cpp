@@ -1,5 +1,7 @@
 #include "DeferredExample.h"
 
+#include <bit>
+
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <Hog/ImGui/ImGuiHelper.h>
@@ -7,6 +9,13 @@
 
 static auto& context = GraphicsContext::Get();
 
+// Power of two below the depth size, so every pyramid texel covers exactly four texels of the level below
+static VkExtent2D GetPyramidExtent()
+{
+	VkExtent2D extent = GraphicsContext::GetExtent();
+	return { std::bit_floor(extent.width), std::bit_floor(extent.height) };
+}
+
 DeferredExample::DeferredExample()
 	: Layer("DeferredExample")
 {
@@ -18,7 +27,9 @@ void DeferredExample::OnAttach()
 	HG_PROFILE_FUNCTION();
 	CVarSystem::Get()->SetIntCVar("application.enableImGui", 0);
 	CVarSystem::Get()->SetIntCVar("renderer.enableMipMapping", 1);
-	CVarSystem::Get()->SetStringCVar("shader.compilation.macros", "MATERIAL_ARRAY_SIZE=128;TEXTURE_ARRAY_SIZE=512;LIGHT_ARRAY_SIZE=32");
+	CVarSystem::Get()->SetStringCVar("shader.compilation.macros", "MATERIAL_ARRAY_SIZE=128;LIGHT_ARRAY_SIZE=32");
+	// The shadow pass only fetches positions
+	CVarSystem::Get()->SetIntCVar("renderer.geometry.positionStream", 1);
 
 	ShaderCache::Initialize();
 	GraphicsContext::Initialize();
@@ -30,29 +41,97 @@ void DeferredExample::OnAttach()
 	// LoadGltfFile("assets/models/cube/cube.gltf", {}, m_OpaqueMeshes, m_TransparentMeshes, m_Cameras, m_Textures, m_Materials, m_MaterialBuffer, m_Lights, m_LightBuffer);
 	// LoadGltfFile("assets/models/plane/plane.gltf", {}, m_OpaqueMeshes, m_TransparentMeshes, m_Cameras, m_Textures, m_Materials, m_MaterialBuffer, m_Lights, m_LightBuffer);
 
-	Ref<Texture> shadowMap = Texture::Create(Image::Create(ImageDescription::Defaults::ShadowMap, 2048, 2048, 1, static_cast<VkFormat>(DataType::Defaults::Depth32)));
+	RenderGraph graph;
+
+	Ref<Texture> shadowMap = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::ShadowMap, 2048, 2048, 1, static_cast<VkFormat>(DataType::Defaults::Depth32)));
+
+	Ref<Texture> albedoAttachment = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::SampledColorAttachment, 1));
+	Ref<Texture> positionAttachment = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::SampledPositionAttachment, 1));
+	Ref<Texture> normalAttachment = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::SampledNormalAttachment, 1));
+	Ref<Texture> depthAttachment = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::SampledDepth, 1));
 
-	Ref<Texture> albedoAttachment = Texture::Create(Image::Create(ImageDescription::Defaults::SampledColorAttachment, 1));
-	Ref<Texture> positionAttachment = Texture::Create(Image::Create(ImageDescription::Defaults::SampledPositionAttachment, 1));
-	Ref<Texture> normalAttachment = Texture::Create(Image::Create(ImageDescription::Defaults::SampledNormalAttachment, 1));
-	Ref<Texture> depthAttachment = Texture::Create(Image::Create(ImageDescription::Defaults::Depth, 1));
+	VkExtent2D pyramidExtent = GetPyramidExtent();
+	m_DepthPyramid = Texture::Create(
+		Image::Create(ImageDescription::Defaults::Storage, pyramidExtent.width, pyramidExtent.height,
+			std::bit_width(std::max(pyramidExtent.width, pyramidExtent.height)), VK_FORMAT_R32_SFLOAT),
+		{
+			.AddressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.AddressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.AddressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.MipMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		});
 
-	Ref<Texture> colorAttachment = Texture::Create(Image::Create(ImageDescription::Defaults::SampledHDRColorAttachment, 1));
+	Ref<Texture> colorAttachment = Texture::Create(graph.CreateTransientImage(ImageDescription::Defaults::SampledHDRColorAttachment, 1));
 
-	m_ViewProjection = Buffer::Create(BufferDescription::Defaults::UniformBuffer, sizeof(glm::mat4));
-	m_LightViewProjection = Buffer::Create(BufferDescription::Defaults::UniformBuffer, sizeof(glm::mat4));
+	m_ViewProjection = DynamicBuffer::Create(sizeof(glm::mat4));
+	m_LightViewProjection = DynamicBuffer::Create(sizeof(glm::mat4));
 	uint32_t lightCount = m_Lights.size();
 
-	RenderGraph graph;
+	m_OpaqueDrawList = DrawList::Create(m_OpaqueMeshes, true);
+	VkBool32 earlyPhase = VK_FALSE;
+	VkBool32 latePhase = VK_TRUE;
+
+	// Setting renderer.geometry.compactVertices switches the mesh stages to the CompactVertex shaders
+	VertexFormat vertexFormat = GeometryArena::GetVertexFormat();
+	bool compactVertices = vertexFormat == VertexFormat::Compact;
 
-	auto shadowPass = graph.AddStage(nullptr, {
+	StageDescription shadowStage = {
 		"Shadow Pass", RendererStageType::ForwardGraphics, GraphicsPipeline::Create({
-			.Shaders = {"Shadow.vertex", "Shadow.fragment"},
+			.Shaders = {compactVertices ? "ShadowCompact.vertex" : "Shadow.vertex", "Shadow.fragment"},
+			.VertexFormat = vertexFormat,
+			// Depth only, so just the positions are fetched
+			.VertexStream = VertexStream::Position,
 				.Rasterizer = {
 					.CullMode = CullMode::Back,
 				}
 			}
 		),
+		{
+			{DataType::Defaults::Float3, "a_Position"},
+		},
+		{
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Vertex, m_LightViewProjection, 0, 0},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Vertex, SceneBuffer::GetBuffer(), 0, 1},
+		},
+		m_OpaqueMeshes,
+		{
+			{"Shadow Map", AttachmentType::Depth, shadowMap->GetImage(), true},
+		},
+	};
+	shadowStage.CullingViewProjection = m_LightViewProjection;
+	// Shadow map texels cover more than a pixel, a coarser level is rarely visible in them
+	shadowStage.LodBias = 1;
+	auto shadowPass = graph.AddStage(nullptr, shadowStage);
+
+	// Occlusion culling runs in two phases around a depth pyramid of what the first phase drew
+	StageDescription earlyCullStage = {
+		"Early Cull", RendererStageType::ForwardCompute,
+		ComputePipeline::Create({
+			.Shader = "OcclusionCull.compute",
+		}),
+		{
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Compute, m_ViewProjection, 0, 0},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Compute, SceneBuffer::GetBuffer(), 0, 1},
+			{"Objects", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetObjectBuffer(), 0, 2},
+			{"Commands", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetCommandBuffer(), 0, 3},
+			{"Visibility", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetVisibilityBuffer(), 0, 4},
+			{"u_DepthPyramid", ResourceType::Sampler, ShaderType::Defaults::Compute, m_DepthPyramid, 0, 5},
+			{"c_Late", ResourceType::Constant, ShaderType::Defaults::Compute, 0, sizeof(VkBool32), &earlyPhase},
+		},
+		m_OpaqueDrawList->GetGroupCounts(),
+	};
+	earlyCullStage.DispatchBuffer = m_OpaqueDrawList->GetCommandBuffer();
+	auto earlyCull = graph.AddStage(shadowPass, earlyCullStage);
+
+	StageDescription earlyGBufferStage = {
+		"GBuffer Early", RendererStageType::ForwardGraphics,
+		GraphicsPipeline::Create({
+				.Shaders = {compactVertices ? "GBufferCompact.vertex" : "GBuffer.vertex", "GBuffer.fragment"},
+				.VertexFormat = vertexFormat,
+				// Need three blend attachments. One for each color attachment
+				.BlendAttachments = {{}, {}, {},},
+			}
+		),
 		{
 			{DataType::Defaults::Float3, "a_Position"},
 			{DataType::Defaults::Float2, "a_TexCoords"},
@@ -61,20 +140,59 @@ void DeferredExample::OnAttach()
 			{DataType::Defaults::Int, "a_MaterialIndex"},
 		},
 		{
-			{"u_ViewProjection", ResourceType::Uniform, ShaderType::Defaults::Vertex, m_LightViewProjection, 0, 0},
-			{"p_Model", ResourceType::PushConstant, ShaderType::Defaults::Vertex, sizeof(PushConstant), &m_PushConstant},
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
+			{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Vertex, SceneBuffer::GetBuffer(), 0, 2},
 		},
-		m_OpaqueMeshes,
+		{},
 		{
-			{"Shadow Map", AttachmentType::Depth, shadowMap->GetImage(), true, {ImageLayout::DepthStencilAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
+			{"Position", AttachmentType::Color, positionAttachment->GetImage(), true},
+			{"Normal", AttachmentType::Color, normalAttachment->GetImage(), true},
+			{"Albedo", AttachmentType::Color, albedoAttachment->GetImage(), true},
+			{"Depth", AttachmentType::Depth, depthAttachment->GetImage(), true},
 		},
+	};
+	earlyGBufferStage.DispatchBuffer = m_OpaqueDrawList->GetCommandBuffer();
+	auto earlyGBuffer = graph.AddStage(earlyCull, earlyGBufferStage);
+
+	// Group counts are derived from the pyramid levels by the renderer
+	auto pyramid = graph.AddStage(earlyGBuffer, {
+		"Depth Pyramid", RendererStageType::DepthPyramid,
+		ComputePipeline::Create({
+			.Shader = "DepthPyramid.compute",
+		}),
+		{
+			{"u_Depth", ResourceType::Sampler, ShaderType::Defaults::Compute, depthAttachment, 0, 0},
+			{"u_DepthPyramid", ResourceType::StorageImage, ShaderType::Defaults::Compute, m_DepthPyramid->GetImage(), 0, 1},
+		},
+		{0, 0, 0},
 	});
 
-	auto gbuffer = graph.AddStage(shadowPass, {
-		"GBuffer", RendererStageType::ForwardGraphics,
+	StageDescription lateCullStage = {
+		"Late Cull", RendererStageType::ForwardCompute,
+		ComputePipeline::Create({
+			.Shader = "OcclusionCull.compute",
+		}),
+		{
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Compute, m_ViewProjection, 0, 0},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Compute, SceneBuffer::GetBuffer(), 0, 1},
+			{"Objects", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetObjectBuffer(), 0, 2},
+			{"Commands", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetLateCommandBuffer(), 0, 3},
+			{"Visibility", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueDrawList->GetVisibilityBuffer(), 0, 4},
+			{"u_DepthPyramid", ResourceType::Sampler, ShaderType::Defaults::Compute, m_DepthPyramid, 0, 5},
+			{"c_Late", ResourceType::Constant, ShaderType::Defaults::Compute, 0, sizeof(VkBool32), &latePhase},
+		},
+		m_OpaqueDrawList->GetGroupCounts(),
+	};
+	lateCullStage.DispatchBuffer = m_OpaqueDrawList->GetLateCommandBuffer();
+	auto lateCull = graph.AddStage(pyramid, lateCullStage);
+
+	// Adds the newly visible objects on top of the early pass
+	StageDescription lateGBufferStage = {
+		"GBuffer Late", RendererStageType::ForwardGraphics,
 		GraphicsPipeline::Create({
-				.Shaders = {"GBuffer.vertex", "GBuffer.fragment"},
-				// Need three blend attachments. One for each color attachment
+				.Shaders = {compactVertices ? "GBufferCompact.vertex" : "GBuffer.vertex", "GBuffer.fragment"},
+				.VertexFormat = vertexFormat,
 				.BlendAttachments = {{}, {}, {},},
 			}
 		),
@@ -86,23 +204,20 @@ void DeferredExample::OnAttach()
 			{DataType::Defaults::Int, "a_MaterialIndex"},
 		},
 		{
-			{"u_ViewProjection", ResourceType::Uniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
 			{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
-			//{"u_Textures", ResourceType::SamplerArray, ShaderType::Defaults::Fragment, m_Textures, 0, 2, 512},
-			{"p_Model", ResourceType::PushConstant, ShaderType::Defaults::Vertex, sizeof(PushConstant), &m_PushConstant},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Vertex, SceneBuffer::GetBuffer(), 0, 2},
 		},
-		m_OpaqueMeshes,
+		{},
 		{
-			{"Position", AttachmentType::Color, positionAttachment->GetImage(), true, 
-				{ImageLayout::ColorAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
-			{"Normal", AttachmentType::Color, normalAttachment->GetImage(), true, 
-				{ImageLayout::ColorAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
-			{"Albedo", AttachmentType::Color, albedoAttachment->GetImage(), true, 
-				{ImageLayout::ColorAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
-			{"Depth", AttachmentType::Depth, depthAttachment->GetImage(), true,
-				{ImageLayout::DepthStencilAttachmentOptimal, ImageLayout::DepthStencilAttachmentOptimal}},
+			{"Position", AttachmentType::Color, positionAttachment->GetImage(), false},
+			{"Normal", AttachmentType::Color, normalAttachment->GetImage(), false},
+			{"Albedo", AttachmentType::Color, albedoAttachment->GetImage(), false},
+			{"Depth", AttachmentType::Depth, depthAttachment->GetImage(), false},
 		},
-	});
+	};
+	lateGBufferStage.DispatchBuffer = m_OpaqueDrawList->GetLateCommandBuffer();
+	auto gbuffer = graph.AddStage(lateCull, lateGBufferStage);
 
 	auto defferedShade = graph.AddStage(gbuffer, {
 		"Deffered Shade", RendererStageType::ScreenSpacePass, GraphicsPipeline::Create({
@@ -120,7 +235,7 @@ void DeferredExample::OnAttach()
 			{"c_LightCount", ResourceType::Constant, ShaderType::Defaults::Fragment, 0, sizeof(uint32_t), &lightCount},
 		},
 		{
-			{"Color", AttachmentType::Color, colorAttachment->GetImage(), true, {ImageLayout::ColorAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
+			{"Color", AttachmentType::Color, colorAttachment->GetImage(), true},
 		},
 	});
 
@@ -137,10 +252,7 @@ void DeferredExample::OnAttach()
 				}
 			}
 		),
-		{{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, colorAttachment, 0, 0, {
-				PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
-				PipelineStage::FragmentShader, AccessFlag::ShaderSampledRead,
-		}},},
+		{{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, colorAttachment, 0, 0},},
 		{{"SwapchainImage", AttachmentType::Swapchain, true, {ImageLayout::ColorAttachmentOptimal, ImageLayout::PresentSrcKHR}},},
 	});
 
@@ -163,6 +275,8 @@ void DeferredExample::OnDetach()
 	m_Textures.clear();
 	m_Materials.clear();
 	m_Lights.clear();
+	m_OpaqueDrawList.reset();
+	m_DepthPyramid.reset();
 	m_MaterialBuffer.reset();
 	m_LightBuffer.reset();
 	m_ViewProjection.reset();
@@ -202,7 +316,16 @@ void DeferredExample::OnEvent(Event& e)
 
 bool DeferredExample::OnResized(FrameBufferResizeEvent& e)
 {
-	GraphicsContext::RecreateSwapChain();
+	// Minimized windows have nothing to render into
+	if (e.GetWidth() == 0 || e.GetHeight() == 0)
+		return false;
+
+	// The G-buffer and the shadow map are transient images of the graph, they are resized with the swapchain
+	Renderer::Resize();
+
+	// Culling keeps reading last frame's pyramid, which starts out empty after a resize just like on the first frame
+	VkExtent2D pyramidExtent = GetPyramidExtent();
+	m_DepthPyramid->GetImage()->Resize(pyramidExtent.width, pyramidExtent.height, std::bit_width(std::max(pyramidExtent.width, pyramidExtent.height)));
 
 	m_EditorCamera.SetViewportSize((float)e.GetWidth(), (float)e.GetHeight());
 
@@ -7,11 +7,6 @@ using namespace Hog;
 class DeferredExample : public Layer
 {
 public:
-	struct PushConstant
-	{
-		glm::mat4 Model;
-	};
-
 	DeferredExample();
 	virtual ~DeferredExample() = default;
 
@@ -26,13 +21,14 @@ private:
 	EditorCamera m_EditorCamera;
 	std::vector<Ref<Mesh>> m_TransparentMeshes;
 	std::vector<Ref<Mesh>> m_OpaqueMeshes;
+	Ref<DrawList> m_OpaqueDrawList;
+	Ref<Texture> m_DepthPyramid;
 	std::vector<Ref<Texture>> m_Textures;
 	std::unordered_map<std::string, Camera> m_Cameras;
 	std::vector<Ref<Material>> m_Materials;
 	std::vector<Ref<Light>> m_Lights;
 	Ref<Buffer> m_MaterialBuffer;
-	Ref<Buffer> m_ViewProjection;
-	Ref<Buffer> m_LightViewProjection;
+	Ref<DynamicBuffer> m_ViewProjection;
+	Ref<DynamicBuffer> m_LightViewProjection;
 	Ref<Buffer> m_LightBuffer;
-	PushConstant m_PushConstant;
 };
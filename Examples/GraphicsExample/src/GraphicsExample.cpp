@@ -17,8 +17,9 @@ void GraphicsExample::OnAttach()
 	HG_PROFILE_FUNCTION();
 	CVarSystem::Get()->SetIntCVar("application.enableImGui", 0);
 	CVarSystem::Get()->SetIntCVar("renderer.enableMipMapping", 1);
-	CVarSystem::Get()->SetStringCVar("shader.compilation.macros", "MATERIAL_ARRAY_SIZE=128;TEXTURE_ARRAY_SIZE=512");
+	CVarSystem::Get()->SetStringCVar("shader.compilation.macros", "MATERIAL_ARRAY_SIZE=128");
 	CVarSystem::Get()->SetIntCVar("material.array.size", 128);
+	CVarSystem::Get()->SetIntCVar("renderer.meshlets", 1);
 
 	ShaderCache::Initialize();
 	GraphicsContext::Initialize();
@@ -31,35 +32,83 @@ void GraphicsExample::OnAttach()
 	Ref<Image> depthAttachment = Image::Create(ImageDescription::Defaults::Depth, 1);
 	Ref<Texture> colorAttachmentTexture = Texture::Create(colorAttachment);
 
-	m_ViewProjection = Buffer::Create(BufferDescription::Defaults::UniformBuffer, sizeof(glm::mat4));
+	m_ViewProjection = DynamicBuffer::Create(sizeof(glm::mat4));
+
+	m_OpaqueClusterList = ClusterList::Create(m_OpaqueMeshes);
 
 	RenderGraph graph;
-	auto graphics = graph.AddStage(nullptr, {
-		"ForwardGraphics", RendererStageType::ForwardGraphics, 
-		GraphicsPipeline::Create({
-			.Shaders = {"Basic.vertex", "Basic.fragment"},
-		}),
-		{
-			{DataType::Defaults::Float3, "a_Position"},
-			{DataType::Defaults::Float2, "a_TexCoords"},
-			{DataType::Defaults::Float3, "a_Normal"},
-			{DataType::Defaults::Float4, "a_Tangent"},
-			{DataType::Defaults::Int, "a_MaterialIndex"},
-		},
-		{
-			{"u_ViewProjection", ResourceType::Uniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
-			{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
-			{"u_Textures", ResourceType::SamplerArray, ShaderType::Defaults::Fragment, m_Textures, 0, 2, 512},
-			{"p_Model", ResourceType::PushConstant, ShaderType::Defaults::Vertex, sizeof(PushConstant), &m_PushConstant},
-		},
-		m_OpaqueMeshes,
-		{
-			{"Color", AttachmentType::Color, colorAttachment, true, {ImageLayout::ColorAttachmentOptimal, ImageLayout::ColorAttachmentOptimal}},
-			{"Depth", AttachmentType::Depth, depthAttachment, true, {ImageLayout::DepthStencilAttachmentOptimal, ImageLayout::DepthStencilAttachmentOptimal}},
-		},
-	});
+	Ref<Node> graphics;
+	if (GraphicsContext::HasMeshShaders())
+	{
+		// The task shader culls the clusters, no compute pass or indirect draws needed
+		StageDescription graphicsStage = {
+			"ForwardGraphics", RendererStageType::ForwardGraphics,
+			GraphicsPipeline::Create({
+				.Shaders = {"Basic.task", "Basic.mesh", "Basic.fragment"},
+			}),
+			{
+				{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::CombinedTaskMesh, m_ViewProjection, 0, 0},
+				{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
+				{"Scene", ResourceType::Storage, ShaderType::Defaults::CombinedTaskMesh, SceneBuffer::GetBuffer(), 0, 2},
+				{"Clusters", ResourceType::Storage, ShaderType::Defaults::CombinedTaskMesh, m_OpaqueClusterList->GetClusterBuffer(), 0, 3},
+				{"MeshletVertices", ResourceType::Storage, ShaderType::Defaults::Mesh, m_OpaqueClusterList->GetMeshletVertexBuffer(), 0, 4},
+				{"MeshletTriangles", ResourceType::Storage, ShaderType::Defaults::Mesh, m_OpaqueClusterList->GetMeshletTriangleBuffer(), 0, 5},
+				{"Vertices", ResourceType::Storage, ShaderType::Defaults::Mesh, GeometryArena::GetVertexBuffer(), 0, 6},
+			},
+			{
+				{"Color", AttachmentType::Color, colorAttachment, true},
+				{"Depth", AttachmentType::Depth, depthAttachment, true},
+			},
+		};
+		graphicsStage.GroupCounts = m_OpaqueClusterList->GetTaskGroupCounts();
+		graphics = graph.AddStage(nullptr, graphicsStage);
+	}
+	else
+	{
+		StageDescription cullStage = {
+			"ClusterCull", RendererStageType::ForwardCompute,
+			ComputePipeline::Create({
+				.Shader = "ClusterCull.compute",
+			}),
+			{
+				{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Compute, m_ViewProjection, 0, 0},
+				{"Scene", ResourceType::Storage, ShaderType::Defaults::Compute, SceneBuffer::GetBuffer(), 0, 1},
+				{"Clusters", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueClusterList->GetClusterBuffer(), 0, 2},
+				{"Commands", ResourceType::Storage, ShaderType::Defaults::Compute, m_OpaqueClusterList->GetCommandBuffer(), 0, 3},
+			},
+			m_OpaqueClusterList->GetGroupCounts(),
+		};
+		cullStage.DispatchBuffer = m_OpaqueClusterList->GetCommandBuffer();
+		auto cull = graph.AddStage(nullptr, cullStage);
+
+		StageDescription graphicsStage = {
+			"ForwardGraphics", RendererStageType::ForwardGraphics, 
+			GraphicsPipeline::Create({
+				.Shaders = {"Basic.vertex", "Basic.fragment"},
+			}),
+			{
+				{DataType::Defaults::Float3, "a_Position"},
+				{DataType::Defaults::Float2, "a_TexCoords"},
+				{DataType::Defaults::Float3, "a_Normal"},
+				{DataType::Defaults::Float4, "a_Tangent"},
+				{DataType::Defaults::Int, "a_MaterialIndex"},
+			},
+			{
+				{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
+				{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
+				{"Scene", ResourceType::Storage, ShaderType::Defaults::Vertex, SceneBuffer::GetBuffer(), 0, 2},
+			},
+			{},
+			{
+				{"Color", AttachmentType::Color, colorAttachment, true},
+				{"Depth", AttachmentType::Depth, depthAttachment, true},
+			},
+		};
+		graphicsStage.DispatchBuffer = m_OpaqueClusterList->GetCommandBuffer();
+		graphics = graph.AddStage(cull, graphicsStage);
+	}
 
-	auto transparentGraphics = graph.AddStage(graphics, {
+	StageDescription transparentStage = {
 		"ForwardGraphics", RendererStageType::ForwardGraphics, 
 		GraphicsPipeline::Create({
 			.Shaders = {"Basic.vertex", "Basic.fragment"},
@@ -72,17 +121,18 @@ void GraphicsExample::OnAttach()
 			{DataType::Defaults::Int, "a_MaterialIndex"},
 		},
 		{
-			{"u_ViewProjection", ResourceType::Uniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
+			{"u_ViewProjection", ResourceType::DynamicUniform, ShaderType::Defaults::Vertex, m_ViewProjection, 0, 0},
 			{"u_Materials", ResourceType::Uniform, ShaderType::Defaults::Fragment, m_MaterialBuffer, 0, 1},
-			{"u_Textures", ResourceType::SamplerArray, ShaderType::Defaults::Fragment, m_Textures, 0, 2, 512},
-			{"p_Model", ResourceType::PushConstant, ShaderType::Defaults::Vertex, sizeof(PushConstant), &m_PushConstant},
+			{"Scene", ResourceType::Storage, ShaderType::Defaults::Vertex, SceneBuffer::GetBuffer(), 0, 2},
 		},
 		m_TransparentMeshes,
 		{
-			{"Color", AttachmentType::Color, colorAttachment, false, {ImageLayout::ColorAttachmentOptimal, ImageLayout::ShaderReadOnlyOptimal}},
-			{"Depth", AttachmentType::Depth, depthAttachment, true, {ImageLayout::DepthStencilAttachmentOptimal, ImageLayout::DepthStencilAttachmentOptimal}},
+			{"Color", AttachmentType::Color, colorAttachment, false},
+			{"Depth", AttachmentType::Depth, depthAttachment, true},
 		},
-	});
+	};
+	transparentStage.CullingViewProjection = m_ViewProjection;
+	auto transparentGraphics = graph.AddStage(graphics, transparentStage);
 
 	//auto imGuiStage = graph.AddStage(graphics, {
 	//	"ImGuiStage", RendererStageType::ImGui, {
@@ -109,10 +159,7 @@ void GraphicsExample::OnAttach()
 			},
 		}),
 		{
-			{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, colorAttachmentTexture, 0, 0, {
-				PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
-				PipelineStage::FragmentShader, AccessFlag::ShaderSampledRead,
-			}},
+			{"FinalRender", ResourceType::Sampler, ShaderType::Defaults::Fragment, colorAttachmentTexture, 0, 0},
 		},
 		{{"SwapchainImage", AttachmentType::Swapchain, true, {ImageLayout::ColorAttachmentOptimal, ImageLayout::PresentSrcKHR}},},
 	});
@@ -130,6 +177,7 @@ void GraphicsExample::OnDetach()
 
 	Renderer::Cleanup();
 
+	m_OpaqueClusterList.reset();
 	m_OpaqueMeshes.clear();
 	m_TransparentMeshes.clear();
 	m_Textures.clear();
@@ -166,7 +214,7 @@ void GraphicsExample::OnEvent(Event& e)
 
 bool GraphicsExample::OnResized(FrameBufferResizeEvent& e)
 {
-	GraphicsContext::RecreateSwapChain();
+	Renderer::Resize();
 
 	m_EditorCamera.SetViewportSize((float)e.GetWidth(), (float)e.GetHeight());
 
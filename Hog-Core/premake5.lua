@@ -76,6 +76,28 @@ project "Hog-Core"
 	filter "system:windows"
 		systemversion "latest"
 
+		removefiles
+		{
+			"src/Platform/Linux/**",
+		}
+
+	filter "system:linux"
+		pic "On"
+
+		defines
+		{
+			"HG_PLATFORM_LINUX",
+		}
+
+		-- The Win32 window, input and file dialogs are replaced by the headless Linux platform
+		removefiles
+		{
+			"src/Platform/Windows/**",
+		}
+
+	filter { "system:windows", "configurations:Asan" }
+		buildoptions { "/Zi /DEBUG:FULL /Ob0 /Oy-" }
+
 	filter "configurations:Debug"
 		defines "HG_DEBUG"
 		runtime "Debug"
@@ -95,7 +117,6 @@ project "Hog-Core"
 		symbols "on"
 		editAndContinue "Off"
 		flags { "NoRuntimeChecks" }
-		buildoptions { "/Zi /DEBUG:FULL /Ob0 /Oy-" }
 		
 		links
 		{
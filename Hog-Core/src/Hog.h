@@ -27,7 +27,11 @@
 #include "Hog/Renderer/Pipeline.h"
 #include "Hog/Renderer/Shader.h"
 #include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/UploadRing.h"
 #include "Hog/Renderer/Mesh.h"
+#include "Hog/Renderer/SceneBuffer.h"
+#include "Hog/Renderer/DrawList.h"
+#include "Hog/Renderer/ClusterList.h"
 #include "Hog/Renderer/Material.h"
 #include "Hog/Renderer/Renderer.h"
 #include "Hog/Renderer/RenderGraph.h"
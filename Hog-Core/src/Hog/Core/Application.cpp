@@ -5,9 +5,8 @@
 #include "Hog/Renderer/Renderer.h"
 #include "Hog/Core/CVars.h"
 
-#include <GLFW/glfw3.h>
-
 AutoCVar_Int CVar_ImGui("application.enableImGui", "Enables ImGui ui layer", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_HeadlessFrameCount("application.headlessFrameCount", "Number of frames rendered before a headless application exits, 0 runs until closed", 0, CVarFlags::EditReadOnly);
 
 namespace Hog {
 
@@ -22,8 +21,28 @@ namespace Hog {
 		CVar_ImGui.Set(0);
 #endif
 
+#ifdef HG_PLATFORM_LINUX
+		// There is no window backend on Linux yet, so it always renders offscreen
+		CVarSystem::Get()->SetIntCVar("renderer.headless", 1);
+#endif
+
+		for (int i = 1; i < args.Count; i++)
+		{
+			if (std::strcmp(args[i], "--headless") == 0)
+			{
+				CVarSystem::Get()->SetIntCVar("renderer.headless", 1);
+			}
+		}
+
 		HG_CORE_ASSERT(!s_Instance, "Application already exists!");
 		s_Instance = this;
+
+		if (*CVarSystem::Get()->GetIntCVar("renderer.headless"))
+		{
+			CVar_ImGui.Set(0);
+			return;
+		}
+
 		m_Window = Window::Create(WindowProps(name));
 		m_Window->SetEventCallback(HG_BIND_EVENT_FN(Application::OnEvent));
 	}
@@ -88,11 +107,14 @@ namespace Hog {
 	{
 		HG_PROFILE_FUNCTION();
 
+		uint64_t frameCount = 0;
+		m_Timer.Reset();
+
 		while (m_Running)
 		{
 			HG_PROFILE_START_FRAME("MainThread");
 
-			float time = (float)glfwGetTime();
+			float time = m_Timer.Elapsed();
 			m_Timestep = time - m_LastFrameTime;
 			m_LastFrameTime = time;
 
@@ -118,9 +140,23 @@ namespace Hog {
 				}
 
 				Renderer::Draw();
+				frameCount++;
+			}
+
+			if (m_Window)
+			{
+				m_Window->OnUpdate();
+			}
+			else if (CVar_HeadlessFrameCount.Get() > 0 && frameCount >= static_cast<uint64_t>(CVar_HeadlessFrameCount.Get()))
+			{
+				m_Running = false;
 			}
+		}
 
-			m_Window->OnUpdate();
+		if (!m_Window && frameCount > 0)
+		{
+			float elapsed = m_Timer.ElapsedMillis();
+			HG_CORE_INFO("Rendered {} headless frames in {:.2f} ms ({:.3f} ms/frame)", frameCount, elapsed, elapsed / frameCount);
 		}
 
 		m_ImGuiLayer.reset();
@@ -8,6 +8,7 @@
 #include "Hog/Events/ApplicationEvent.h"
 
 #include "Hog/Core/Timestep.h"
+#include "Hog/Core/Timer.h"
 
 #include "Hog/ImGui/ImGuiLayer.h"
 
@@ -41,6 +42,8 @@ namespace Hog {
 		void PopOverlay(Ref<Layer> layer);
 
 		Window& GetWindow() { return *m_Window; }
+		// Headless applications have no window, render into offscreen images and receive no input
+		bool IsHeadless() const { return !m_Window; }
 
 		void Close();
 
@@ -62,6 +65,7 @@ namespace Hog {
 		bool m_Minimized = false;
 		LayerStack m_LayerStack;
 		Ref<ImGuiLayer> m_ImGuiLayer;
+		Timer m_Timer;
 		float m_LastFrameTime = 0.0f;
 		Timestep m_Timestep;
 	private:
@@ -2,7 +2,7 @@
 #include "Hog/Core/Base.h"
 #include "Hog/Core/Application.h"
 
-#ifdef HG_PLATFORM_WINDOWS
+#if defined(HG_PLATFORM_WINDOWS) || defined(HG_PLATFORM_LINUX)
 
 extern Hog::Application* Hog::CreateApplication(ApplicationCommandLineArgs args);
 
@@ -32,8 +32,9 @@
 	#define HG_PLATFORM_ANDROID
 	#error "Android is not supported!"
 #elif defined(__linux__)
-	#define HG_PLATFORM_LINUX
-	#error "Linux is not supported!"
+	#ifndef HG_PLATFORM_LINUX
+		#define HG_PLATFORM_LINUX
+	#endif
 #else
 	/* Unknown compiler/platform */
 	#error "Unknown platform!"
@@ -0,0 +1,104 @@
+#include "hgpch.h"
+#include "Hog/Core/ThreadPool.h"
+
+namespace Hog {
+
+	ThreadPool::~ThreadPool()
+	{
+		Shutdown();
+	}
+
+	void ThreadPool::Init(uint32_t threadCount)
+	{
+		HG_CORE_ASSERT(m_Threads.empty(), "Thread pool already initialized");
+
+		m_Running = true;
+		m_Threads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	void ThreadPool::Shutdown()
+	{
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Running = false;
+		}
+
+		m_WakeCondition.notify_all();
+		for (auto& thread : m_Threads)
+		{
+			thread.join();
+		}
+
+		m_Threads.clear();
+	}
+
+	void ThreadPool::Execute(uint32_t jobCount, const Job& job)
+	{
+		if (m_Threads.empty() || jobCount <= 1)
+		{
+			for (uint32_t i = 0; i < jobCount; i++)
+			{
+				job(i, GetWorkerCount() - 1);
+			}
+
+			return;
+		}
+
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Job = &job;
+			m_JobCount = jobCount;
+			m_NextJob = 0;
+			m_ActiveWorkers = static_cast<uint32_t>(m_Threads.size());
+			m_Generation++;
+		}
+
+		m_WakeCondition.notify_all();
+
+		// The calling thread takes the last worker index
+		RunJobs(GetWorkerCount() - 1);
+
+		std::unique_lock lock(m_Mutex);
+		m_DoneCondition.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+		m_Job = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t worker)
+	{
+		uint64_t generation = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock lock(m_Mutex);
+				m_WakeCondition.wait(lock, [this, generation]() { return !m_Running || m_Generation != generation; });
+
+				if (!m_Running)
+					return;
+
+				generation = m_Generation;
+			}
+
+			RunJobs(worker);
+
+			std::lock_guard lock(m_Mutex);
+			if (--m_ActiveWorkers == 0)
+			{
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::RunJobs(uint32_t worker)
+	{
+		for (uint32_t job = m_NextJob++; job < m_JobCount; job = m_NextJob++)
+		{
+			(*m_Job)(job, worker);
+		}
+	}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace Hog {
+
+	// Fixed set of workers that split a batch of jobs with the calling thread
+	class ThreadPool
+	{
+	public:
+		using Job = std::function<void(uint32_t job, uint32_t worker)>;
+
+		ThreadPool() = default;
+		~ThreadPool();
+
+		void Init(uint32_t threadCount);
+		void Shutdown();
+
+		// Blocks until every job ran, worker indices are in [0, GetWorkerCount())
+		void Execute(uint32_t jobCount, const Job& job);
+
+		uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Threads.size()) + 1; }
+	private:
+		void WorkerLoop(uint32_t worker);
+		void RunJobs(uint32_t worker);
+	private:
+		std::vector<std::thread> m_Threads;
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		std::condition_variable m_DoneCondition;
+
+		const Job* m_Job = nullptr;
+		uint32_t m_JobCount = 0;
+		std::atomic<uint32_t> m_NextJob = 0;
+		uint32_t m_ActiveWorkers = 0;
+		uint64_t m_Generation = 0;
+		bool m_Running = false;
+	};
+
+}
@@ -11,6 +11,9 @@ namespace Hog
 	{
 	#ifdef HG_PLATFORM_WINDOWS
 		return CreateScope<WindowsWindow>(props);
+	#elif defined(HG_PLATFORM_LINUX)
+		HG_CORE_ASSERT(false, "Linux only supports headless rendering!");
+		return nullptr;
 	#else
 		HG_CORE_ASSERT(false, "Unknown platform!");
 		return nullptr;
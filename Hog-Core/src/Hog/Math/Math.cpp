@@ -1,6 +1,8 @@
 #include "hgpch.h"
 #include "Math.h"
 
+#include <emmintrin.h>
+
 #include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/norm.hpp>
 
@@ -119,6 +121,126 @@ namespace Hog::Math {
 		}
 	}
 
+	void SphereArray::Resize(size_t count)
+	{
+		size_t padded = (count + 3) & ~size_t(3);
+
+		m_X.resize(padded, 0.0f);
+		m_Y.resize(padded, 0.0f);
+		m_Z.resize(padded, 0.0f);
+		m_Radius.resize(padded, 0.0f);
+		m_Count = count;
+	}
+
+	void SphereArray::Set(size_t index, const glm::vec4& sphere)
+	{
+		m_X[index] = sphere.x;
+		m_Y[index] = sphere.y;
+		m_Z[index] = sphere.z;
+		m_Radius[index] = sphere.w;
+	}
+
+	AABB TransformAABB(const AABB& box, const glm::mat4& transform)
+	{
+		// Arvo's method, every output axis picks the smaller and larger product per input axis
+		AABB result;
+		result.Min = glm::vec3(transform[3]);
+		result.Max = glm::vec3(transform[3]);
+
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec3 a = glm::vec3(transform[i]) * box.Min[i];
+			glm::vec3 b = glm::vec3(transform[i]) * box.Max[i];
+
+			result.Min += glm::min(a, b);
+			result.Max += glm::max(a, b);
+		}
+
+		return result;
+	}
+
+	glm::vec4 TransformSphere(const glm::vec4& sphere, const glm::mat4& transform)
+	{
+		glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+		float scale = glm::sqrt(glm::max(glm::length2(glm::vec3(transform[0])),
+			glm::max(glm::length2(glm::vec3(transform[1])), glm::length2(glm::vec3(transform[2])))));
+
+		return glm::vec4(center, sphere.w * scale);
+	}
+
+	Frustum ExtractFrustumPlanes(const glm::mat4& viewProjection)
+	{
+		// Gribb-Hartmann, the rows of the matrix combined per clip plane
+		glm::mat4 m = glm::transpose(viewProjection);
+
+		Frustum frustum = {{
+			m[3] + m[0],
+			m[3] - m[0],
+			m[3] + m[1],
+			m[3] - m[1],
+			m[2],
+			m[3] - m[2],
+		}};
+
+		for (auto& plane : frustum.Planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		return frustum;
+	}
+
+	uint32_t CullSpheres(const Frustum& frustum, const SphereArray& spheres, std::vector<uint8_t>& visibility)
+	{
+		visibility.resize(spheres.Size());
+
+		uint32_t visibleCount = 0;
+		for (size_t i = 0; i < spheres.Size(); i += 4)
+		{
+			__m128 x = _mm_loadu_ps(spheres.X() + i);
+			__m128 y = _mm_loadu_ps(spheres.Y() + i);
+			__m128 z = _mm_loadu_ps(spheres.Z() + i);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.Radius() + i));
+
+			// Four spheres against one plane at a time, a sphere is out once it lies fully behind any plane
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (const auto& plane : frustum.Planes)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			size_t count = std::min<size_t>(4, spheres.Size() - i);
+			for (size_t j = 0; j < count; j++)
+			{
+				uint8_t visible = (mask >> j) & 1;
+				visibility[i + j] = visible;
+				visibleCount += visible;
+			}
+		}
+
+		return visibleCount;
+	}
+
+	glm::vec2 EncodeOctahedral(const glm::vec3& direction)
+	{
+		glm::vec3 n = direction / (glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z));
+		glm::vec2 encoded(n.x, n.y);
+
+		// The lower half folds over the diagonals
+		if (n.z < 0.0f)
+		{
+			glm::vec2 sign(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+			encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+		}
+
+		return encoded;
+	}
+
 	bool EpsilonCompare(float a, float b)
 	{
 		return fabsf(a - b) < std::numeric_limits<float>::epsilon();
@@ -21,8 +21,47 @@ namespace Hog::Math
         static const glm::vec3 Backward;
 	};
 
+	struct AABB
+	{
+		glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 Max = glm::vec3(-std::numeric_limits<float>::max());
+	};
+
+	// Inward facing planes with normalized normals, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum
+	{
+		std::array<glm::vec4, 6> Planes;
+	};
+
+	// Bounding spheres in structure of arrays layout, padded to a multiple of four for the SIMD tests
+	class SphereArray
+	{
+	public:
+		void Resize(size_t count);
+		void Set(size_t index, const glm::vec4& sphere);
+		size_t Size() const { return m_Count; }
+
+		const float* X() const { return m_X.data(); }
+		const float* Y() const { return m_Y.data(); }
+		const float* Z() const { return m_Z.data(); }
+		const float* Radius() const { return m_Radius.data(); }
+	private:
+		std::vector<float> m_X, m_Y, m_Z, m_Radius;
+		size_t m_Count = 0;
+	};
+
 	bool DecomposeTransform(const glm::mat4& transform, glm::vec3& translation, glm::vec3& rotation, glm::vec3& scale);
 	void CalculateFrustrumCorners(std::vector<glm::vec3>& corners, glm::mat4 projection);
 
+	AABB TransformAABB(const AABB& box, const glm::mat4& transform);
+	// Spheres are stored as center in xyz and radius in w
+	glm::vec4 TransformSphere(const glm::vec4& sphere, const glm::mat4& transform);
+	// Expects a [0, 1] depth range
+	Frustum ExtractFrustumPlanes(const glm::mat4& viewProjection);
+	// Sets visibility to 1 for every sphere at least partially inside the frustum and 0 otherwise, returns the visible count
+	uint32_t CullSpheres(const Frustum& frustum, const SphereArray& spheres, std::vector<uint8_t>& visibility);
+	// Maps a unit vector onto the [-1, 1] square of an octahedron unfolded around +z
+	glm::vec2 EncodeOctahedral(const glm::vec3& direction);
+
     bool EpsilonCompare(float a, float b);
 }
@@ -8,48 +8,50 @@ namespace Hog
 {
 	Ref<AccelerationStructure> AccelerationStructure::Create(const std::vector<Ref<Mesh>>& meshes)
 	{
-		auto ref = CreateRef<AccelerationStructure>(CreateRef<AccelerationStructure>(meshes));
+		// Instances of a mesh share its bottom level structure, only the top level repeats them
+		std::vector<Ref<AccelerationStructure>> bottomLevelStructures;
+		bottomLevelStructures.reserve(meshes.size());
+		for (const auto& mesh : meshes)
+		{
+			bottomLevelStructures.push_back(CreateRef<AccelerationStructure>(mesh));
+		}
+
+		auto ref = CreateRef<AccelerationStructure>(meshes, bottomLevelStructures);
 
 		return ref;
 	}
 
-	AccelerationStructure::AccelerationStructure(const std::vector<Ref<Mesh>>& meshes)
-		: m_Meshes(meshes)
+	AccelerationStructure::AccelerationStructure(const Ref<Mesh>& mesh)
+		: m_Meshes({ mesh })
 	{
 		std::vector<VkAccelerationStructureGeometryKHR> accelerationStructureGeometries;
 		std::vector<uint32_t> triangleCounts;
 		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfoPointers;
 		std::vector<VkAccelerationStructureBuildRangeInfoKHR> accelerationBuildStructureRangeInfos;
 
-		for (const auto& mesh : meshes)
-		{
-			glm::mat4 transformMatrix = mesh->GetModelMatrix();
-			auto transformBuffer = Buffer::Create(BufferDescription::Defaults::AccelerationStructureBuildInput, sizeof(VkTransformMatrixKHR));
-			transformBuffer->WriteData(&transformMatrix, sizeof(VkTransformMatrixKHR));
-			m_TransformBuffers.push_back(transformBuffer);
+		HG_CORE_ASSERT(GeometryArena::GetVertexFormat() == VertexFormat::Full, "Acceleration structures are built from full float vertices");
 
-			for (auto primitive = mesh->begin(); primitive != mesh->end(); primitive++)
-			{
-				VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
-				accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-				accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-				accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-				accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-				accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-				accelerationStructureGeometry.geometry.triangles.vertexData.deviceAddress = mesh->GetVertexBuffer()->GetBufferDeviceAddress() + primitive->GetVertexOffset();
-				accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
-				accelerationStructureGeometry.geometry.triangles.maxVertex = static_cast<uint32_t>(primitive->GetVertexCount());
-				accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT16;
-				accelerationStructureGeometry.geometry.triangles.indexData.deviceAddress = mesh->GetIndexBuffer()->GetBufferDeviceAddress();
-				accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = transformBuffer->GetBufferDeviceAddress();
-				accelerationStructureGeometries.push_back(accelerationStructureGeometry);
-				triangleCounts.push_back(static_cast<uint32_t>(primitive->GetIndexCount() / 3));
-
-				VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-				accelerationStructureBuildRangeInfo.primitiveCount = static_cast<uint32_t>(primitive->GetIndexCount() / 3);
-				accelerationStructureBuildRangeInfo.primitiveOffset = static_cast<uint32_t>(primitive->GetIndexOffset());
-				accelerationBuildStructureRangeInfos.push_back(accelerationStructureBuildRangeInfo);
-			}
+		// Geometry stays in object space, the top level instances place it
+		for (auto primitive = mesh->begin(); primitive != mesh->end(); primitive++)
+		{
+			VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
+			accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+			accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+			accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+			accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+			accelerationStructureGeometry.geometry.triangles.vertexData.deviceAddress = mesh->GetVertexBuffer()->GetBufferDeviceAddress() + primitive->GetVertexOffset();
+			accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
+			accelerationStructureGeometry.geometry.triangles.maxVertex = static_cast<uint32_t>(primitive->GetVertexCount());
+			accelerationStructureGeometry.geometry.triangles.indexType = primitive->GetIndexType();
+			accelerationStructureGeometry.geometry.triangles.indexData.deviceAddress = mesh->GetIndexBuffer()->GetBufferDeviceAddress();
+			accelerationStructureGeometries.push_back(accelerationStructureGeometry);
+			triangleCounts.push_back(static_cast<uint32_t>(primitive->GetIndexCount() / 3));
+
+			VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+			accelerationStructureBuildRangeInfo.primitiveCount = static_cast<uint32_t>(primitive->GetIndexCount() / 3);
+			accelerationStructureBuildRangeInfo.primitiveOffset = static_cast<uint32_t>(primitive->GetIndexOffset());
+			accelerationBuildStructureRangeInfos.push_back(accelerationStructureBuildRangeInfo);
 		}
 
 		// Get size info
@@ -84,6 +86,7 @@ namespace Hog
 		accelerationStructureBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		accelerationStructureBuildGeometryInfo.dstAccelerationStructure = m_Handle;
 		accelerationStructureBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer->GetBufferDeviceAddress();
+		GraphicsContext::KeepAlive(scratchBuffer);
 
 		for (int i = 0; i < accelerationBuildStructureRangeInfos.size(); i++)
 		{
@@ -106,25 +109,33 @@ namespace Hog
 		m_DeviceAddress = vkGetAccelerationStructureDeviceAddressKHR(GraphicsContext::GetDevice(), &accelerationDeviceAddressInfo);
 	}
 
-	AccelerationStructure::AccelerationStructure(const Ref<AccelerationStructure>& bottomLevelStructure)
-		:m_TopLevel(true), m_BottomLevelAS(bottomLevelStructure)
+	AccelerationStructure::AccelerationStructure(const std::vector<Ref<Mesh>>& meshes, const std::vector<Ref<AccelerationStructure>>& bottomLevelStructures)
+		:m_TopLevel(true), m_Meshes(meshes), m_BottomLevelStructures(bottomLevelStructures)
 	{
-		VkTransformMatrixKHR transformMatrix = {
-			1.0f, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f 
-		};
-
-		VkAccelerationStructureInstanceKHR instance{};
-		instance.transform = transformMatrix;
-		instance.instanceCustomIndex = 0;
-		instance.mask = 0xFF;
-		instance.instanceShaderBindingTableRecordOffset = 0;
-		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-		instance.accelerationStructureReference = bottomLevelStructure->GetDeviceAddress();
-		
-		m_InstanceBuffer = Buffer::Create(BufferDescription::Defaults::AccelerationStructureBuildInput, sizeof(VkAccelerationStructureInstanceKHR));
-		m_InstanceBuffer->WriteData(&instance, sizeof(VkAccelerationStructureInstanceKHR));
+		std::vector<VkAccelerationStructureInstanceKHR> instances;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			// The instances are baked in, added ones would be missing
+			meshes[i]->LockInstances();
+
+			for (uint32_t instance = 0; instance < meshes[i]->GetInstanceCount(); instance++)
+			{
+				// Row major 3x4, the transpose of glm's column major matrix without the last row
+				glm::mat4 model = glm::transpose(meshes[i]->GetModelMatrix(instance));
+
+				VkAccelerationStructureInstanceKHR instanceData{};
+				std::memcpy(&instanceData.transform, &model, sizeof(VkTransformMatrixKHR));
+				instanceData.instanceCustomIndex = instance;
+				instanceData.mask = 0xFF;
+				instanceData.instanceShaderBindingTableRecordOffset = 0;
+				instanceData.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+				instanceData.accelerationStructureReference = bottomLevelStructures[i]->GetDeviceAddress();
+				instances.push_back(instanceData);
+			}
+		}
+
+		m_InstanceBuffer = Buffer::Create(BufferDescription::Defaults::AccelerationStructureBuildInput, instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+		m_InstanceBuffer->WriteData(instances.data(), m_InstanceBuffer->GetSize());
 
 		VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
 		accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
@@ -145,7 +156,7 @@ namespace Hog
 		accelerationStructureBuildGeometryInfo.geometryCount = 1;
 		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
 
-		uint32_t instanceCount = 1;
+		uint32_t instanceCount = static_cast<uint32_t>(instances.size());
 		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
 		accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
 		vkGetAccelerationStructureBuildSizesKHR(
@@ -170,6 +181,7 @@ namespace Hog
 		accelerationStructureBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		accelerationStructureBuildGeometryInfo.dstAccelerationStructure = m_Handle;
 		accelerationStructureBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer->GetBufferDeviceAddress();
+		GraphicsContext::KeepAlive(scratchBuffer);
 
 		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
 		accelerationStructureBuildRangeInfo.primitiveCount = instanceCount;
@@ -194,11 +206,10 @@ namespace Hog
 	
 	AccelerationStructure::~AccelerationStructure()
 	{
-		m_TransformBuffers.clear();
 		m_AccelerationStructureBuffer.reset();
 		m_InstanceBuffer.reset();
 		m_Meshes.clear();
-		m_BottomLevelAS.reset();
+		m_BottomLevelStructures.clear();
 		vkDestroyAccelerationStructureKHR(GraphicsContext::GetDevice(), m_Handle, nullptr);
 	}
 }
@@ -8,9 +8,12 @@ namespace Hog{
 	class AccelerationStructure
 	{
 	public:
+		// Top level structure with an instance per mesh instance, over one bottom level structure per mesh
 		static Ref<AccelerationStructure> Create(const std::vector<Ref<Mesh>>& meshes);
-		AccelerationStructure(const std::vector<Ref<Mesh>>& meshes);
-		AccelerationStructure(const Ref<AccelerationStructure>& bottomLevelStructure);
+		// Bottom level structure with a geometry per primitive in the mesh's object space
+		AccelerationStructure(const Ref<Mesh>& mesh);
+		// Top level structure, bottomLevelStructures holds the one of every mesh
+		AccelerationStructure(const std::vector<Ref<Mesh>>& meshes, const std::vector<Ref<AccelerationStructure>>& bottomLevelStructures);
 		~AccelerationStructure();
 
 		VkDeviceAddress GetDeviceAddress() const { return m_DeviceAddress; }
@@ -23,9 +26,8 @@ namespace Hog{
 		Ref<Buffer> m_InstanceBuffer;
 
 		std::vector<Ref<Mesh>> m_Meshes;
-		std::vector<Ref<Buffer>> m_TransformBuffers;
 		
-		Ref<AccelerationStructure> m_BottomLevelAS;
+		std::vector<Ref<AccelerationStructure>> m_BottomLevelStructures;
 
 		VkAccelerationStructureKHR m_Handle;
 		VkDeviceAddress m_DeviceAddress;
@@ -0,0 +1,226 @@
+#include "hgpch.h"
+#include "BindlessHeap.h"
+
+#include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Utils/RendererUtils.h"
+#include "Hog/Core/CVars.h"
+
+AutoCVar_Int CVar_BindlessTextureCount("renderer.bindless.textureCount", "Maximum number of textures in the bindless heap", 16384, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_BindlessStorageImageCount("renderer.bindless.storageImageCount", "Maximum number of storage images in the bindless heap", 1024, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_BindlessStorageBufferCount("renderer.bindless.storageBufferCount", "Maximum number of storage buffers in the bindless heap", 4096, CVarFlags::EditReadOnly);
+
+namespace Hog
+{
+	void BindlessHeap::InitializeImpl()
+	{
+		m_Device = GraphicsContext::GetDevice();
+		const auto& limits = GraphicsContext::GetGPUInfo()->Vulkan12Properties;
+
+		m_Slots[static_cast<size_t>(BindlessType::Texture)].Capacity = std::min(static_cast<uint32_t>(CVar_BindlessTextureCount.Get()), limits.maxDescriptorSetUpdateAfterBindSampledImages);
+		m_Slots[static_cast<size_t>(BindlessType::StorageImage)].Capacity = std::min(static_cast<uint32_t>(CVar_BindlessStorageImageCount.Get()), limits.maxDescriptorSetUpdateAfterBindStorageImages);
+		m_Slots[static_cast<size_t>(BindlessType::StorageBuffer)].Capacity = std::min(static_cast<uint32_t>(CVar_BindlessStorageBufferCount.Get()), limits.maxDescriptorSetUpdateAfterBindStorageBuffers);
+
+		const std::array<VkDescriptorType, static_cast<size_t>(BindlessType::Count)> types = {
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		};
+
+		std::array<VkDescriptorSetLayoutBinding, static_cast<size_t>(BindlessType::Count)> bindings;
+		std::array<VkDescriptorPoolSize, static_cast<size_t>(BindlessType::Count)> poolSizes;
+		std::array<VkDescriptorBindingFlags, static_cast<size_t>(BindlessType::Count)> bindingFlags;
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i] = {
+				.binding = i,
+				.descriptorType = types[i],
+				.descriptorCount = m_Slots[i].Capacity,
+				.stageFlags = VK_SHADER_STAGE_ALL,
+			};
+
+			poolSizes[i] = { types[i], m_Slots[i].Capacity };
+			bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+		}
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo layoutBindingFlags = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+			.pBindingFlags = bindingFlags.data(),
+		};
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.pNext = &layoutBindingFlags,
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data(),
+		};
+
+		CheckVkResult(vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_Layout));
+
+		VkDescriptorPoolCreateInfo poolInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data(),
+		};
+
+		CheckVkResult(vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_Pool));
+
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = m_Pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &m_Layout,
+		};
+
+		CheckVkResult(vkAllocateDescriptorSets(m_Device, &allocInfo, &m_Set));
+
+		m_Initialized = true;
+	}
+
+	void BindlessHeap::DeinitializeImpl()
+	{
+		vkDestroyDescriptorPool(m_Device, m_Pool, nullptr);
+		vkDestroyDescriptorSetLayout(m_Device, m_Layout, nullptr);
+
+		m_Pool = VK_NULL_HANDLE;
+		m_Layout = VK_NULL_HANDLE;
+		m_Set = VK_NULL_HANDLE;
+		m_Slots = {};
+		m_PendingReleases.clear();
+
+		m_Initialized = false;
+	}
+
+	uint32_t BindlessHeap::RegisterTextureImpl(VkSampler sampler, VkImageView view)
+	{
+		Initialize();
+
+		uint32_t index = AllocateIndex(BindlessType::Texture);
+
+		VkDescriptorImageInfo imageInfo = {
+			.sampler = sampler,
+			.imageView = view,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_Set,
+			.dstBinding = static_cast<uint32_t>(BindlessType::Texture),
+			.dstArrayElement = index,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &imageInfo,
+		};
+
+		vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	uint32_t BindlessHeap::RegisterStorageImageImpl(VkImageView view)
+	{
+		Initialize();
+
+		uint32_t index = AllocateIndex(BindlessType::StorageImage);
+
+		VkDescriptorImageInfo imageInfo = {
+			.imageView = view,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		};
+
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_Set,
+			.dstBinding = static_cast<uint32_t>(BindlessType::StorageImage),
+			.dstArrayElement = index,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &imageInfo,
+		};
+
+		vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	uint32_t BindlessHeap::RegisterStorageBufferImpl(VkBuffer buffer, VkDeviceSize range)
+	{
+		Initialize();
+
+		uint32_t index = AllocateIndex(BindlessType::StorageBuffer);
+
+		VkDescriptorBufferInfo bufferInfo = {
+			.buffer = buffer,
+			.offset = 0,
+			.range = range,
+		};
+
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_Set,
+			.dstBinding = static_cast<uint32_t>(BindlessType::StorageBuffer),
+			.dstArrayElement = index,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &bufferInfo,
+		};
+
+		vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	void BindlessHeap::ReleaseImpl(BindlessType type, uint32_t index)
+	{
+		if (!m_Initialized || index == InvalidIndex)
+			return;
+
+		// Frames still in flight may reference the index, so it is only recycled once they retire
+		m_PendingReleases.push_back({ type, index, m_FrameCount });
+	}
+
+	void BindlessHeap::NextFrameImpl()
+	{
+		m_FrameCount++;
+
+		uint64_t framesInFlight = static_cast<uint64_t>(*CVarSystem::Get()->GetIntCVar("renderer.frameCount"));
+		auto it = std::remove_if(m_PendingReleases.begin(), m_PendingReleases.end(), [this, framesInFlight](const PendingRelease& release)
+			{
+				if (m_FrameCount - release.Frame <= framesInFlight)
+					return false;
+
+				m_Slots[static_cast<size_t>(release.Type)].FreeList.push_back(release.Index);
+				return true;
+			});
+
+		m_PendingReleases.erase(it, m_PendingReleases.end());
+	}
+
+	void BindlessHeap::BindImpl(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout)
+	{
+		if (!m_Initialized)
+			return;
+
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, SetIndex, 1, &m_Set, 0, nullptr);
+	}
+
+	uint32_t BindlessHeap::AllocateIndex(BindlessType type)
+	{
+		auto& slots = m_Slots[static_cast<size_t>(type)];
+
+		if (!slots.FreeList.empty())
+		{
+			uint32_t index = slots.FreeList.back();
+			slots.FreeList.pop_back();
+			return index;
+		}
+
+		HG_CORE_ASSERT(slots.Next < slots.Capacity, "Bindless heap is full");
+
+		return slots.Next++;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <volk.h>
+
+namespace Hog
+{
+	enum class BindlessType : uint32_t
+	{
+		Texture = 0, StorageImage = 1, StorageBuffer = 2, Count
+	};
+
+	// Global update-after-bind descriptor set shared by every pipeline at set BindlessHeap::SetIndex.
+	// Resources register once and keep their index until they are released.
+	class BindlessHeap
+	{
+	public:
+		static constexpr uint32_t SetIndex = 1;
+		static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+		static BindlessHeap& Get()
+		{
+			static BindlessHeap instance;
+
+			return instance;
+		}
+
+		~BindlessHeap() { Deinitialize(); }
+		static void Initialize() { if (Get().m_Initialized == false) Get().InitializeImpl(); }
+		static void Deinitialize() { if (Get().m_Initialized == true) Get().DeinitializeImpl(); }
+
+		static uint32_t RegisterTexture(VkSampler sampler, VkImageView view) { return Get().RegisterTextureImpl(sampler, view); }
+		static uint32_t RegisterStorageImage(VkImageView view) { return Get().RegisterStorageImageImpl(view); }
+		static uint32_t RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE) { return Get().RegisterStorageBufferImpl(buffer, range); }
+		static void Release(BindlessType type, uint32_t index) { Get().ReleaseImpl(type, index); }
+
+		static void NextFrame() { Get().NextFrameImpl(); }
+		static void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) { Get().BindImpl(commandBuffer, bindPoint, layout); }
+		static VkDescriptorSetLayout GetLayout() { Initialize(); return Get().m_Layout; }
+	public:
+		BindlessHeap(BindlessHeap const&) = delete;
+		void operator=(BindlessHeap const&) = delete;
+	private:
+		BindlessHeap() = default;
+
+		void InitializeImpl();
+		void DeinitializeImpl();
+		uint32_t RegisterTextureImpl(VkSampler sampler, VkImageView view);
+		uint32_t RegisterStorageImageImpl(VkImageView view);
+		uint32_t RegisterStorageBufferImpl(VkBuffer buffer, VkDeviceSize range);
+		void ReleaseImpl(BindlessType type, uint32_t index);
+		void NextFrameImpl();
+		void BindImpl(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+		uint32_t AllocateIndex(BindlessType type);
+	private:
+		struct Slots
+		{
+			uint32_t Capacity = 0;
+			uint32_t Next = 0;
+			std::vector<uint32_t> FreeList;
+		};
+
+		struct PendingRelease
+		{
+			BindlessType Type;
+			uint32_t Index;
+			uint64_t Frame;
+		};
+
+		bool m_Initialized = false;
+
+		VkDevice m_Device = VK_NULL_HANDLE;
+		VkDescriptorPool m_Pool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_Layout = VK_NULL_HANDLE;
+		VkDescriptorSet m_Set = VK_NULL_HANDLE;
+
+		std::array<Slots, static_cast<size_t>(BindlessType::Count)> m_Slots;
+		std::vector<PendingRelease> m_PendingReleases;
+		uint64_t m_FrameCount = 0;
+	};
+}
@@ -3,6 +3,7 @@
 #include "Buffer.h"
 
 #include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Renderer/BindlessHeap.h"
 #include "Hog/Utils/RendererUtils.h"
 
 namespace Hog
@@ -22,6 +23,19 @@ namespace Hog
 			.sharingMode = static_cast<VkSharingMode>(description),
 		};
 
+		// Concurrent sharing needs more than one queue family, everything else is owned by one queue at a time
+		const auto& queueFamilies = GraphicsContext::GetQueueFamilies();
+		if (description.SharingMode == VK_SHARING_MODE_CONCURRENT && queueFamilies.size() > 1)
+		{
+			buffeCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+			buffeCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+			m_Concurrent = true;
+		}
+		else
+		{
+			buffeCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
+
 		VmaAllocationCreateInfo allocationCreateInfo =
 		{
 			.flags = description.AllocationCreateFlags,
@@ -37,6 +51,7 @@ namespace Hog
 
 	Buffer::~Buffer()
 	{
+		BindlessHeap::Release(BindlessType::StorageBuffer, m_GPUIndex);
 		vmaDestroyBuffer(GraphicsContext::GetAllocator(), m_Handle, m_Allocation);
 	}
 
@@ -64,28 +79,8 @@ namespace Hog
 
 			memcpy((void*)((size_t)memoryLocation + bufferOffset), (void*)((size_t)data + dataOffset), size);
 
-			VkBufferMemoryBarrier2 memoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-				.srcStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
-				.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT,
-				.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-				.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.buffer = m_Handle,
-				.size = m_Size,
-			};
-
-			VkDependencyInfo depenedencyInfo = {
-				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-				.bufferMemoryBarrierCount = 1,
-				.pBufferMemoryBarriers = &memoryBarrier,
-			};
-
-			GraphicsContext::ImmediateSubmit([depenedencyInfo](VkCommandBuffer commandBuffer)
-			{
-				vkCmdPipelineBarrier2(commandBuffer, &depenedencyInfo);
-			});
+			// Host writes are made visible to the device by the next queue submission, only non coherent memory needs a flush
+			CheckVkResult(vmaFlushAllocation(GraphicsContext::GetAllocator(), m_Allocation, bufferOffset, size));
 
 			if (memoryLocation != m_AllocationInfo.pMappedData)
 			{
@@ -95,12 +90,10 @@ namespace Hog
 		else
 		{
 			// Allocation ended up in a non-mappable memory - need to transfer.
-			auto stagingBuf = Buffer::Create(BufferDescription::Defaults::TransferSourceBuffer, size);
+			StagingAllocation staging = GraphicsContext::AllocateStaging(size);
 
 			// [Executed in runtime]:
-			stagingBuf->WriteData(data, size, 0, dataOffset);
-			
-			//vkCmdPipelineBarrier: VK_ACCESS_HOST_WRITE_BIT --> VK_ACCESS_TRANSFER_READ_BIT
+			memcpy(staging.Data, (void*)((size_t)data + dataOffset), size);
 
 			VkBufferMemoryBarrier2 memoryBarrier = {
 				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
@@ -124,9 +117,9 @@ namespace Hog
 			{
 				VkBufferCopy copy = {};
 				copy.dstOffset = bufferOffset;
-				copy.srcOffset = 0;
-				copy.size = stagingBuf->GetSize();
-				vkCmdCopyBuffer(commandBuffer, stagingBuf->GetHandle(), m_Handle, 1, &copy);
+				copy.srcOffset = staging.Offset;
+				copy.size = size;
+				vkCmdCopyBuffer(commandBuffer, staging.Buffer, m_Handle, 1, &copy);
 
 				vkCmdPipelineBarrier2(commandBuffer, &depenedencyInfo);
 			});
@@ -166,6 +159,7 @@ namespace Hog
 			{
 				vkCmdPipelineBarrier2(commandBuffer, &depenedencyInfo);
 			});
+			GraphicsContext::FlushUploadBatch();
 
 			memcpy((void*)((size_t)data + dataOffset), (void*)((size_t)m_AllocationInfo.pMappedData + bufferOffset), m_Size);
 		}
@@ -204,11 +198,22 @@ namespace Hog
 				copy.size = stagingBuf->GetSize();
 				vkCmdCopyBuffer(commandBuffer, m_Handle, stagingBuf->GetHandle(), 1, &copy);
 			});
+			GraphicsContext::FlushUploadBatch();
 
 			stagingBuf->ReadData(data, size, 0, dataOffset);
 		}
 	}
 
+	void Buffer::Invalidate(size_t offset, size_t size)
+	{
+		CheckVkResult(vmaInvalidateAllocation(GraphicsContext::GetAllocator(), m_Allocation, offset, size));
+	}
+
+	void Buffer::Flush(size_t offset, size_t size)
+	{
+		CheckVkResult(vmaFlushAllocation(GraphicsContext::GetAllocator(), m_Allocation, offset, size));
+	}
+
 	VkDeviceAddress Buffer::GetBufferDeviceAddress()
 	{
 		VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
@@ -217,6 +222,18 @@ namespace Hog
 		return vkGetBufferDeviceAddressKHR(GraphicsContext::GetDevice(), &bufferDeviceAI);
 	}
 
+	uint32_t Buffer::GetGPUIndex()
+	{
+		HG_CORE_ASSERT(m_Description.BufferUsageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "Only storage buffers can be placed in the bindless heap");
+
+		if (m_GPUIndex == BindlessHeap::InvalidIndex)
+		{
+			m_GPUIndex = BindlessHeap::RegisterStorageBuffer(m_Handle, m_Size);
+		}
+
+		return m_GPUIndex;
+	}
+
 	Ref<BufferRegion> BufferRegion::Create(Ref<Buffer> buffer, size_t offset, size_t size)
 	{
 		return CreateRef<BufferRegion>(buffer, offset, size);
@@ -20,11 +20,17 @@ namespace Hog {
 
 		void WriteData(void* data, size_t size, size_t bufferOffset = 0, size_t dataOffset = 0);
 		void ReadData(void* data, size_t size, size_t bufferOffset = 0, size_t dataOffset = 0);
+		// Makes device writes visible to the mapped pointer on non coherent memory
+		void Invalidate(size_t offset = 0, size_t size = VK_WHOLE_SIZE);
+		// Makes host writes through the mapped pointer visible to the device on non coherent memory
+		void Flush(size_t offset = 0, size_t size = VK_WHOLE_SIZE);
 		const VkBuffer& GetHandle() const { return m_Handle; }
 		size_t GetSize() const { return m_Size; }
 		BufferDescription GetBufferDescription() const { return m_Description; }
+		bool IsConcurrent() const { return m_Concurrent; }
 
 		VkDeviceAddress GetBufferDeviceAddress();
+		uint32_t GetGPUIndex();
 
 		operator void* () { return m_AllocationInfo.pMappedData; }
 	private:
@@ -34,6 +40,8 @@ namespace Hog {
 
 		BufferDescription m_Description;
 		size_t m_Size;
+		uint32_t m_GPUIndex = UINT32_MAX;
+		bool m_Concurrent = false;
 	};
 
 	class BufferRegion
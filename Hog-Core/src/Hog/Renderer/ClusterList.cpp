@@ -0,0 +1,81 @@
+#include "hgpch.h"
+#include "ClusterList.h"
+
+namespace Hog
+{
+	Ref<ClusterList> ClusterList::Create(const std::vector<Ref<Mesh>>& meshes)
+	{
+		return CreateRef<ClusterList>(meshes);
+	}
+
+	ClusterList::ClusterList(const std::vector<Ref<Mesh>>& meshes)
+	{
+		std::vector<DrawCluster> clusters;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> meshletTriangles;
+		for (const auto& mesh : meshes)
+		{
+			// The clusters keep the mesh's scene buffer slots, which adding instances would move
+			mesh->LockInstances();
+
+			for (const auto& primitive : *mesh)
+			{
+				// Instances share the meshlet buffers, only the clusters are repeated per instance
+				const Util::MeshletData& data = primitive.GetMeshlets();
+				uint32_t firstVertex = static_cast<uint32_t>(meshletVertices.size());
+				uint32_t firstTriangle = static_cast<uint32_t>(meshletTriangles.size());
+
+				meshletVertices.insert(meshletVertices.end(), data.Vertices.begin(), data.Vertices.end());
+				for (size_t t = 0; t < data.Triangles.size(); t += 3)
+				{
+					meshletTriangles.push_back(static_cast<uint32_t>(data.Triangles[t] | data.Triangles[t + 1] << 8 | data.Triangles[t + 2] << 16));
+				}
+
+				for (const auto& meshlet : data.Meshlets)
+				{
+					DrawCluster cluster = {
+						.BoundingSphere = meshlet.BoundingSphere,
+						.Cone = meshlet.Cone,
+						.FirstIndex = primitive.GetFirstIndex() + meshlet.TriangleOffset * 3,
+						.IndexCount = meshlet.TriangleCount * 3,
+						.VertexOffset = static_cast<int32_t>(primitive.GetFirstVertex()),
+						.Wide = primitive.GetIndexType() == VK_INDEX_TYPE_UINT32 ? 1u : 0u,
+						.MeshletVertexOffset = firstVertex + meshlet.VertexOffset,
+						.MeshletTriangleOffset = firstTriangle + meshlet.TriangleOffset,
+						.VertexCount = meshlet.VertexCount,
+						.TriangleCount = meshlet.TriangleCount,
+					};
+
+					for (uint32_t i = 0; i < mesh->GetInstanceCount(); i++)
+					{
+						cluster.InstanceIndex = primitive.GetInstanceIndex() + i;
+						clusters.push_back(cluster);
+					}
+				}
+			}
+		}
+
+		HG_CORE_ASSERT(!clusters.empty(), "Cluster list needs meshes built with renderer.meshlets");
+		m_ClusterCount = static_cast<uint32_t>(clusters.size());
+
+		m_ClusterBuffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, clusters.size() * sizeof(DrawCluster));
+		m_ClusterBuffer->WriteData(clusters.data(), m_ClusterBuffer->GetSize());
+
+		m_MeshletVertexBuffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, meshletVertices.size() * sizeof(uint32_t));
+		m_MeshletVertexBuffer->WriteData(meshletVertices.data(), m_MeshletVertexBuffer->GetSize());
+
+		m_MeshletTriangleBuffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, meshletTriangles.size() * sizeof(uint32_t));
+		m_MeshletTriangleBuffer->WriteData(meshletTriangles.data(), m_MeshletTriangleBuffer->GetSize());
+
+		// Same layout as a DrawList's, clusters keep full detail so the culling pass ignores the level of detail fields
+		m_CommandBuffer = Buffer::Create(BufferDescription::Defaults::IndirectBuffer, DrawList::CommandOffset + 2 * clusters.size() * DrawList::CommandStride);
+
+		DrawCommandHeader header = {
+			.Count = 0,
+			.WideCount = 0,
+			.ObjectCount = m_ClusterCount,
+			.Capacity = m_ClusterCount,
+		};
+		m_CommandBuffer->WriteData(&header, sizeof(header));
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/DrawList.h"
+#include "Hog/Renderer/Mesh.h"
+
+namespace Hog
+{
+	// Per meshlet instance data the cluster culling pass tests, laid out for std430. The transform is read from the scene buffer
+	struct DrawCluster
+	{
+		// Object space center in xyz and radius in w
+		glm::vec4 BoundingSphere;
+		// Object space normal cone, see Util::Meshlet
+		glm::vec4 Cone;
+		// Triangles of the meshlet in the arena's index buffer, in elements of the primitive's index type
+		uint32_t FirstIndex;
+		uint32_t IndexCount;
+		int32_t VertexOffset;
+		uint32_t InstanceIndex;
+		// Non zero for primitives with 32 bit indices
+		uint32_t Wide;
+		// Local vertices and triangles of the meshlet in the list's meshlet buffers, only read by mesh shaders
+		uint32_t MeshletVertexOffset;
+		uint32_t MeshletTriangleOffset;
+		uint32_t VertexCount;
+		uint32_t TriangleCount;
+		uint32_t Padding[3];
+	};
+
+	// Every meshlet of every primitive instance of a set of meshes, for culling finer than whole primitives.
+	// The meshes have to be built with renderer.meshlets. Clusters always draw the full detail level.
+	//
+	// Without mesh shaders a compute stage with the command buffer as its DispatchBuffer culls the clusters and writes one
+	// indirect draw per survivor, laid out like a DrawList's, so a graphics stage draws them the same way.
+	// With mesh shaders a graphics stage with a task and a mesh shader and GetTaskGroupCounts as its GroupCounts culls
+	// and draws the clusters by itself, fetching vertices through the meshlet buffers instead of the index buffer.
+	class ClusterList
+	{
+	public:
+		// Clusters every task shader workgroup tests
+		static constexpr uint32_t TaskGroupSize = 32;
+	public:
+		static Ref<ClusterList> Create(const std::vector<Ref<Mesh>>& meshes);
+	public:
+		ClusterList(const std::vector<Ref<Mesh>>& meshes);
+
+		Ref<Buffer> GetClusterBuffer() const { return m_ClusterBuffer; }
+		Ref<Buffer> GetCommandBuffer() const { return m_CommandBuffer; }
+		// Primitive relative vertex of every meshlet local vertex
+		Ref<Buffer> GetMeshletVertexBuffer() const { return m_MeshletVertexBuffer; }
+		// Three 8 bit local vertices per triangle, packed into the low bytes of a uint
+		Ref<Buffer> GetMeshletTriangleBuffer() const { return m_MeshletTriangleBuffer; }
+		uint32_t GetClusterCount() const { return m_ClusterCount; }
+		// Group count of a culling dispatch with one thread per cluster
+		glm::ivec3 GetGroupCounts() const { return { static_cast<int>((GetClusterCount() + DrawList::GroupSize - 1) / DrawList::GroupSize), 1, 1 }; }
+		// Group count of a task shader draw with one thread per cluster
+		glm::ivec3 GetTaskGroupCounts() const { return { static_cast<int>((GetClusterCount() + TaskGroupSize - 1) / TaskGroupSize), 1, 1 }; }
+	private:
+		uint32_t m_ClusterCount = 0;
+
+		Ref<Buffer> m_ClusterBuffer;
+		Ref<Buffer> m_CommandBuffer;
+		Ref<Buffer> m_MeshletVertexBuffer;
+		Ref<Buffer> m_MeshletTriangleBuffer;
+	};
+}
@@ -305,6 +305,16 @@ namespace Hog {
 		return Build(set, layout);
 	}
 
+	void DescriptorBuilder::Update(VkDescriptorSet set)
+	{
+		//rewrite an already allocated set with the same layout
+		for (VkWriteDescriptorSet& w : m_Writes) {
+			w.dstSet = set;
+		}
+
+		vkUpdateDescriptorSets(m_Alloc->Device, static_cast<uint32_t>(m_Writes.size()), m_Writes.data(), 0, nullptr);
+	}
+
 
 	bool DescriptorLayoutCache::DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo& other) const
 	{
@@ -97,6 +97,7 @@ namespace Hog {
 
 		bool Build(VkDescriptorSet& set, VkDescriptorSetLayout& layout);
 		bool Build(VkDescriptorSet& set);
+		void Update(VkDescriptorSet set);
 	private:
 
 		std::vector<VkWriteDescriptorSet> m_Writes;
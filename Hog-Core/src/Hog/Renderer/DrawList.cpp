@@ -0,0 +1,75 @@
+#include "hgpch.h"
+#include "DrawList.h"
+
+namespace Hog
+{
+	Ref<DrawList> DrawList::Create(const std::vector<Ref<Mesh>>& meshes, bool occlusionCulling, uint32_t lodBias)
+	{
+		return CreateRef<DrawList>(meshes, occlusionCulling, lodBias);
+	}
+
+	DrawList::DrawList(const std::vector<Ref<Mesh>>& meshes, bool occlusionCulling, uint32_t lodBias)
+	{
+		std::vector<DrawObject> objects;
+		for (const auto& mesh : meshes)
+		{
+			// The objects keep the mesh's scene buffer slots, which adding instances would move
+			mesh->LockInstances();
+
+			// Instances are culled one by one
+			for (const auto& primitive : *mesh)
+			{
+				DrawObject object = {
+					.BoundingSphere = primitive.GetBoundingSphere(),
+					.VertexOffset = static_cast<int32_t>(primitive.GetFirstVertex()),
+					.Wide = primitive.GetIndexType() == VK_INDEX_TYPE_UINT32 ? 1u : 0u,
+					.LodCount = static_cast<uint32_t>(primitive.GetLods().size()),
+				};
+
+				for (uint32_t l = 0; l < object.LodCount; l++)
+				{
+					const MeshLod& lod = primitive.GetLods()[l];
+					object.Lods[l] = { primitive.GetFirstIndex() + lod.FirstIndex, lod.IndexCount, lod.Error, 0 };
+				}
+
+				for (uint32_t i = 0; i < mesh->GetInstanceCount(); i++)
+				{
+					object.InstanceIndex = primitive.GetInstanceIndex() + i;
+					objects.push_back(object);
+				}
+			}
+		}
+
+		HG_CORE_ASSERT(!objects.empty(), "Draw list needs at least one built mesh primitive");
+		m_ObjectCount = static_cast<uint32_t>(objects.size());
+
+		// Transforms live in the scene buffer, so the objects never change after this upload
+		m_ObjectBuffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, objects.size() * sizeof(DrawObject));
+		m_ObjectBuffer->WriteData(objects.data(), m_ObjectBuffer->GetSize());
+
+		// Every object may survive culling, and the index type sections are drawn separately so each gets room for all of them
+		m_CommandBuffer = Buffer::Create(BufferDescription::Defaults::IndirectBuffer, CommandOffset + 2 * objects.size() * CommandStride);
+
+		DrawCommandHeader header = {
+			.Count = 0,
+			.WideCount = 0,
+			.ObjectCount = m_ObjectCount,
+			.Capacity = m_ObjectCount,
+			// Depends on the extent of the stage drawing the list, so it is left to the culling stage
+			.LodPixelScale = 0.0f,
+			.LodBias = lodBias,
+		};
+		m_CommandBuffer->WriteData(&header, sizeof(header));
+
+		if (occlusionCulling)
+		{
+			m_LateCommandBuffer = Buffer::Create(BufferDescription::Defaults::IndirectBuffer, m_CommandBuffer->GetSize());
+			m_LateCommandBuffer->WriteData(&header, sizeof(header));
+
+			// Nothing counts as visible in the first frame, so the late pass tests everything against an empty pyramid
+			std::vector<uint32_t> visibility(m_ObjectCount, 0);
+			m_VisibilityBuffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, visibility.size() * sizeof(uint32_t));
+			m_VisibilityBuffer->WriteData(visibility.data(), m_VisibilityBuffer->GetSize());
+		}
+	}
+}
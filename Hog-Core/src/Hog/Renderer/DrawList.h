@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/Mesh.h"
+
+namespace Hog
+{
+	// Level of detail of a DrawObject, the first index is into the arena in elements of the primitive's index type
+	struct DrawLod
+	{
+		uint32_t FirstIndex;
+		uint32_t IndexCount;
+		float Error;
+		uint32_t Padding;
+	};
+
+	// Per primitive data the culling pass tests, laid out for std430. The transform is read from the scene buffer
+	struct DrawObject
+	{
+		// Object space center in xyz and radius in w
+		glm::vec4 BoundingSphere;
+		int32_t VertexOffset;
+		uint32_t InstanceIndex;
+		// Non zero for primitives with 32 bit indices
+		uint32_t Wide;
+		uint32_t LodCount;
+		// Finest first, entries past LodCount are unused
+		DrawLod Lods[MeshPrimitive::MaxLodCount];
+	};
+
+	// Header in front of the draw commands, the culling pass appends 16 bit draws to Count and 32 bit draws to WideCount
+	struct DrawCommandHeader
+	{
+		uint32_t Count;
+		uint32_t WideCount;
+		uint32_t ObjectCount;
+		// Commands per section, the 32 bit section starts after the 16 bit one
+		uint32_t Capacity;
+		// Level of detail selection as in Mesh::SelectLods, the culling stage writes the scale every frame
+		float LodPixelScale;
+		uint32_t LodBias;
+		uint32_t Padding[2];
+	};
+
+	// Every primitive instance of a set of meshes as one GPU culled indirect draw.
+	// A compute stage with the command buffer as its DispatchBuffer resets the count and fills in the surviving draws,
+	// a graphics stage with the same DispatchBuffer then draws them with one vkCmdDrawIndexedIndirectCount per index type.
+	//
+	// With occlusion culling the list also keeps which objects were visible last frame and a second command buffer.
+	// The early pass draws last frame's visible set, a DepthPyramid stage reduces its depth, and the late pass
+	// tests every object against the pyramid, draws the newly visible ones and records the visibility for the next frame.
+	//
+	// The culling pass also picks each object's level of detail from the projected error, for the render extent
+	// of the stage drawing the list and renderer.lod.threshold. Lists for passes like shadows can ask for lodBias coarser levels.
+	class DrawList
+	{
+	public:
+		static constexpr VkDeviceSize CountOffset = offsetof(DrawCommandHeader, Count);
+		static constexpr VkDeviceSize WideCountOffset = offsetof(DrawCommandHeader, WideCount);
+		// Bytes of the header the culling pass resets
+		static constexpr VkDeviceSize CountSize = offsetof(DrawCommandHeader, ObjectCount);
+		static constexpr VkDeviceSize LodPixelScaleOffset = offsetof(DrawCommandHeader, LodPixelScale);
+		static constexpr VkDeviceSize CommandOffset = sizeof(DrawCommandHeader);
+		static constexpr uint32_t CommandStride = sizeof(VkDrawIndexedIndirectCommand);
+		static constexpr uint32_t GroupSize = 64;
+
+		// Draws each section of the command buffer can hold
+		static uint32_t GetMaxDrawCount(const Ref<Buffer>& commandBuffer) { return static_cast<uint32_t>((commandBuffer->GetSize() - CommandOffset) / (2 * CommandStride)); }
+		// Start of the 32 bit index draws
+		static VkDeviceSize GetWideCommandOffset(const Ref<Buffer>& commandBuffer) { return CommandOffset + static_cast<VkDeviceSize>(GetMaxDrawCount(commandBuffer)) * CommandStride; }
+	public:
+		static Ref<DrawList> Create(const std::vector<Ref<Mesh>>& meshes, bool occlusionCulling = false, uint32_t lodBias = 0);
+	public:
+		DrawList(const std::vector<Ref<Mesh>>& meshes, bool occlusionCulling, uint32_t lodBias);
+
+		Ref<Buffer> GetObjectBuffer() const { return m_ObjectBuffer; }
+		Ref<Buffer> GetCommandBuffer() const { return m_CommandBuffer; }
+		// One uint per object, only created with occlusion culling
+		Ref<Buffer> GetVisibilityBuffer() const { return m_VisibilityBuffer; }
+		// Draws of the late pass, only created with occlusion culling
+		Ref<Buffer> GetLateCommandBuffer() const { return m_LateCommandBuffer; }
+		uint32_t GetObjectCount() const { return m_ObjectCount; }
+		// Group count of a culling dispatch with one thread per object
+		glm::ivec3 GetGroupCounts() const { return { static_cast<int>((GetObjectCount() + GroupSize - 1) / GroupSize), 1, 1 }; }
+	private:
+		uint32_t m_ObjectCount = 0;
+
+		Ref<Buffer> m_ObjectBuffer;
+		Ref<Buffer> m_CommandBuffer;
+		Ref<Buffer> m_VisibilityBuffer;
+		Ref<Buffer> m_LateCommandBuffer;
+	};
+}
@@ -0,0 +1,172 @@
+#include "hgpch.h"
+#include "GeometryArena.h"
+
+#include "Hog/Core/CVars.h"
+
+AutoCVar_Int CVar_GeometryVertexCount("renderer.geometry.vertexCount", "Number of vertices the shared vertex buffer holds across all meshes, the buffer is allocated up front", 1024 * 1024, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_GeometryCompactVertices("renderer.geometry.compactVertices", "Store vertices as 24 byte CompactVertex instead of full float Vertex, mesh pipelines need VertexFormat::Compact", 0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_GeometryPositionStream("renderer.geometry.positionStream", "Keep a separate position only copy of the vertices, pipelines using VertexStream::Position need it", 0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_GeometryIndexCount("renderer.geometry.indexCount", "Number of 16 bit indices the shared index buffer holds across all meshes, 32 bit indices take two", 4 * 1024 * 1024, CVarFlags::EditReadOnly);
+
+namespace Hog
+{
+	void RangeAllocator::Init(uint32_t capacity)
+	{
+		m_FreeRanges.clear();
+		m_FreeRanges[0] = capacity;
+		m_Capacity = capacity;
+		m_Used = 0;
+	}
+
+	uint32_t RangeAllocator::Allocate(uint32_t count, uint32_t alignment)
+	{
+		for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+		{
+			uint32_t padding = (alignment - it->first % alignment) % alignment;
+			if (it->second < padding + count)
+				continue;
+
+			uint32_t offset = it->first + padding;
+			uint32_t remaining = it->second - padding - count;
+
+			if (padding > 0)
+			{
+				it->second = padding;
+			}
+			else
+			{
+				m_FreeRanges.erase(it);
+			}
+
+			if (remaining > 0)
+			{
+				m_FreeRanges[offset + count] = remaining;
+			}
+
+			m_Used += count;
+			return offset;
+		}
+
+		return InvalidOffset;
+	}
+
+	void RangeAllocator::Free(uint32_t offset, uint32_t count)
+	{
+		m_Used -= count;
+
+		auto next = m_FreeRanges.lower_bound(offset);
+		if (next != m_FreeRanges.end() && offset + count == next->first)
+		{
+			count += next->second;
+			next = m_FreeRanges.erase(next);
+		}
+
+		if (next != m_FreeRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				previous->second += count;
+				return;
+			}
+		}
+
+		m_FreeRanges[offset] = count;
+	}
+
+	void GeometryArena::InitializeImpl()
+	{
+		uint32_t vertexCount = static_cast<uint32_t>(CVar_GeometryVertexCount.Get());
+		uint32_t indexCount = static_cast<uint32_t>(CVar_GeometryIndexCount.Get());
+		m_VertexFormat = CVar_GeometryCompactVertices.Get() ? VertexFormat::Compact : VertexFormat::Full;
+		size_t vertexStride = m_VertexFormat == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+		size_t positionStride = m_VertexFormat == VertexFormat::Compact ? sizeof(CompactVertex::Position) : sizeof(glm::vec3);
+
+		m_VertexBuffer = Buffer::Create(BufferDescription::Defaults::GeometryVertexBuffer, static_cast<size_t>(vertexCount) * vertexStride);
+		if (CVar_GeometryPositionStream.Get())
+		{
+			m_PositionBuffer = Buffer::Create(BufferDescription::Defaults::GeometryVertexBuffer, static_cast<size_t>(vertexCount) * positionStride);
+		}
+		m_IndexBuffer = Buffer::Create(BufferDescription::Defaults::GeometryIndexBuffer, static_cast<size_t>(indexCount) * sizeof(uint16_t));
+		m_Vertices.Init(vertexCount);
+		m_Indices.Init(indexCount);
+
+		m_Initialized = true;
+	}
+
+	void GeometryArena::DeinitializeImpl()
+	{
+		m_VertexBuffer.reset();
+		m_PositionBuffer.reset();
+		m_IndexBuffer.reset();
+		m_PendingFrees.clear();
+
+		m_Initialized = false;
+	}
+
+	GeometryAllocation GeometryArena::AllocateImpl(RangeAllocator& allocator, uint32_t count, uint32_t alignment)
+	{
+		uint32_t offset = allocator.Allocate(count, alignment);
+		HG_CORE_ASSERT(offset != RangeAllocator::InvalidOffset, "Geometry arena is full, raise renderer.geometry.vertexCount or renderer.geometry.indexCount");
+
+		return { offset, count };
+	}
+
+	GeometryAllocation GeometryArena::AllocateIndicesImpl(uint32_t count, VkIndexType indexType)
+	{
+		uint32_t scale = indexType == VK_INDEX_TYPE_UINT32 ? 2 : 1;
+
+		// 32 bit ranges start on a 4 byte boundary so their offset is a whole number of 32 bit indices
+		GeometryAllocation allocation = AllocateImpl(m_Indices, count * scale, scale);
+
+		return { allocation.Offset / scale, count };
+	}
+
+	void GeometryArena::FreeImpl(RangeAllocator& allocator, GeometryAllocation allocation)
+	{
+		if (!m_Initialized || allocation.Count == 0)
+			return;
+
+		// Frames still in flight may draw from the range, so it is only reused once they retire
+		m_PendingFrees.push_back({ &allocator, allocation, m_FrameCount });
+	}
+
+	void GeometryArena::NextFrameImpl()
+	{
+		m_FrameCount++;
+
+		uint64_t framesInFlight = static_cast<uint64_t>(*CVarSystem::Get()->GetIntCVar("renderer.frameCount"));
+		auto it = std::remove_if(m_PendingFrees.begin(), m_PendingFrees.end(), [this, framesInFlight](const PendingFree& pending)
+			{
+				if (m_FrameCount - pending.Frame <= framesInFlight)
+					return false;
+
+				pending.Allocator->Free(pending.Allocation.Offset, pending.Allocation.Count);
+				return true;
+			});
+
+		m_PendingFrees.erase(it, m_PendingFrees.end());
+	}
+
+	void GeometryArena::BindImpl(VkCommandBuffer commandBuffer, VertexStream stream)
+	{
+		if (!m_Initialized)
+			return;
+
+		HG_CORE_ASSERT(stream != VertexStream::Position || m_PositionBuffer, "The position stream needs renderer.geometry.positionStream");
+
+		VkBuffer vertexBuffers[] = { stream == VertexStream::Position ? m_PositionBuffer->GetHandle() : m_VertexBuffer->GetHandle() };
+		VkDeviceSize offsets[] = { 0 };
+
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		BindIndicesImpl(commandBuffer, VK_INDEX_TYPE_UINT16);
+	}
+
+	void GeometryArena::BindIndicesImpl(VkCommandBuffer commandBuffer, VkIndexType indexType)
+	{
+		if (!m_Initialized)
+			return;
+
+		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->GetHandle(), 0, indexType);
+	}
+}
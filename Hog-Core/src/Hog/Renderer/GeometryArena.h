@@ -0,0 +1,118 @@
+#pragma once
+
+#include <map>
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+
+namespace Hog
+{
+	// Range of vertices or indices inside one of the arena buffers, in elements so it can be passed to draws as is
+	struct GeometryAllocation
+	{
+		uint32_t Offset = 0;
+		uint32_t Count = 0;
+	};
+
+	// First fit allocator over [0, capacity), freed ranges are merged with their neighbours
+	class RangeAllocator
+	{
+	public:
+		static constexpr uint32_t InvalidOffset = UINT32_MAX;
+
+		void Init(uint32_t capacity);
+		// Offset is a multiple of alignment, skipped elements stay free
+		uint32_t Allocate(uint32_t count, uint32_t alignment = 1);
+		void Free(uint32_t offset, uint32_t count);
+
+		uint32_t GetCapacity() const { return m_Capacity; }
+		uint32_t GetUsed() const { return m_Used; }
+	private:
+		// Offset to count of every free range
+		std::map<uint32_t, uint32_t> m_FreeRanges;
+		uint32_t m_Capacity = 0;
+		uint32_t m_Used = 0;
+	};
+
+	// Device local vertex and index buffers every mesh sub-allocates from.
+	// Stages bind them once and draw with firstIndex and vertexOffset instead of rebinding per primitive.
+	// 16 and 32 bit indices share the index buffer, which is managed in 16 bit elements. Index allocations
+	// are returned in elements of their own type, so switching types only needs BindIndices.
+	// Vertices are all Vertex or, with renderer.geometry.compactVertices, all CompactVertex.
+	// With renderer.geometry.positionStream their positions are also kept in a separate stream at the same element offsets,
+	// so depth only passes fetch nothing else.
+	class GeometryArena
+	{
+	public:
+		static GeometryArena& Get()
+		{
+			static GeometryArena instance;
+
+			return instance;
+		}
+
+		~GeometryArena() { Deinitialize(); }
+		static void Initialize() { if (Get().m_Initialized == false) Get().InitializeImpl(); }
+		static void Deinitialize() { if (Get().m_Initialized == true) Get().DeinitializeImpl(); }
+
+		static GeometryAllocation AllocateVertices(uint32_t count) { Initialize(); return Get().AllocateImpl(Get().m_Vertices, count); }
+		static GeometryAllocation AllocateIndices(uint32_t count, VkIndexType indexType = VK_INDEX_TYPE_UINT16) { Initialize(); return Get().AllocateIndicesImpl(count, indexType); }
+		static void FreeVertices(GeometryAllocation allocation) { Get().FreeImpl(Get().m_Vertices, allocation); }
+		static void FreeIndices(GeometryAllocation allocation, VkIndexType indexType = VK_INDEX_TYPE_UINT16) { Get().FreeImpl(Get().m_Indices, ToIndexElements(allocation, indexType)); }
+
+		static void NextFrame() { Get().NextFrameImpl(); }
+		// Binds the vertex buffer of the stream and the index buffer as 16 bit indices
+		static void Bind(VkCommandBuffer commandBuffer, VertexStream stream = VertexStream::Interleaved) { Get().BindImpl(commandBuffer, stream); }
+		static void BindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) { Get().BindIndicesImpl(commandBuffer, indexType); }
+
+		static Ref<Buffer> GetVertexBuffer() { Initialize(); return Get().m_VertexBuffer; }
+		static Ref<Buffer> GetIndexBuffer() { Initialize(); return Get().m_IndexBuffer; }
+		// Null unless renderer.geometry.positionStream is set
+		static Ref<Buffer> GetPositionBuffer() { Initialize(); return Get().m_PositionBuffer; }
+		static bool HasPositionStream() { return GetPositionBuffer() != nullptr; }
+		static VertexFormat GetVertexFormat() { Initialize(); return Get().m_VertexFormat; }
+		static uint32_t GetVertexStride() { return GetVertexFormat() == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex); }
+		// Positions are glm::vec3, or CompactVertex::Position with compact vertices
+		static uint32_t GetPositionStride() { return GetVertexFormat() == VertexFormat::Compact ? sizeof(CompactVertex::Position) : sizeof(glm::vec3); }
+	public:
+		GeometryArena(GeometryArena const&) = delete;
+		void operator=(GeometryArena const&) = delete;
+	private:
+		GeometryArena() = default;
+
+		void InitializeImpl();
+		void DeinitializeImpl();
+		GeometryAllocation AllocateImpl(RangeAllocator& allocator, uint32_t count, uint32_t alignment = 1);
+		GeometryAllocation AllocateIndicesImpl(uint32_t count, VkIndexType indexType);
+		void FreeImpl(RangeAllocator& allocator, GeometryAllocation allocation);
+		void NextFrameImpl();
+		void BindImpl(VkCommandBuffer commandBuffer, VertexStream stream);
+		void BindIndicesImpl(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+		// 16 bit elements of the index buffer an allocation of the given index type covers
+		static GeometryAllocation ToIndexElements(GeometryAllocation allocation, VkIndexType indexType)
+		{
+			uint32_t scale = indexType == VK_INDEX_TYPE_UINT32 ? 2 : 1;
+			return { allocation.Offset * scale, allocation.Count * scale };
+		}
+	private:
+		struct PendingFree
+		{
+			RangeAllocator* Allocator;
+			GeometryAllocation Allocation;
+			uint64_t Frame;
+		};
+
+		bool m_Initialized = false;
+
+		VertexFormat m_VertexFormat = VertexFormat::Full;
+		Ref<Buffer> m_VertexBuffer;
+		Ref<Buffer> m_PositionBuffer;
+		Ref<Buffer> m_IndexBuffer;
+		RangeAllocator m_Vertices;
+		RangeAllocator m_Indices;
+		std::vector<PendingFree> m_PendingFrees;
+		uint64_t m_FrameCount = 0;
+	};
+}
@@ -7,7 +7,16 @@
 
 AutoCVar_Int CVar_MSAA("renderer.enableMSAA", "Enables MSAA for renderer", 0, CVarFlags::EditReadOnly);
 AutoCVar_Int CVar_ValidationLayers("renderer.enableValidationLayers", "Enables Vulkan validation layers", 1, CVarFlags::EditReadOnly);
-AutoCVar_Int CVar_FrameCount("renderer.frameCount", "Number off frames being rendered", 2, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_FrameCount("renderer.frameCount", "Number of frames in flight, the CPU records at most this many frames ahead of the GPU", 2, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_SwapchainImageCount("renderer.swapchainImageCount", "Minimum number of swapchain images, clamped to what the surface supports", 3, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_Headless("renderer.headless", "Render into offscreen images without a window, surface or swapchain", 0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_HeadlessWidth("renderer.headlessWidth", "Width of the offscreen images rendered in headless mode", 1600, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_HeadlessHeight("renderer.headlessHeight", "Height of the offscreen images rendered in headless mode", 900, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_PresentMode("renderer.presentMode", "Present mode, 0 FIFO, 1 mailbox, 2 immediate. Falls back to FIFO when unsupported", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_StagingChunkSize("renderer.stagingChunkSize", "Bytes per staging chunk upload batches allocate from, larger uploads get a dedicated chunk", 16 * 1024 * 1024, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_TransferQueue("renderer.enableTransferQueue", "Stream uploads through a dedicated transfer queue when available", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_MeshShaders("renderer.enableMeshShaders", "Enable VK_EXT_mesh_shader when available, stages fall back to vertex shaders and compute culling without it", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_AsyncCompute("renderer.enableAsyncCompute", "Use a dedicated compute queue for async compute stages when available", 1, CVarFlags::EditReadOnly);
 
 namespace Hog {
 
@@ -73,9 +82,14 @@ namespace Hog {
 
 	static VkPresentModeKHR ChoosePresentMode(std::vector<VkPresentModeKHR>& modes)
 	{
-		const VkPresentModeKHR desiredMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		VkPresentModeKHR desiredMode = VK_PRESENT_MODE_FIFO_KHR;
+		switch (CVar_PresentMode.Get())
+		{
+			case 1: desiredMode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+			case 2: desiredMode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+			default: break;
+		}
 
-		// Favor looking for mailbox mode.
 		for (int i = 0; i < modes.size(); ++i)
 		{
 			if (modes[i] == desiredMode)
@@ -84,7 +98,8 @@ namespace Hog {
 			}
 		}
 
-		// If we couldn't find mailbox, then default to FIFO which is always available.
+		// If we couldn't find the requested mode, then default to FIFO which is always available.
+		HG_CORE_WARN("Requested present mode is not supported, falling back to FIFO");
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
@@ -139,16 +154,32 @@ namespace Hog {
 
 		CheckVkResult(volkInitialize());
 
+		m_Headless = CVar_Headless.Get();
+		if (m_Headless)
+		{
+			std::erase_if(m_DeviceExtensions, [](const char* extension) { return std::strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; });
+		}
+
 		CreateInstance();
 		SetupDebugMessenger();
-		Application::Get().GetWindow().CreateSurface(m_Instance, nullptr, &(m_Surface));
+		if (!m_Headless)
+		{
+			Application::Get().GetWindow().CreateSurface(m_Instance, nullptr, &(m_Surface));
+		}
 		EnumeratePhysicalDevices();
 		SelectPhysicalDevice();
 		CreateLogicalDeviceAndQueues();
 		InitializeAllocator();
 		CreateCommandPools();
 		CreateCommandBuffers();
-		CreateSwapChain();
+		if (m_Headless)
+		{
+			CreateOffscreenTargets();
+		}
+		else
+		{
+			CreateSwapChain();
+		}
 
 		HG_PROFILE_GPU_INIT_VULKAN(&m_Device, &m_PhysicalDevice, &m_Queue, &m_QueueFamilyIndex, 1, nullptr);
 
@@ -162,16 +193,37 @@ namespace Hog {
 			image.reset();
 		}
 
-		vkDestroySwapchainKHR(m_Device, m_Swapchain, nullptr);
+		if (m_Swapchain != VK_NULL_HANDLE)
+		{
+			vkDestroySwapchainKHR(m_Device, m_Swapchain, nullptr);
+			m_Swapchain = VK_NULL_HANDLE;
+		}
+
+		if (m_UploadBatchDepth == 0)
+		{
+			SubmitUploads();
+		}
+
+		vkDeviceWaitIdle(m_Device);
+		RetireUploads();
+		m_PendingUploads.clear();
+		m_UploadResources.clear();
+		m_UploadStaging.clear();
+		m_StagingChunk.reset();
+		m_FreeStagingChunks.clear();
 
-		vkDestroyFence(m_Device, UploadFence, nullptr);
+		vkDestroySemaphore(m_Device, m_UploadTimeline, nullptr);
 
 		vkDestroyCommandPool(m_Device, m_UploadCommandPool, nullptr);
 
 		vmaDestroyAllocator(m_Allocator);
 
 		vkDestroyDevice(m_Device, nullptr);
-		vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+		if (m_Surface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+			m_Surface = VK_NULL_HANDLE;
+		}
 
 		if (CVar_ValidationLayers.Get())
 		{
@@ -185,7 +237,13 @@ namespace Hog {
 
 	void GraphicsContext::RecreateSwapChainImpl()
 	{
-		vkDeviceWaitIdle(m_Device);
+		if (m_Headless)
+			return;
+
+		{
+			std::lock_guard lock(m_QueueMutex);
+			vkDeviceWaitIdle(m_Device);
+		}
 
 		CleanupSwapChain();
 
@@ -195,6 +253,7 @@ namespace Hog {
 
 	void GraphicsContext::WaitIdleImpl()
 	{
+		std::lock_guard lock(m_QueueMutex);
 		vkDeviceWaitIdle(m_Device);
 	}
 
@@ -236,52 +295,222 @@ namespace Hog {
 
 	void GraphicsContext::ImmediateSubmitImpl(std::function<void(VkCommandBuffer commandBuffer)>&& function)
 	{
-		//allocate the default command buffer that we will use for the instant commands
-		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		if (m_UploadCommandBuffer == VK_NULL_HANDLE)
+		{
+			m_UploadCommandBuffer = CreateCommandBufferImpl(m_UploadCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
-		// Don't worry about this
-		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			//begin the command buffer recording. We will use this command buffer exactly once, so we want to let vulkan know that
+			VkCommandBufferBeginInfo beginInfo = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			};
 
-		// The command pool we created above
-		commandBufferAllocateInfo.commandPool = m_UploadCommandPool;
+			CheckVkResult(vkBeginCommandBuffer(m_UploadCommandBuffer, &beginInfo));
+		}
+		else
+		{
+			// Separate submissions used to order the recorded functions, keep that guarantee inside a batch
+			VkMemoryBarrier2 memoryBarrier = {
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+				.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+				.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+			};
 
-		// We'll have two command buffers.  One will be in flight
-		// while the other is being built.
-		commandBufferAllocateInfo.commandBufferCount = 1;
+			VkDependencyInfo dependencyInfo = {
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.memoryBarrierCount = 1,
+				.pMemoryBarriers = &memoryBarrier,
+			};
 
-		VkCommandBuffer commandBuffer;
-		CheckVkResult(vkAllocateCommandBuffers(m_Device, &commandBufferAllocateInfo, &commandBuffer));
+			vkCmdPipelineBarrier2(m_UploadCommandBuffer, &dependencyInfo);
+		}
 
-		//begin the command buffer recording. We will use this command buffer exactly once, so we want to let vulkan know that
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // Optional
-		beginInfo.pInheritanceInfo = nullptr; // Optional
+		{
+			HG_PROFILE_GPU_CONTEXT(m_UploadCommandBuffer);
+			HG_PROFILE_GPU_EVENT("Immediate Submit");
 
-		CheckVkResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
-		HG_PROFILE_GPU_CONTEXT(commandBuffer);
-		HG_PROFILE_GPU_EVENT("Immediate Submit");
+			//execute the function
+			function(m_UploadCommandBuffer);
+		}
 
-		//execute the function
-		function(commandBuffer);
+		if (m_UploadBatchDepth == 0)
+		{
+			WaitForUploadImpl(SubmitUploads());
+		}
+	}
 
-		CheckVkResult(vkEndCommandBuffer(commandBuffer));
+	void GraphicsContext::BeginUploadBatchImpl()
+	{
+		m_UploadBatchDepth++;
+	}
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
+	UploadHandle GraphicsContext::EndUploadBatchImpl(bool wait)
+	{
+		HG_CORE_ASSERT(m_UploadBatchDepth > 0, "EndUploadBatch called without a matching BeginUploadBatch");
 
-		//submit command buffer to the queue and execute it.
-		// _uploadFence will now block until the graphic commands finish execution
-		CheckVkResult(vkQueueSubmit(m_Queue, 1, &submitInfo, UploadFence));
+		// Nested batches complete with the submission that holds their last recorded work. Work still being recorded goes
+		// out as the next submission, whether the outer batch flushes or ends, anything earlier was already submitted
+		if (--m_UploadBatchDepth > 0)
+			return { m_UploadCommandBuffer != VK_NULL_HANDLE ? m_UploadValue + 1 : m_UploadValue };
 
-		vkWaitForFences(m_Device, 1, &UploadFence, true, 9999999999);
-		vkResetFences(m_Device, 1, &UploadFence);
+		UploadHandle handle = SubmitUploads();
 
-		//clear the command pool. This will free the command buffer too
-		vkResetCommandPool(m_Device, m_UploadCommandPool, 0);
+		if (wait)
+		{
+			WaitForUploadImpl(handle);
+		}
+
+		return handle;
+	}
+
+	void GraphicsContext::FlushUploadBatchImpl()
+	{
+		WaitForUploadImpl(SubmitUploads());
+	}
+
+	void GraphicsContext::WaitForUploadImpl(UploadHandle handle)
+	{
+		// Handle of a nested batch that was not submitted yet
+		if (handle.Value > m_UploadValue)
+		{
+			HG_CORE_ASSERT(handle.Value == m_UploadValue + 1 && m_UploadCommandBuffer != VK_NULL_HANDLE, "Upload handle was never submitted");
+			SubmitUploads();
+		}
+
+		VkSemaphoreWaitInfo waitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &m_UploadTimeline,
+			.pValues = &handle.Value,
+		};
+
+		CheckVkResult(vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX));
+
+		RetireUploads();
+	}
+
+	bool GraphicsContext::IsUploadCompleteImpl(UploadHandle handle)
+	{
+		uint64_t value;
+		CheckVkResult(vkGetSemaphoreCounterValue(m_Device, m_UploadTimeline, &value));
+
+		return value >= handle.Value;
+	}
+
+	StagingAllocation GraphicsContext::AllocateStagingImpl(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		VkDeviceSize chunkSize = static_cast<VkDeviceSize>(CVar_StagingChunkSize.Get());
+		VkDeviceSize offset = m_StagingChunk ? (m_StagingHead + alignment - 1) / alignment * alignment : 0;
+
+		if (!m_StagingChunk || offset + size > m_StagingChunk->GetSize())
+		{
+			if (m_StagingChunk)
+			{
+				m_StagingChunk->Flush(m_StagingFlushed, m_StagingHead - m_StagingFlushed);
+				m_UploadStaging.push_back(std::move(m_StagingChunk));
+			}
+
+			RetireUploads();
+
+			if (size <= chunkSize && !m_FreeStagingChunks.empty())
+			{
+				m_StagingChunk = std::move(m_FreeStagingChunks.back());
+				m_FreeStagingChunks.pop_back();
+			}
+			else
+			{
+				// Requests larger than a chunk get a dedicated one that is dropped after use
+				m_StagingChunk = Buffer::Create(BufferDescription::Defaults::TransferSourceBuffer, std::max(size, chunkSize));
+			}
+
+			offset = 0;
+			m_StagingFlushed = 0;
+		}
+
+		m_StagingHead = offset + size;
+
+		return { m_StagingChunk->GetHandle(), offset, static_cast<uint8_t*>(static_cast<void*>(*m_StagingChunk)) + offset };
+	}
+
+	UploadHandle GraphicsContext::SubmitUploads()
+	{
+		if (m_UploadCommandBuffer == VK_NULL_HANDLE)
+			return { m_UploadValue };
+
+		HG_PROFILE_FUNCTION();
+
+		if (m_StagingChunk)
+		{
+			m_StagingChunk->Flush(m_StagingFlushed, m_StagingHead - m_StagingFlushed);
+			m_UploadStaging.push_back(std::move(m_StagingChunk));
+			m_StagingHead = 0;
+			m_StagingFlushed = 0;
+		}
+
+		CheckVkResult(vkEndCommandBuffer(m_UploadCommandBuffer));
+
+		m_UploadValue++;
+
+		VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = m_UploadCommandBuffer,
+		};
+
+		VkSemaphoreSubmitInfo signalSemaphoreInfo = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = m_UploadTimeline,
+			.value = m_UploadValue,
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		};
+
+		VkSubmitInfo2 submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = &commandBufferSubmitInfo,
+			.signalSemaphoreInfoCount = 1,
+			.pSignalSemaphoreInfos = &signalSemaphoreInfo,
+		};
+
+		{
+			std::lock_guard lock(m_QueueMutex);
+			CheckVkResult(vkQueueSubmit2(m_Queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+
+		m_PendingUploads.push_back({ m_UploadValue, m_UploadCommandBuffer, std::move(m_UploadResources), std::move(m_UploadStaging) });
+		m_UploadResources.clear();
+		m_UploadStaging.clear();
+		m_UploadCommandBuffer = VK_NULL_HANDLE;
+
+		return { m_UploadValue };
+	}
+
+	void GraphicsContext::RetireUploads()
+	{
+		if (m_PendingUploads.empty())
+			return;
+
+		uint64_t value;
+		CheckVkResult(vkGetSemaphoreCounterValue(m_Device, m_UploadTimeline, &value));
+
+		VkDeviceSize chunkSize = static_cast<VkDeviceSize>(CVar_StagingChunkSize.Get());
+		while (!m_PendingUploads.empty() && m_PendingUploads.front().Value <= value)
+		{
+			auto& submission = m_PendingUploads.front();
+
+			vkFreeCommandBuffers(m_Device, m_UploadCommandPool, 1, &submission.CommandBuffer);
+
+			for (auto& chunk : submission.Staging)
+			{
+				if (chunk->GetSize() == chunkSize)
+				{
+					m_FreeStagingChunks.push_back(std::move(chunk));
+				}
+			}
+
+			m_PendingUploads.pop_front();
+		}
 	}
 
 	VkFence GraphicsContext::CreateFenceImpl(bool signaled)
@@ -310,27 +539,47 @@ namespace Hog {
 		return semaphore;
 	}
 
-	VkCommandPool GraphicsContext::CreateCommandPoolImpl()
+	VkSemaphore GraphicsContext::CreateTimelineSemaphoreImpl(uint64_t initialValue)
+	{
+		VkSemaphore semaphore;
+
+		VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = initialValue,
+		};
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &semaphoreTypeCreateInfo,
+		};
+
+		CheckVkResult(vkCreateSemaphore(m_Device, &semaphoreCreateInfo, nullptr, &semaphore));
+
+		return semaphore;
+	}
+
+	VkCommandPool GraphicsContext::CreateCommandPoolImpl(uint32_t queueFamily)
 	{
 		VkCommandPool commandPool;
 
 		VkCommandPoolCreateInfo commandPoolCreateInfo = {};
 		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		commandPoolCreateInfo.queueFamilyIndex = m_QueueFamilyIndex;
+		commandPoolCreateInfo.queueFamilyIndex = queueFamily;
 
 		CheckVkResult(vkCreateCommandPool(m_Device, &commandPoolCreateInfo, nullptr, &commandPool));
 
 		return commandPool;
 	}
 
-	VkCommandBuffer GraphicsContext::CreateCommandBufferImpl(VkCommandPool commandPool)
+	VkCommandBuffer GraphicsContext::CreateCommandBufferImpl(VkCommandPool commandPool, VkCommandBufferLevel level)
 	{
 		VkCommandBuffer commandBuffer;
 
 		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
 		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.level = level;
 		commandBufferAllocateInfo.commandPool = commandPool;
 		commandBufferAllocateInfo.commandBufferCount = 1;
 
@@ -478,8 +727,12 @@ namespace Hog {
 
 			// Surface capabilities basically describes what kind of image you can render to the user.
 			// Look up VkSurfaceCapabilitiesKHR in the Vulkan documentation.
-			CheckVkResult(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu.Device, m_Surface, &gpu.SurfaceCapabilities));
+			if (m_Surface != VK_NULL_HANDLE)
+			{
+				CheckVkResult(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu.Device, m_Surface, &gpu.SurfaceCapabilities));
+			}
 
+			if (m_Surface != VK_NULL_HANDLE)
 			{
 				// Get the supported surface formats.  This includes image format and color space.
 				// A common format is VK_FORMAT_R8G8B8A8_UNORM which is 8 bits for red, green, blue, alpha making for 32 total
@@ -492,6 +745,7 @@ namespace Hog {
 				HG_ASSERT(numFormats > 0, "vkGetPhysicalDeviceSurfaceFormatsKHR returned zero surface formats.");
 			}
 
+			if (m_Surface != VK_NULL_HANDLE)
 			{
 				// Vulkan supports multiple presentation modes, and I'll linkn to some good documentation on that in just a bit.
 				uint32_t numPresentModes;
@@ -536,13 +790,13 @@ namespace Hog {
 			}
 
 			// No surface formats? =(
-			if (gpu->SurfaceFormats.empty())
+			if (!m_Headless && gpu->SurfaceFormats.empty())
 			{
 				continue;
 			}
 
 			// No present modes? =(
-			if (gpu->PresentModes.empty())
+			if (!m_Headless && gpu->PresentModes.empty())
 			{
 				continue;
 			}
@@ -565,8 +819,12 @@ namespace Hog {
 
 				// A rather perplexing call in the Vulkan API, but
 				// it is a necessity to call.
-				VkBool32 supportsPresent = VK_FALSE;
-				vkGetPhysicalDeviceSurfaceSupportKHR(gpu->Device, j, m_Surface, &supportsPresent);
+				// Headless rendering never presents
+				VkBool32 supportsPresent = m_Headless;
+				if (!m_Headless)
+				{
+					vkGetPhysicalDeviceSurfaceSupportKHR(gpu->Device, j, m_Surface, &supportsPresent);
+				}
 				if (props.queueFlags & VK_QUEUE_GRAPHICS_BIT && props.queueFlags & VK_QUEUE_COMPUTE_BIT && supportsPresent)
 				{
 					// Got it!
@@ -600,8 +858,54 @@ namespace Hog {
 			if (queueIdx >= 0)
 			{
 				m_QueueFamilyIndex = (uint32_t)queueIdx;
+				m_ComputeQueueFamilyIndex = m_QueueFamilyIndex;
+
+				// A compute family without graphics support runs on the async compute engine
+				if (CVar_AsyncCompute.Get())
+				{
+					for (uint32_t j = 0; j < gpu->QueueFamilyProperties.size(); ++j)
+					{
+						VkQueueFamilyProperties& props = gpu->QueueFamilyProperties[j];
+						if (props.queueCount > 0 && props.queueFlags & VK_QUEUE_COMPUTE_BIT && !(props.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+						{
+							m_ComputeQueueFamilyIndex = j;
+							break;
+						}
+					}
+				}
+
+				// A family with only transfer support runs on the copy engines
+				m_TransferQueueFamilyIndex = m_QueueFamilyIndex;
+				if (CVar_TransferQueue.Get())
+				{
+					for (uint32_t j = 0; j < gpu->QueueFamilyProperties.size(); ++j)
+					{
+						VkQueueFamilyProperties& props = gpu->QueueFamilyProperties[j];
+						if (props.queueCount > 0 && props.queueFlags & VK_QUEUE_TRANSFER_BIT && !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+						{
+							m_TransferQueueFamilyIndex = j;
+							break;
+						}
+					}
+				}
+
+				// Families concurrent resources are shared with, exclusive ones have their ownership transferred explicitly
+				m_QueueFamilies = { m_QueueFamilyIndex };
+				if (m_ComputeQueueFamilyIndex != m_QueueFamilyIndex)
+				{
+					m_QueueFamilies.push_back(m_ComputeQueueFamilyIndex);
+				}
+
+				if (m_TransferQueueFamilyIndex != m_QueueFamilyIndex)
+				{
+					m_QueueFamilies.push_back(m_TransferQueueFamilyIndex);
+				}
+
 				m_PhysicalDevice = gpu->Device;
 				m_GPU = gpu;
+				// Software and mobile implementations commonly lack ray tracing, everything else keeps working without it
+				m_RayTracing = CheckPhysicalDeviceExtensionSupport(gpu, m_RayTracingExtensions);
+				m_MeshShaders = CVar_MeshShaders.Get() && CheckPhysicalDeviceExtensionSupport(gpu, m_MeshShaderExtensions);
 				if (CVar_MSAA.Get())
 				{
 					m_MSAASamples = GetMaxMSAASampleCount();
@@ -636,6 +940,37 @@ namespace Hog {
 
 		devqInfo.push_back(qinfo);
 
+		if (m_ComputeQueueFamilyIndex != m_QueueFamilyIndex)
+		{
+			qinfo.queueFamilyIndex = m_ComputeQueueFamilyIndex;
+			devqInfo.push_back(qinfo);
+		}
+
+		if (m_TransferQueueFamilyIndex != m_QueueFamilyIndex)
+		{
+			qinfo.queueFamilyIndex = m_TransferQueueFamilyIndex;
+			devqInfo.push_back(qinfo);
+		}
+
+		if (m_RayTracing)
+		{
+			m_DeviceExtensions.insert(m_DeviceExtensions.end(), m_RayTracingExtensions.begin(), m_RayTracingExtensions.end());
+		}
+		else
+		{
+			HG_CORE_WARN("Ray tracing is not supported by the physical device, ray tracing stages are unavailable");
+			m_DeviceFeatures13.pNext = &m_BufferDeviceAddressFetures;
+		}
+
+		if (m_MeshShaders)
+		{
+			m_DeviceExtensions.insert(m_DeviceExtensions.end(), m_MeshShaderExtensions.begin(), m_MeshShaderExtensions.end());
+
+			// In front of whatever the ray tracing support left in the chain
+			m_MeshShaderFeatures.pNext = m_DeviceFeatures13.pNext;
+			m_DeviceFeatures13.pNext = &m_MeshShaderFeatures;
+		}
+
 		// Put it all together.
 		VkDeviceCreateInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -662,6 +997,18 @@ namespace Hog {
 
 		// Now get the queues from the devie we just created.
 		vkGetDeviceQueue(m_Device, m_QueueFamilyIndex, 0, &m_Queue);
+		vkGetDeviceQueue(m_Device, m_ComputeQueueFamilyIndex, 0, &m_ComputeQueue);
+		vkGetDeviceQueue(m_Device, m_TransferQueueFamilyIndex, 0, &m_TransferQueue);
+
+		if (m_ComputeQueueFamilyIndex != m_QueueFamilyIndex)
+		{
+			HG_CORE_INFO("Using queue family {} for async compute", m_ComputeQueueFamilyIndex);
+		}
+
+		if (m_TransferQueueFamilyIndex != m_QueueFamilyIndex)
+		{
+			HG_CORE_INFO("Using queue family {} for streaming uploads", m_TransferQueueFamilyIndex);
+		}
 	}
 
 	void GraphicsContext::InitializeAllocator()
@@ -729,12 +1076,9 @@ namespace Hog {
 	{
 		HG_PROFILE_FUNCTION();
 
-		// We create fences that we can use to wait for a 
-		// given command buffer to be done on the GPU.
-		VkFenceCreateInfo fenceCreateInfo = {};
-		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-		CheckVkResult(vkCreateFence(m_Device, &fenceCreateInfo, nullptr, &UploadFence));
+		// Upload submissions signal increasing values on this timeline, the values double as upload handles
+		m_UploadTimeline = CreateTimelineSemaphoreImpl(0);
+		m_UploadValue = 0;
 	}
 
 	void GraphicsContext::CreateSwapChain()
@@ -754,8 +1098,13 @@ namespace Hog {
 		info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 		info.surface = m_Surface;
 
-		// double buffer again!
-		info.minImageCount = CVar_FrameCount.Get();
+		// Independent of renderer.frameCount, frames in flight pick whichever image is acquired
+		const VkSurfaceCapabilitiesKHR& caps = gpu.SurfaceCapabilities;
+		info.minImageCount = std::max(static_cast<uint32_t>(CVar_SwapchainImageCount.Get()), caps.minImageCount);
+		if (caps.maxImageCount > 0)
+		{
+			info.minImageCount = std::min(info.minImageCount, caps.maxImageCount);
+		}
 
 		info.imageFormat = surfaceFormat.format;
 		info.imageColorSpace = surfaceFormat.colorSpace;
@@ -795,22 +1144,22 @@ namespace Hog {
 
 		// First call gets numImages.
 		uint32_t numImages = 0;
-		std::vector<VkImage> swapchainImages(CVar_FrameCount.Get());
 		CheckVkResult(vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &numImages, nullptr));
 		HG_ASSERT(numImages > 0, "vkGetSwapchainImagesKHR returned a zero image count.")
 
-			// Second call uses numImages
-			CheckVkResult(vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &numImages, swapchainImages.data()));
+		// Second call uses numImages
+		std::vector<VkImage> swapchainImages(numImages);
+		CheckVkResult(vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &numImages, swapchainImages.data()));
 		HG_ASSERT(numImages > 0, "vkGetSwapchainImagesKHR returned a zero image count.");
 
-		m_SwapchainImages.resize(CVar_FrameCount.Get());
+		m_SwapchainImages.resize(numImages);
 
 		// New concept - Image Views
 		// Much like the logical device is an interface to the physical device,
 		// image views are interfaces to actual images.  Think of it as this.
 		// The image exists outside of you.  But the view is your personal view 
 		// ( how you perceive ) the image.
-		for (int i = 0; i < CVar_FrameCount.Get(); ++i) {
+		for (uint32_t i = 0; i < numImages; ++i) {
 			VkImageViewCreateInfo info = {};
 			info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 
@@ -842,6 +1191,23 @@ namespace Hog {
 		}
 	}
 
+	void GraphicsContext::CreateOffscreenTargets()
+	{
+		HG_PROFILE_FUNCTION();
+
+		// Stand-ins for the swapchain images, one per frame in flight so a frame never renders into an image still being read back
+		m_SwapchainFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		m_SwapchainExtent = { static_cast<uint32_t>(CVar_HeadlessWidth.Get()), static_cast<uint32_t>(CVar_HeadlessHeight.Get()) };
+
+		m_SwapchainImages.resize(CVar_FrameCount.Get());
+		for (auto& image : m_SwapchainImages)
+		{
+			image = Image::Create(ImageDescription::Defaults::RenderTarget, m_SwapchainExtent.width, m_SwapchainExtent.height, 1, m_SwapchainFormat);
+		}
+
+		HG_CORE_INFO("Rendering headless into {}x{} offscreen images", m_SwapchainExtent.width, m_SwapchainExtent.height);
+	}
+
 	VkFormat GraphicsContext::ChooseSupportedFormat(VkFormat* formats, int numFormats, VkImageTiling tiling, VkFormatFeatureFlags features)
 	{
 		HG_PROFILE_FUNCTION();
@@ -1,13 +1,29 @@
 #pragma once
 
+#include <mutex>
+
 #include <volk.h>
 #include <vk_mem_alloc.h>
 
 #include "Hog/Renderer/Image.h"
+#include "Hog/Renderer/Buffer.h"
 #include "Hog/Core/Base.h"
 
 namespace Hog {
 
+	// Timeline value of an upload submission, complete once the upload timeline reaches it
+	struct UploadHandle
+	{
+		uint64_t Value = 0;
+	};
+
+	struct StagingAllocation
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VkDeviceSize Offset = 0;
+		void* Data = nullptr;
+	};
+
 	static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 		VkDebugUtilsMessageTypeFlagsEXT messageType,
 		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
@@ -144,19 +160,47 @@ namespace Hog {
 		static VkSwapchainKHR GetSwapchain() { return Get().m_Swapchain; }
 		static std::vector<Ref<Image>>& GetSwapchainImages() { return Get().m_SwapchainImages; }
 		static VkFormat GetSwapchainFormat() { return Get().m_SwapchainFormat; }
+		static VkPresentModeKHR GetPresentMode() { return Get().m_PresentMode; }
+		static bool IsHeadless() { return Get().m_Headless; }
+		static bool HasRayTracing() { return Get().m_RayTracing; }
+		// Task and mesh shaders of VK_EXT_mesh_shader
+		static bool HasMeshShaders() { return Get().m_MeshShaders; }
 		static VkQueue GetQueue() { return Get().m_Queue; }
 		static uint32_t GetQueueFamily() { return Get().m_QueueFamilyIndex; }
+		static VkQueue GetComputeQueue() { return Get().m_ComputeQueue; }
+		static uint32_t GetComputeQueueFamily() { return Get().m_ComputeQueueFamilyIndex; }
+		static bool HasAsyncCompute() { return Get().m_ComputeQueueFamilyIndex != Get().m_QueueFamilyIndex; }
+		static VkQueue GetTransferQueue() { return Get().m_TransferQueue; }
+		static uint32_t GetTransferQueueFamily() { return Get().m_TransferQueueFamilyIndex; }
+		static bool HasTransferQueue() { return Get().m_TransferQueueFamilyIndex != Get().m_QueueFamilyIndex; }
+		static const std::vector<uint32_t>& GetQueueFamilies() { return Get().m_QueueFamilies; }
+		// Held around every submission to and wait on the graphics queue, the streaming uploader submits to it from its own thread without a transfer queue
+		static std::mutex& GetQueueMutex() { return Get().m_QueueMutex; }
 		static VkSampleCountFlagBits GetMSAASamples() { return Get().m_MSAASamples; }
 		static GPUInfo* GetGPUInfo() { return Get().m_GPU; }
 
-		static VkCommandPool CreateCommandPool() { return Get().CreateCommandPoolImpl(); }
-		static VkCommandBuffer CreateCommandBuffer(VkCommandPool commandPool) { return Get().CreateCommandBufferImpl(commandPool); }
+		static VkCommandPool CreateCommandPool() { return Get().CreateCommandPoolImpl(Get().m_QueueFamilyIndex); }
+		static VkCommandPool CreateCommandPool(uint32_t queueFamily) { return Get().CreateCommandPoolImpl(queueFamily); }
+		static VkCommandBuffer CreateCommandBuffer(VkCommandPool commandPool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) { return Get().CreateCommandBufferImpl(commandPool, level); }
 		static VkFence CreateFence(bool signaled) { return Get().CreateFenceImpl(signaled); }
 		static VkSemaphore CreateVkSemaphore() { return Get().CreateSemaphoreImpl(); }
+		static VkSemaphore CreateTimelineSemaphore(uint64_t initialValue = 0) { return Get().CreateTimelineSemaphoreImpl(initialValue); }
 
 		static std::vector<const char*>& GetInstanceExtensions() { return Get().GetInstanceExtensionsImpl(); }
 
 		static void ImmediateSubmit(std::function<void(VkCommandBuffer commandBuffer)>&& function) { return Get().ImmediateSubmitImpl(std::move(function)); }
+
+		// ImmediateSubmit calls between Begin and End are recorded into one command buffer and submitted once.
+		// Batches nest, only the outermost End submits.
+		static void BeginUploadBatch() { Get().BeginUploadBatchImpl(); }
+		static UploadHandle EndUploadBatch(bool wait = true) { return Get().EndUploadBatchImpl(wait); }
+		// Submits what the open batch recorded so far and waits for it, for callers that read results back
+		static void FlushUploadBatch() { Get().FlushUploadBatchImpl(); }
+		static void WaitForUpload(UploadHandle handle) { Get().WaitForUploadImpl(handle); }
+		static bool IsUploadComplete(UploadHandle handle) { return Get().IsUploadCompleteImpl(handle); }
+		// Host visible memory that stays alive until the upload recorded with it has executed
+		static StagingAllocation AllocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16) { return Get().AllocateStagingImpl(size, alignment); }
+		static void KeepAlive(Ref<Buffer> buffer) { Get().m_UploadResources.push_back(std::move(buffer)); }
 	public:
 		GraphicsContext(GraphicsContext const&) = delete;
 		void operator=(GraphicsContext const&) = delete;
@@ -170,11 +214,20 @@ namespace Hog {
 		void GetImGuiDescriptorPoolImpl();
 		void DestroyImGuiDescriptorPoolImpl();
 		void ImmediateSubmitImpl(std::function<void(VkCommandBuffer commandBuffer)>&& function);
-
-		VkCommandPool CreateCommandPoolImpl();
-		VkCommandBuffer CreateCommandBufferImpl(VkCommandPool commandPool);
+		void BeginUploadBatchImpl();
+		UploadHandle EndUploadBatchImpl(bool wait);
+		void FlushUploadBatchImpl();
+		void WaitForUploadImpl(UploadHandle handle);
+		bool IsUploadCompleteImpl(UploadHandle handle);
+		StagingAllocation AllocateStagingImpl(VkDeviceSize size, VkDeviceSize alignment);
+		UploadHandle SubmitUploads();
+		void RetireUploads();
+
+		VkCommandPool CreateCommandPoolImpl(uint32_t queueFamily);
+		VkCommandBuffer CreateCommandBufferImpl(VkCommandPool commandPool, VkCommandBufferLevel level);
 		VkFence CreateFenceImpl(bool signaled);
 		VkSemaphore CreateSemaphoreImpl();
+		VkSemaphore CreateTimelineSemaphoreImpl(uint64_t initialValue);
 		VkSampleCountFlagBits GetMaxMSAASampleCount();
 
 		std::vector<const char*>& GetInstanceExtensionsImpl() { return m_InstanceExtensions; }
@@ -189,12 +242,16 @@ namespace Hog {
 		void CreateCommandPools();
 		void CreateCommandBuffers();
 		void CreateSwapChain();
+		void CreateOffscreenTargets();
 		VkFormat ChooseSupportedFormat(VkFormat* formats, int numFormats, VkImageTiling tiling, VkFormatFeatureFlags features);
 
 		void CleanupSwapChain();
 
 	private:
 		bool m_Initialized = false;
+		bool m_Headless = false;
+		bool m_RayTracing = false;
+		bool m_MeshShaders = false;
 
 		VkInstance m_Instance = VK_NULL_HANDLE;
 		VkDebugUtilsMessengerEXT m_DebugMessenger = VK_NULL_HANDLE;
@@ -204,8 +261,13 @@ namespace Hog {
 		VkDevice m_Device = VK_NULL_HANDLE;
 
 		uint32_t m_QueueFamilyIndex;
+		uint32_t m_ComputeQueueFamilyIndex;
+		uint32_t m_TransferQueueFamilyIndex;
+		std::vector<uint32_t> m_QueueFamilies;
 
 		VkQueue m_Queue = VK_NULL_HANDLE;
+		VkQueue m_ComputeQueue = VK_NULL_HANDLE;
+		VkQueue m_TransferQueue = VK_NULL_HANDLE;
 
 		VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 
@@ -219,9 +281,31 @@ namespace Hog {
 
 		std::vector<Ref<Image>> m_SwapchainImages;
 
+		struct UploadSubmission
+		{
+			uint64_t Value;
+			VkCommandBuffer CommandBuffer;
+			std::vector<Ref<Buffer>> Resources;
+			std::vector<Ref<Buffer>> Staging;
+		};
+
 		VkCommandPool m_UploadCommandPool;
 
-		VkFence UploadFence;
+		std::mutex m_QueueMutex;
+
+		VkSemaphore m_UploadTimeline = VK_NULL_HANDLE;
+		uint64_t m_UploadValue = 0;
+		uint32_t m_UploadBatchDepth = 0;
+		VkCommandBuffer m_UploadCommandBuffer = VK_NULL_HANDLE;
+		// Buffers the commands recorded so far use, released once their submission retires
+		std::vector<Ref<Buffer>> m_UploadResources;
+		std::vector<Ref<Buffer>> m_UploadStaging;
+		std::deque<UploadSubmission> m_PendingUploads;
+
+		Ref<Buffer> m_StagingChunk;
+		VkDeviceSize m_StagingHead = 0;
+		VkDeviceSize m_StagingFlushed = 0;
+		std::vector<Ref<Buffer>> m_FreeStagingChunks;
 
 		VkSampleCountFlagBits m_MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -268,16 +352,24 @@ namespace Hog {
 			.accelerationStructure = VK_TRUE,
 		};
 
+		VkPhysicalDeviceMeshShaderFeaturesEXT m_MeshShaderFeatures = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+			.taskShader = VK_TRUE,
+			.meshShader = VK_TRUE,
+		};
+
 		VkPhysicalDeviceVulkan13Features m_DeviceFeatures13 = {
 			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
 			.pNext = &m_AccelerationStructureFeatures,
 			.synchronization2 = VK_TRUE,
+			.dynamicRendering = VK_TRUE,
 			.maintenance4 = VK_TRUE,
 		};
 
 		VkPhysicalDeviceVulkan12Features m_DeviceFeatures12 = {
 			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
 			.pNext = &m_DeviceFeatures13,
+			.drawIndirectCount = VK_TRUE,
 	        .descriptorIndexing = VK_TRUE,
 	        .shaderInputAttachmentArrayDynamicIndexing = VK_TRUE,
 	        .shaderUniformTexelBufferArrayDynamicIndexing = VK_TRUE,
@@ -299,6 +391,7 @@ namespace Hog {
 	        .descriptorBindingPartiallyBound = VK_TRUE,
 	        .descriptorBindingVariableDescriptorCount = VK_TRUE,
 	        .runtimeDescriptorArray = VK_TRUE,
+			.timelineSemaphore = VK_TRUE,
 			.bufferDeviceAddress = VK_TRUE,
 		};
 
@@ -313,6 +406,8 @@ namespace Hog {
 			.imageCubeArray = VK_TRUE,
 			.geometryShader = VK_TRUE,
 			.sampleRateShading = VK_TRUE,
+			.multiDrawIndirect = VK_TRUE,
+			.drawIndirectFirstInstance = VK_TRUE,
 			.depthClamp = VK_TRUE,
 			.depthBiasClamp = VK_TRUE,
 			.fillModeNonSolid = VK_TRUE,
@@ -331,19 +426,39 @@ namespace Hog {
 			VK_KHR_MAINTENANCE_4_EXTENSION_NAME,
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 			VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
-			VK_KHR_RAY_QUERY_EXTENSION_NAME,
 			VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
 			VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
-			VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, 
-			VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
-			VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
 			VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
 			VK_KHR_SPIRV_1_4_EXTENSION_NAME,
 			VK_EXT_LINE_RASTERIZATION_EXTENSION_NAME,
 		};
 
+		// Only enabled when the physical device supports all of them
+		std::vector<const char*> m_RayTracingExtensions = {
+			VK_KHR_RAY_QUERY_EXTENSION_NAME,
+			VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+			VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+			VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+		};
+
+		// Only enabled when supported and renderer.enableMeshShaders is set
+		std::vector<const char*> m_MeshShaderExtensions = {
+			VK_EXT_MESH_SHADER_EXTENSION_NAME,
+		};
+
 		std::vector<const char*> m_ValidationLayers = { "VK_LAYER_KHRONOS_validation" };
 
 		std::vector<GPUInfo> m_GPUs;
 	};
+
+	// Batches every upload made while in scope and waits for them when the scope ends
+	class UploadScope
+	{
+	public:
+		UploadScope() { GraphicsContext::BeginUploadBatch(); }
+		~UploadScope() { GraphicsContext::EndUploadBatch(); }
+
+		UploadScope(UploadScope const&) = delete;
+		void operator=(UploadScope const&) = delete;
+	};
 }
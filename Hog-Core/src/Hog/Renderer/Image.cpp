@@ -6,6 +6,7 @@
 
 #include "Hog/Renderer/GraphicsContext.h"
 #include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/BindlessHeap.h"
 #include "Hog/Utils/RendererUtils.h"
 #include "Hog/Core/CVars.h"
 
@@ -64,14 +65,19 @@ namespace Hog
 		return CreateRef<Image>(description, extent.width, extent.height, levelCount, description, samples);
 	}
 
+	Ref<Image> Image::CreateTransient(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples)
+	{
+		return CreateRef<Image>(description, width, height, levelCount, format, samples, true);
+	}
+
 	Ref<Image> Image::CreateSwapChainImage(VkImage image, ImageDescription type, VkFormat format, VkExtent2D extent,
 	                                       VkImageViewCreateInfo viewCreateInfo)
 	{
 		return CreateRef<Image>(image, type, format, extent, viewCreateInfo);
 	}
 
-	Image::Image(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples)
-		: m_InternalFormat(format), m_Description(description), m_Format(m_InternalFormat), m_Width(width), m_Height(height), m_Allocated(true), m_LevelCount(levelCount), m_Samples(samples)
+	Image::Image(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples, bool transient)
+		: m_InternalFormat(format), m_Description(description), m_Format(m_InternalFormat), m_Width(width), m_Height(height), m_Allocated(!transient), m_Transient(transient), m_LevelCount(levelCount), m_Samples(samples)
 	{
 		m_ImageCreateInfo.extent = { m_Width, m_Height, 1 };
 		m_ImageCreateInfo.imageType = static_cast<VkImageType>(m_Description);
@@ -80,16 +86,16 @@ namespace Hog
 		m_ImageCreateInfo.samples = m_Samples;
 		m_ImageCreateInfo.mipLevels = m_LevelCount;
 
-		//for the depth image, we want to allocate it from GPU local memory
-		VmaAllocationCreateInfo imageAllocationInfo = {};
-		imageAllocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-		imageAllocationInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		//allocate and create the image
-		CheckVkResult(vmaCreateImage(GraphicsContext::GetAllocator(), &m_ImageCreateInfo,
-			&imageAllocationInfo, &m_Handle, &m_Allocation, nullptr));
+		// Concurrent sharing needs more than one queue family, everything else is owned by one queue at a time
+		const auto& queueFamilies = GraphicsContext::GetQueueFamilies();
+		if (m_Description.SharingMode == VK_SHARING_MODE_CONCURRENT && queueFamilies.size() > 1)
+		{
+			m_ImageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			m_ImageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+			m_ImageCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+		}
 
-		CreateViewForImage();
+		CreateImage();
 	}
 
 	Image::Image(VkImage image, ImageDescription type, VkFormat format, VkExtent2D extent,
@@ -102,128 +108,205 @@ namespace Hog
 
 	Image::~Image()
 	{
+		BindlessHeap::Release(BindlessType::StorageImage, m_StorageIndex);
+		DestroyLevelViews();
 		vkDestroyImageView(GraphicsContext::GetDevice(), m_View, nullptr);
 		if (m_Allocated)
 			vmaDestroyImage(GraphicsContext::GetAllocator(), m_Handle, m_Allocation);
+		else if (m_Transient)
+			vkDestroyImage(GraphicsContext::GetDevice(), m_Handle, nullptr);
+	}
+
+	void Image::Resize(uint32_t width, uint32_t height, uint32_t levelCount)
+	{
+		HG_CORE_ASSERT(m_Allocated || m_Transient, "Swapchain images are resized with the swapchain");
+
+		BindlessHeap::Release(BindlessType::StorageImage, m_StorageIndex);
+		m_StorageIndex = BindlessHeap::InvalidIndex;
+		DestroyLevelViews();
+		vkDestroyImageView(GraphicsContext::GetDevice(), m_View, nullptr);
+		m_View = VK_NULL_HANDLE;
+
+		if (m_Allocated)
+			vmaDestroyImage(GraphicsContext::GetAllocator(), m_Handle, m_Allocation);
+		else
+			vkDestroyImage(GraphicsContext::GetDevice(), m_Handle, nullptr);
+
+		m_Width = width;
+		m_Height = height;
+		m_LevelCount = levelCount;
+		m_ImageCreateInfo.extent = { m_Width, m_Height, 1 };
+		m_ImageCreateInfo.mipLevels = m_LevelCount;
+		m_Description.ImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		CreateImage();
+	}
+
+	VkMemoryRequirements Image::GetMemoryRequirements() const
+	{
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(GraphicsContext::GetDevice(), m_Handle, &requirements);
+
+		return requirements;
+	}
+
+	void Image::BindMemory(VmaAllocation allocation)
+	{
+		HG_CORE_ASSERT(m_Transient, "Only transient images can be bound to external memory");
+
+		if (m_View != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(GraphicsContext::GetDevice(), m_View, nullptr);
+		}
+
+		// Level views are recreated on demand for the new memory
+		DestroyLevelViews();
+
+		m_Allocation = allocation;
+		CheckVkResult(vmaBindImageMemory(GraphicsContext::GetAllocator(), m_Allocation, m_Handle));
+
+		// Contents of aliased memory are undefined until the image is written
+		m_Description.ImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		CreateViewForImage();
 	}
 
 	void Image::SetData(void* data, uint32_t size)
 	{
-		auto buffer = Buffer::Create(BufferDescription::Defaults::TransferSourceBuffer, size);
-		buffer->WriteData(data, size);
+		StagingAllocation staging = GraphicsContext::AllocateStaging(size);
+		memcpy(staging.Data, data, size);
 
 		GraphicsContext::ImmediateSubmit([&](VkCommandBuffer commandBuffer)
 		{
-			VkImageMemoryBarrier barrier = {};
-			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			barrier.image = m_Handle;
-			barrier.subresourceRange.aspectMask = m_Description.ImageAspectFlags;
-			barrier.subresourceRange.baseMipLevel = 0;
-			barrier.subresourceRange.levelCount = m_LevelCount;
-			barrier.subresourceRange.layerCount = 1;
-			barrier.subresourceRange.baseArrayLayer = 0;
-
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-			//barrier the image into the transfer-receive layout
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-				0, nullptr, 0, nullptr, 1, &barrier);
-
-			VkBufferImageCopy copyRegion = {};
-			copyRegion.bufferOffset = 0;
-			copyRegion.bufferRowLength = 0;
-			copyRegion.bufferImageHeight = 0;
-
-			copyRegion.imageSubresource.aspectMask = m_Description.ImageAspectFlags;
-			copyRegion.imageSubresource.mipLevel = 0;
-			copyRegion.imageSubresource.baseArrayLayer = 0;
-			copyRegion.imageSubresource.layerCount = 1;
-			copyRegion.imageExtent = m_ImageCreateInfo.extent;
-
-			//copy the buffer into the image
-			vkCmdCopyBufferToImage(commandBuffer, buffer->GetHandle(), m_Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-			//mip map generation
-
-			int32_t mipWidth = m_Width;
-			int32_t mipHeight = m_Height;
-
-			for (uint32_t i = 1; i < m_LevelCount; i++) {
-				barrier.subresourceRange.levelCount = 1;
-				barrier.subresourceRange.baseMipLevel = i - 1;
-				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-				vkCmdPipelineBarrier(commandBuffer,
-					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-
-				VkImageBlit blit{};
-				blit.srcOffsets[0] = { 0, 0, 0 };
-				blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-				blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.srcSubresource.mipLevel = i - 1;
-				blit.srcSubresource.baseArrayLayer = 0;
-				blit.srcSubresource.layerCount = 1;
-				blit.dstOffsets[0] = { 0, 0, 0 };
-				blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-				blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.dstSubresource.mipLevel = i;
-				blit.dstSubresource.baseArrayLayer = 0;
-				blit.dstSubresource.layerCount = 1;
-
-				vkCmdBlitImage(commandBuffer,
-					m_Handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-					m_Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					1, &blit,
-					VK_FILTER_LINEAR);
-
-				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-				vkCmdPipelineBarrier(commandBuffer,
-					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-					0, nullptr,
-					0, nullptr,
-					1, &barrier);
-
-				if (mipWidth > 1) mipWidth /= 2;
-				if (mipHeight > 1) mipHeight /= 2;
-			}
+			RecordCopy(commandBuffer, staging.Buffer, staging.Offset);
+			GenerateMips(commandBuffer);
+		});
+	}
 
-			barrier.subresourceRange.baseMipLevel = m_LevelCount - 1;
+	void Image::RecordCopy(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.image = m_Handle;
+		barrier.subresourceRange.aspectMask = m_Description.ImageAspectFlags;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = m_LevelCount;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		//barrier the image into the transfer-receive layout
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.bufferOffset = bufferOffset;
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+
+		copyRegion.imageSubresource.aspectMask = m_Description.ImageAspectFlags;
+		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = m_ImageCreateInfo.extent;
+
+		//copy the buffer into the image
+		vkCmdCopyBufferToImage(commandBuffer, buffer, m_Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+	}
 
-			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	void Image::GenerateMips(VkCommandBuffer commandBuffer)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		barrier.image = m_Handle;
+		barrier.subresourceRange.aspectMask = m_Description.ImageAspectFlags;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
 
+		//mip map generation
+
+		int32_t mipWidth = m_Width;
+		int32_t mipHeight = m_Height;
+
+		for (uint32_t i = 1; i < m_LevelCount; i++) {
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseMipLevel = i - 1;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+
+			VkImageBlit blit{};
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = i - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.dstSubresource.mipLevel = i;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = 1;
+
+			vkCmdBlitImage(commandBuffer,
+				m_Handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				m_Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit,
+				VK_FILTER_LINEAR);
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-			//barrier the image into the shader readable layout
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-				0, nullptr, 0, nullptr, 1, &barrier);
-		});
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+
+			if (mipWidth > 1) mipWidth /= 2;
+			if (mipHeight > 1) mipHeight /= 2;
+		}
+
+		barrier.subresourceRange.baseMipLevel = m_LevelCount - 1;
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		//barrier the image into the shader readable layout
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
 
 		m_Description.ImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	}
 
-	void Image::ExecuteBarrier(VkCommandBuffer commandBuffer, const BarrierDescription& description)
+	VkImageMemoryBarrier2 Image::CreateBarrier(const BarrierDescription& description) const
 	{
-		VkImageMemoryBarrier2 memoryBarrier =
-		{
+		return {
 			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
 			.srcStageMask = static_cast<VkPipelineStageFlags2>(description.SrcStage),
 			.srcAccessMask = static_cast<VkAccessFlags2>(description.SrcAccessMask),
@@ -242,6 +325,11 @@ namespace Hog
 				.layerCount = 1,
 			}
 		};
+	}
+
+	void Image::ExecuteBarrier(VkCommandBuffer commandBuffer, const BarrierDescription& description)
+	{
+		VkImageMemoryBarrier2 memoryBarrier = CreateBarrier(description);
 
 		VkDependencyInfo info =
 		{
@@ -255,6 +343,74 @@ namespace Hog
 		m_Description.ImageLayout = memoryBarrier.newLayout;
 	}
 
+	uint32_t Image::GetStorageIndex()
+	{
+		HG_CORE_ASSERT(m_Description.ImageUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT, "Only storage images can be placed in the bindless heap");
+
+		if (m_StorageIndex == BindlessHeap::InvalidIndex)
+		{
+			m_StorageIndex = BindlessHeap::RegisterStorageImage(m_View);
+		}
+
+		return m_StorageIndex;
+	}
+
+	uint32_t Image::GetLevelStorageIndex(uint32_t level)
+	{
+		HG_CORE_ASSERT(m_Description.ImageUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT, "Only storage images can be placed in the bindless heap");
+		HG_CORE_ASSERT(level < m_LevelCount, "Image has no such mip level");
+
+		if (m_LevelViews.empty())
+		{
+			m_LevelViews.resize(m_LevelCount, VK_NULL_HANDLE);
+			m_LevelStorageIndices.resize(m_LevelCount, BindlessHeap::InvalidIndex);
+		}
+
+		if (m_LevelStorageIndices[level] == BindlessHeap::InvalidIndex)
+		{
+			VkImageViewCreateInfo viewCreateInfo = m_ViewCreateInfo;
+			viewCreateInfo.subresourceRange.baseMipLevel = level;
+			viewCreateInfo.subresourceRange.levelCount = 1;
+
+			CheckVkResult(vkCreateImageView(GraphicsContext::GetDevice(), &viewCreateInfo, nullptr, &m_LevelViews[level]));
+			m_LevelStorageIndices[level] = BindlessHeap::RegisterStorageImage(m_LevelViews[level]);
+		}
+
+		return m_LevelStorageIndices[level];
+	}
+
+	void Image::DestroyLevelViews()
+	{
+		for (size_t i = 0; i < m_LevelViews.size(); i++)
+		{
+			BindlessHeap::Release(BindlessType::StorageImage, m_LevelStorageIndices[i]);
+			vkDestroyImageView(GraphicsContext::GetDevice(), m_LevelViews[i], nullptr);
+		}
+
+		m_LevelViews.clear();
+		m_LevelStorageIndices.clear();
+	}
+
+	void Image::CreateImage()
+	{
+		if (m_Transient)
+		{
+			CheckVkResult(vkCreateImage(GraphicsContext::GetDevice(), &m_ImageCreateInfo, nullptr, &m_Handle));
+			return;
+		}
+
+		//for the depth image, we want to allocate it from GPU local memory
+		VmaAllocationCreateInfo imageAllocationInfo = {};
+		imageAllocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		imageAllocationInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		//allocate and create the image
+		CheckVkResult(vmaCreateImage(GraphicsContext::GetAllocator(), &m_ImageCreateInfo,
+			&imageAllocationInfo, &m_Handle, &m_Allocation, nullptr));
+
+		CreateViewForImage();
+	}
+
 	void Image::CreateViewForImage()
 	{
 		m_ViewCreateInfo.image = m_Handle;
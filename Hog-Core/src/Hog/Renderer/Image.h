@@ -14,17 +14,35 @@ namespace Hog
 		static Ref<Image> Create(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
 		static Ref<Image> Create(ImageDescription description, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
 		static Ref<Image> Create(ImageDescription description, uint32_t levelCount, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		static Ref<Image> CreateTransient(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
 		static Ref<Image> CreateSwapChainImage(VkImage image, ImageDescription description, VkFormat format, VkExtent2D extent, VkImageViewCreateInfo viewCreateInfo);
 	public:
-		Image(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		Image(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, bool transient = false);
 		Image(VkImage image, ImageDescription description, VkFormat format, VkExtent2D extent, VkImageViewCreateInfo viewCreateInfo);
 		~Image();
 
 		void SetData(void* data, uint32_t size);
+		// Copies level 0 out of buffer and leaves the image in the transfer destination layout, valid on any queue.
+		// The tracked layout is left alone so other threads can record it, GenerateMips updates it
+		void RecordCopy(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset);
+		// Blits the remaining levels from level 0 and moves the image to the shader read layout, needs a graphics queue
+		void GenerateMips(VkCommandBuffer commandBuffer);
+
+		// Recreates the image with a new extent, the contents are lost and transient images have to be bound to memory again.
+		// The GPU must no longer use the old image
+		void Resize(uint32_t width, uint32_t height, uint32_t levelCount);
 
 		void SetImageLayout(VkImageLayout layout) { m_Description.ImageLayout = layout; }
 		void ExecuteBarrier(VkCommandBuffer commandBuffer, const BarrierDescription& description);
+		VkImageMemoryBarrier2 CreateBarrier(const BarrierDescription& description) const;
+
+		// Transient images are created without memory, the render graph binds them into shared allocations
+		VkMemoryRequirements GetMemoryRequirements() const;
+		void BindMemory(VmaAllocation allocation);
+		bool IsTransient() const { return m_Transient; }
+		bool IsConcurrent() const { return m_ImageCreateInfo.sharingMode == VK_SHARING_MODE_CONCURRENT; }
 
+		VkImage GetHandle() const { return m_Handle; }
 		VkImageView GetImageView() const { return m_View; }
 		VkFormat GetFormat() const { return m_Description.Format; }
 		const ImageDescription& GetDescription() const {return m_Description;}
@@ -34,11 +52,16 @@ namespace Hog
 		uint32_t GetLevelCount() const { return m_LevelCount; }
 		uint32_t GetWidth() const { return m_Width; }
 		uint32_t GetHeight() const { return m_Height; }
+		uint32_t GetStorageIndex();
+		// Bindless index of a view of a single mip level, for passes that write one level while reading another
+		uint32_t GetLevelStorageIndex(uint32_t level);
 	private:
+		void CreateImage();
 		void CreateViewForImage();
+		void DestroyLevelViews();
 	private:
 		VkImage m_Handle;
-		VkImageView m_View;
+		VkImageView m_View = VK_NULL_HANDLE;
 		VkFormat m_InternalFormat = VK_FORMAT_UNDEFINED;
 		VkSampleCountFlagBits m_Samples = VK_SAMPLE_COUNT_1_BIT;
 		DataType m_Format;
@@ -49,6 +72,10 @@ namespace Hog
 		uint32_t m_Height;
 		bool m_IsSwapChainImage;
 		bool m_Allocated;
+		bool m_Transient = false;
+		uint32_t m_StorageIndex = UINT32_MAX;
+		std::vector<VkImageView> m_LevelViews;
+		std::vector<uint32_t> m_LevelStorageIndices;
 
 		VkImageCreateInfo m_ImageCreateInfo = {
 				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
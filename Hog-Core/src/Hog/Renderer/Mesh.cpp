@@ -2,20 +2,201 @@
 
 #include "Mesh.h"
 
+#include <glm/gtc/packing.hpp>
+
+#include "Hog/Core/CVars.h"
+#include "Hog/Utils/MeshOptimizer.h"
+
+AutoCVar_Int CVar_MergePrimitives("renderer.mergePrimitives", "Merge the primitives of a mesh that share a material when it is built", 1, CVarFlags::EditReadOnly);
+AutoCVar_Float CVar_LodThreshold("renderer.lod.threshold", "Screen space error in pixels a level of detail may have to be drawn", 1.0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_LodCount("renderer.lod.count", "Levels of detail generated per primitive when a mesh is built, including the full detail one. 1 disables them", 4, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_Meshlets("renderer.meshlets", "Split primitives into meshlets when a mesh is built, cluster lists need them", 0, CVarFlags::EditReadOnly);
+
 namespace Hog
 {
-	MeshPrimitive::MeshPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint16_t>& indexData)
+	MeshPrimitive::MeshPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint32_t>& indexData)
 		: m_Vertices(vertexData), m_Indices(indexData)
 	{
+		m_Lods = { { 0, static_cast<uint32_t>(m_Indices.size()), 0.0f } };
+
+		// Every index is below the vertex count
+		m_IndexType = m_Vertices.size() > static_cast<size_t>(UINT16_MAX) + 1 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+
+		if (m_Vertices.empty())
+			return;
+
+		for (const auto& vertex : m_Vertices)
+		{
+			m_BoundingBox.Min = glm::min(m_BoundingBox.Min, vertex.Position);
+			m_BoundingBox.Max = glm::max(m_BoundingBox.Max, vertex.Position);
+		}
+
+		glm::vec3 center = (m_BoundingBox.Min + m_BoundingBox.Max) * 0.5f;
+		float radius = 0.0f;
+		for (const auto& vertex : m_Vertices)
+		{
+			radius = glm::max(radius, glm::length(vertex.Position - center));
+		}
+
+		m_BoundingSphere = glm::vec4(center, radius);
+	}
+
+	void MeshPrimitive::GenerateLods(uint32_t lodCount)
+	{
+		HG_PROFILE_FUNCTION();
+		HG_CORE_ASSERT(m_IndexAllocation.Count == 0, "Levels of detail have to be generated before the primitive is built");
+
+		// Levels below this are not worth a draw of their own
+		constexpr size_t minTriangleCount = 64;
+
+		lodCount = std::min(lodCount, MaxLodCount);
+		m_Indices.resize(GetIndexCount());
+		m_Lods.resize(1);
+
+		std::vector<uint32_t> previous(m_Indices);
+		float error = 0.0f;
+		while (m_Lods.size() < lodCount && previous.size() >= 3 * minTriangleCount)
+		{
+			float collapseError = 0.0f;
+			std::vector<uint32_t> indices = Util::MeshOptimizer::Simplify(m_Vertices, previous, previous.size() / 6 * 3, collapseError);
+
+			// Borders and seams can keep a primitive from shrinking, a level that barely differs only costs memory
+			if (indices.size() * 4 > previous.size() * 3)
+				break;
+
+			Util::MeshOptimizer::OptimizeVertexCache(indices, m_Vertices.size(), Util::MeshOptimizer::Options().CacheSize);
+
+			// Every level is simplified from the one before, so the errors add up
+			error += collapseError;
+			m_Lods.push_back({ static_cast<uint32_t>(m_Indices.size()), static_cast<uint32_t>(indices.size()), error });
+			m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+
+			previous = std::move(indices);
+		}
+	}
+
+	void MeshPrimitive::BuildMeshlets()
+	{
+		std::vector<uint32_t> indices(m_Indices.begin(), m_Indices.begin() + GetIndexCount());
+		m_Meshlets = Util::MeshletBuilder::Build(m_Vertices, indices);
+	}
+
+	glm::vec4 MeshPrimitive::GetPositionBounds() const
+	{
+		if (m_Vertices.empty())
+			return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		glm::vec3 center = (m_BoundingBox.Min + m_BoundingBox.Max) * 0.5f;
+		glm::vec3 halfExtent = (m_BoundingBox.Max - m_BoundingBox.Min) * 0.5f;
+		float extent = glm::max(halfExtent.x, glm::max(halfExtent.y, halfExtent.z));
+
+		return glm::vec4(center, extent > 0.0f ? extent : 1.0f);
+	}
+
+	void MeshPrimitive::Build()
+	{
+		m_VertexAllocation = GeometryArena::AllocateVertices(static_cast<uint32_t>(m_Vertices.size()));
+		m_IndexAllocation = GeometryArena::AllocateIndices(static_cast<uint32_t>(m_Indices.size()), m_IndexType);
+
+		uint32_t vertexStride = GeometryArena::GetVertexStride();
+		m_VertexRegion = BufferRegion::Create(GeometryArena::GetVertexBuffer(), vertexStride * m_VertexAllocation.Offset, GetVertexDataSize());
+
+		// The position stream shares the element offsets of the vertex allocation
+		if (GeometryArena::HasPositionStream())
+		{
+			uint32_t positionStride = GeometryArena::GetPositionStride();
+			m_PositionRegion = BufferRegion::Create(GeometryArena::GetPositionBuffer(), positionStride * m_VertexAllocation.Offset, positionStride * m_Vertices.size());
+		}
+
+		if (GeometryArena::GetVertexFormat() == VertexFormat::Compact)
+		{
+			std::vector<CompactVertex> vertices = Compact();
+			m_VertexRegion->WriteData(vertices.data(), m_VertexRegion->GetSize());
+
+			if (m_PositionRegion)
+			{
+				std::vector<std::array<int16_t, 4>> positions(vertices.size());
+				for (size_t i = 0; i < vertices.size(); i++)
+				{
+					std::copy(std::begin(vertices[i].Position), std::end(vertices[i].Position), positions[i].begin());
+				}
+				m_PositionRegion->WriteData(positions.data(), m_PositionRegion->GetSize());
+			}
+		}
+		else
+		{
+			m_VertexRegion->WriteData(m_Vertices.data(), m_VertexRegion->GetSize());
+
+			if (m_PositionRegion)
+			{
+				std::vector<glm::vec3> positions(m_Vertices.size());
+				for (size_t i = 0; i < m_Vertices.size(); i++)
+				{
+					positions[i] = m_Vertices[i].Position;
+				}
+				m_PositionRegion->WriteData(positions.data(), m_PositionRegion->GetSize());
+			}
+		}
+
+		m_IndexRegion = BufferRegion::Create(GeometryArena::GetIndexBuffer(), GetIndexSize() * m_IndexAllocation.Offset, GetIndexDataSize());
+
+		if (m_IndexType == VK_INDEX_TYPE_UINT32)
+		{
+			m_IndexRegion->WriteData(m_Indices.data(), m_IndexRegion->GetSize());
+		}
+		else
+		{
+			std::vector<uint16_t> indices(m_Indices.begin(), m_Indices.end());
+			m_IndexRegion->WriteData(indices.data(), m_IndexRegion->GetSize());
+		}
+	}
+
+	std::vector<CompactVertex> MeshPrimitive::Compact() const
+	{
+		auto snorm = [](float value) { return static_cast<int16_t>(glm::packSnorm1x16(value)); };
+
+		glm::vec4 bounds = GetPositionBounds();
+		glm::vec3 center(bounds);
+
+		std::vector<CompactVertex> vertices(m_Vertices.size());
+		for (size_t i = 0; i < m_Vertices.size(); i++)
+		{
+			const Vertex& vertex = m_Vertices[i];
+			CompactVertex& compact = vertices[i];
+
+			glm::vec3 position = (vertex.Position - center) / bounds.w;
+			compact.Position[0] = snorm(position.x);
+			compact.Position[1] = snorm(position.y);
+			compact.Position[2] = snorm(position.z);
+			compact.Position[3] = snorm(vertex.Tangent.w < 0.0f ? -1.0f : 1.0f);
+
+			compact.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+			compact.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+
+			glm::vec2 normal = glm::length(vertex.Normal) > 0.0f ? Math::EncodeOctahedral(glm::normalize(vertex.Normal)) : glm::vec2(0.0f, 0.0f);
+			compact.Normal[0] = snorm(normal.x);
+			compact.Normal[1] = snorm(normal.y);
+
+			glm::vec3 tangentDirection(vertex.Tangent);
+			glm::vec2 tangent = glm::length(tangentDirection) > 0.0f ? Math::EncodeOctahedral(glm::normalize(tangentDirection)) : glm::vec2(0.0f, 0.0f);
+			compact.Tangent[0] = snorm(tangent.x);
+			compact.Tangent[1] = snorm(tangent.y);
+
+			HG_CORE_ASSERT(vertex.MaterialIndex <= INT16_MAX, "Compact vertices hold 16 bit material indices");
+			compact.MaterialIndex = static_cast<int16_t>(vertex.MaterialIndex);
+			compact.Padding = 0;
+		}
+
+		return vertices;
 	}
 
-	void MeshPrimitive::Build(Ref<Buffer> vertexBuffer, uint64_t vertexOffset, Ref<Buffer> indexBuffer,
-		uint64_t indexOffset)
+	void MeshPrimitive::Release()
 	{
-		m_VertexRegion = BufferRegion::Create(vertexBuffer, vertexOffset, sizeof(Vertex) * m_Vertices.size());
-		m_VertexRegion->WriteData(m_Vertices.data(), m_VertexRegion->GetSize());
-		m_IndexRegion = BufferRegion::Create(indexBuffer, indexOffset, sizeof(uint16_t) * m_Indices.size());
-		m_IndexRegion->WriteData(m_Indices.data(), m_IndexRegion->GetSize());
+		GeometryArena::FreeVertices(m_VertexAllocation);
+		GeometryArena::FreeIndices(m_IndexAllocation, m_IndexType);
+
+		m_VertexAllocation = {};
+		m_IndexAllocation = {};
 	}
 
 	Ref<Mesh> Mesh::Create(const std::string& name)
@@ -23,40 +204,252 @@ namespace Hog
 		return CreateRef<Mesh>(name);
 	}
 
-	void Mesh::AddPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint16_t>& indexData)
+	Mesh::~Mesh()
+	{
+		for (auto& primitive : m_Primitives)
+		{
+			primitive.Release();
+		}
+
+		SceneBuffer::Free(m_Instances.Offset, m_Instances.Count);
+	}
+
+	void Mesh::AddPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint32_t>& indexData)
 	{
 		m_Primitives.emplace_back(vertexData, indexData);
-		m_IndexOffsets.push_back(m_IndexBufferSize);
-		m_VertexOffsets.push_back(m_VertexBufferSize);
+		UpdateBounds();
+	}
+
+	void Mesh::MergePrimitives()
+	{
+		HG_CORE_ASSERT(m_Instances.Count == 0, "Primitives can only be merged before the mesh is built");
+
+		struct MergedPrimitive
+		{
+			std::vector<Vertex> Vertices;
+			std::vector<uint32_t> Indices;
+		};
+
+		// Materials keep the order they first appear in
+		std::vector<MergedPrimitive> merged;
+		std::unordered_map<int32_t, size_t> materialPrimitives;
+		for (const auto& primitive : m_Primitives)
+		{
+			auto [it, inserted] = materialPrimitives.try_emplace(primitive.GetMaterialIndex(), merged.size());
+			if (inserted)
+			{
+				merged.emplace_back();
+			}
+
+			auto& target = merged[it->second];
+			uint32_t firstVertex = static_cast<uint32_t>(target.Vertices.size());
+			target.Vertices.insert(target.Vertices.end(), primitive.GetVertices().begin(), primitive.GetVertices().end());
+
+			// Levels of detail are regenerated for the merged primitive
+			for (size_t i = 0; i < primitive.GetIndexCount(); i++)
+			{
+				target.Indices.push_back(firstVertex + primitive.GetIndices()[i]);
+			}
+		}
+
+		if (merged.size() == m_Primitives.size())
+			return;
+
+		m_Primitives.clear();
+		for (const auto& primitive : merged)
+		{
+			m_Primitives.emplace_back(primitive.Vertices, primitive.Indices);
+		}
 
-		m_IndexBufferSize += indexData.size() * sizeof(uint16_t);
-		m_VertexBufferSize += vertexData.size() * sizeof(Vertex);
+		UpdateBounds();
 	}
 
 	void Mesh::Build()
 	{
-		m_IndexBuffer = Buffer::Create(BufferDescription::Defaults::IndexBuffer, m_IndexBufferSize);
-		m_VertexBuffer = Buffer::Create(BufferDescription::Defaults::VertexBuffer, m_VertexBufferSize);
+		if (CVar_MergePrimitives.Get())
+		{
+			MergePrimitives();
+		}
+
+		uint32_t lodCount = static_cast<uint32_t>(std::max(CVar_LodCount.Get(), 1));
+		for (auto& primitive : m_Primitives)
+		{
+			if (lodCount > 1)
+			{
+				primitive.GenerateLods(lodCount);
+			}
+
+			if (CVar_Meshlets.Get())
+			{
+				primitive.BuildMeshlets();
+			}
+
+			primitive.Build();
+		}
+
+		AllocateInstances();
+	}
+
+	uint32_t Mesh::AddInstance(glm::mat4 matrix)
+	{
+		HG_CORE_ASSERT(!m_InstancesLocked, "Instances can't be added once a draw list, cluster list or acceleration structure holds the mesh");
+
+		m_ModelMatrices.push_back(matrix);
+		UpdateBounds();
+
+		// Growing moves every instance, instances added before Build are allocated there
+		if (m_Instances.Count > 0)
+		{
+			AllocateInstances();
+		}
+
+		return static_cast<uint32_t>(m_ModelMatrices.size() - 1);
+	}
+
+	void Mesh::SetModelMatrix(glm::mat4 matrix, uint32_t instance)
+	{
+		if (matrix == m_ModelMatrices[instance])
+			return;
+
+		m_ModelMatrices[instance] = matrix;
+		UpdateBounds(instance);
 
-		for (int i = 0; i < m_Primitives.size(); ++i)
+		if (m_Instances.Count == 0)
+			return;
+
+		for (const auto& primitive : m_Primitives)
 		{
-			m_Primitives[i].Build(m_VertexBuffer, m_VertexOffsets[i], m_IndexBuffer, m_IndexOffsets[i]);
+			SceneBuffer::Update(primitive.GetInstanceIndex() + instance, matrix, primitive.GetMaterialIndex());
 		}
 	}
 
-	void Mesh::Draw(VkCommandBuffer commandBuffer)
+	void Mesh::UpdateBounds()
+	{
+		m_WorldSpheres.resize(m_Primitives.size() * m_ModelMatrices.size());
+		m_WorldBoxes.resize(m_WorldSpheres.size());
+
+		for (uint32_t i = 0; i < m_ModelMatrices.size(); i++)
+		{
+			UpdateBounds(i);
+		}
+	}
+
+	void Mesh::UpdateBounds(uint32_t instance)
+	{
+		for (size_t i = 0; i < m_Primitives.size(); i++)
+		{
+			size_t index = i * m_ModelMatrices.size() + instance;
+			m_WorldSpheres[index] = Math::TransformSphere(m_Primitives[i].GetBoundingSphere(), m_ModelMatrices[instance]);
+			m_WorldBoxes[index] = Math::TransformAABB(m_Primitives[i].GetBoundingBox(), m_ModelMatrices[instance]);
+		}
+
+		m_BoundsVersion++;
+	}
+
+	void Mesh::AllocateInstances()
+	{
+		SceneBuffer::Free(m_Instances.Offset, m_Instances.Count);
+
+		std::vector<SceneObject> objects;
+		objects.reserve(m_Primitives.size() * m_ModelMatrices.size());
+		for (const auto& primitive : m_Primitives)
+		{
+			for (const auto& matrix : m_ModelMatrices)
+			{
+				objects.push_back(SceneBuffer::CreateObject(matrix, primitive.GetMaterialIndex(), primitive.GetPositionBounds()));
+			}
+		}
+
+		uint32_t firstInstance = SceneBuffer::Allocate(objects);
+		m_Instances = { firstInstance, static_cast<uint32_t>(objects.size()) };
+
+		for (uint32_t i = 0; i < m_Primitives.size(); i++)
+		{
+			m_Primitives[i].m_InstanceIndex = firstInstance + i * static_cast<uint32_t>(m_ModelMatrices.size());
+		}
+	}
+
+	void Mesh::SelectLods(const glm::mat4& viewProjection, float pixelScale, uint32_t lodBias, uint8_t* visibility) const
+	{
+		HG_PROFILE_FUNCTION();
+
+		// The y row of a projection times a rigid view transform keeps the projection's y scale as its length
+		float projectionScale = glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]));
+		// Orthographic projections have a constant w, errors project the same at any distance
+		bool perspective = viewProjection[0][3] != 0.0f || viewProjection[1][3] != 0.0f || viewProjection[2][3] != 0.0f;
+
+		uint32_t instanceCount = static_cast<uint32_t>(m_ModelMatrices.size());
+		for (size_t p = 0; p < m_Primitives.size(); p++)
+		{
+			const auto& lods = m_Primitives[p].GetLods();
+			float radius = m_Primitives[p].GetBoundingSphere().w;
+
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				size_t index = p * instanceCount + i;
+				if (!visibility[index])
+					continue;
+
+				// Distance to the nearest point of the bounds, the camera inside them keeps full detail
+				const glm::vec4& sphere = m_WorldSpheres[index];
+				float distance = perspective ? (viewProjection * glm::vec4(glm::vec3(sphere), 1.0f)).w - sphere.w : 1.0f;
+				float scale = radius > 0.0f ? sphere.w / radius : 1.0f;
+
+				size_t lod = 0;
+				while (distance > 0.0f && lod + 1 < lods.size() && lods[lod + 1].Error * scale * projectionScale * pixelScale <= distance)
+				{
+					lod++;
+				}
+
+				lod = std::min<size_t>(lod + lodBias, lods.size() - 1);
+				visibility[index] = static_cast<uint8_t>(lod + 1);
+			}
+		}
+	}
+
+	void Mesh::Draw(VkCommandBuffer commandBuffer, VkIndexType& boundIndexType, const uint8_t* visibility)
 	{
 		HG_PROFILE_FUNCTION()
 
+		uint32_t instanceCount = static_cast<uint32_t>(m_ModelMatrices.size());
 		for (auto && primitive: m_Primitives)
 		{
-			VkBuffer vertexBuffers[] = { m_VertexBuffer->GetHandle() };
-			VkDeviceSize offsets[] = { primitive.GetVertexOffset() };
+			if (primitive.GetIndexType() != boundIndexType)
+			{
+				GeometryArena::BindIndices(commandBuffer, primitive.GetIndexType());
+				boundIndexType = primitive.GetIndexType();
+			}
+
+			if (visibility == nullptr)
+			{
+				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(primitive.GetIndexCount()), instanceCount,
+					primitive.GetFirstIndex(), static_cast<int32_t>(primitive.GetFirstVertex()), primitive.GetInstanceIndex());
+				continue;
+			}
+
+			// Runs of visible instances at the same level of detail stay a single instanced draw
+			for (uint32_t first = 0; first < instanceCount;)
+			{
+				if (!visibility[first])
+				{
+					first++;
+					continue;
+				}
+
+				uint32_t last = first + 1;
+				while (last < instanceCount && visibility[last] == visibility[first])
+				{
+					last++;
+				}
 
-			vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->GetHandle(), primitive.GetIndexOffset(), VK_INDEX_TYPE_UINT16);
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+				// Masks that only went through culling hold 1, the full detail level
+				const MeshLod& lod = primitive.GetLods()[std::min<size_t>(visibility[first] - 1, primitive.GetLods().size() - 1)];
+				vkCmdDrawIndexed(commandBuffer, lod.IndexCount, last - first,
+					primitive.GetFirstIndex() + lod.FirstIndex, static_cast<int32_t>(primitive.GetFirstVertex()), primitive.GetInstanceIndex() + first);
+				first = last;
+			}
 
-			vkCmdDrawIndexed(commandBuffer,  static_cast<uint32_t>(primitive.GetIndexCount()), 1, 0, 0, 0);
+			visibility += instanceCount;
 		}
 	}
 }
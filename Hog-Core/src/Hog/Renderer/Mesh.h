@@ -1,39 +1,101 @@
 #pragma once
 
 #include <Hog/Renderer/Buffer.h>
+#include <Hog/Renderer/GeometryArena.h>
+#include <Hog/Renderer/SceneBuffer.h>
+#include <Hog/Math/Math.h>
+#include <Hog/Utils/MeshletBuilder.h>
 
 namespace Hog
 {
+	// Index range of one level of detail, relative to the primitive's first index
+	struct MeshLod
+	{
+		uint32_t FirstIndex;
+		uint32_t IndexCount;
+		// Object space distance the simplified surface deviates from the full detail one by
+		float Error;
+	};
+
 	class MeshPrimitive
 	{
 	public:
-		MeshPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint16_t>& indexData);
+		static constexpr uint32_t MaxLodCount = 4;
+	public:
+		// Indices are stored as 16 bit on the GPU whenever the vertex count allows it
+		MeshPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint32_t>& indexData);
 
-		void Build(Ref<Buffer> vertexBuffer, uint64_t vertexOffset, Ref<Buffer> indexBuffer, uint64_t indexOffset);
+		// Appends simplified index lists that reuse the vertices, each about half the triangles of the one before.
+		// Stops early once simplification stalls, it has to happen before the primitive is built
+		void GenerateLods(uint32_t lodCount);
+		// Splits the full detail level into meshlets, each covers a contiguous range of its indices
+		void BuildMeshlets();
 
-		uint64_t GetVertexDataSize() const { return m_Vertices.size() * sizeof(Vertex); }
-		uint64_t GetIndexDataSize() const { return m_Indices.size() * sizeof(uint16_t); }
+		// Sub-allocates the primitive from the geometry arena and uploads it
+		void Build();
+		void Release();
+
+		// Size in the geometry arena's vertex format
+		uint64_t GetVertexDataSize() const { return m_Vertices.size() * GeometryArena::GetVertexStride(); }
+		uint64_t GetIndexDataSize() const { return m_Indices.size() * GetIndexSize(); }
 
 		size_t GetVertexCount() const { return m_Vertices.size(); }
-		size_t GetIndexCount() const { return m_Indices.size(); }
+		// Indices of the full detail level
+		size_t GetIndexCount() const { return m_Lods.front().IndexCount; }
+		VkIndexType GetIndexType() const { return m_IndexType; }
+		uint32_t GetIndexSize() const { return m_IndexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t); }
 
 		uint64_t GetVertexOffset() const { return m_VertexRegion->GetOffset(); }
+		uint64_t GetPositionOffset() const { return m_PositionRegion->GetOffset(); }
 		uint64_t GetIndexOffset() const { return m_IndexRegion->GetOffset(); }
 
+		// Element offsets into the arena, used as vertexOffset and firstIndex of the draw. The first index is in elements of the index type
+		uint32_t GetFirstVertex() const { return m_VertexAllocation.Offset; }
+		uint32_t GetFirstIndex() const { return m_IndexAllocation.Offset; }
+		// First of the mesh's instance count consecutive scene buffer slots, used as firstInstance of the draw
+		uint32_t GetInstanceIndex() const { return m_InstanceIndex; }
+
 		Ref<BufferRegion> GetVertexRegion() { return m_VertexRegion; }
 		Ref<BufferRegion> GetIndexRegion() { return m_IndexRegion; }
+		// Null unless the arena keeps a position stream
+		Ref<BufferRegion> GetPositionRegion() { return m_PositionRegion; }
 
 		void SetVertexRegion(Ref<BufferRegion> vertexRegion) { m_VertexRegion = std::move(vertexRegion); }
 		void SetIndexRegion(Ref<BufferRegion> indexRegion) { m_VertexRegion = std::move(indexRegion); }
 
 		const std::vector<Vertex>& GetVertices() const { return m_Vertices; }
-		const std::vector<uint16_t>& GetIndices() const { return m_Indices; }
+		// Every level of detail, one after the other
+		const std::vector<uint32_t>& GetIndices() const { return m_Indices; }
+		// Finest first, there is always at least the full detail level
+		const std::vector<MeshLod>& GetLods() const { return m_Lods; }
+		// Empty unless BuildMeshlets was called
+		const Util::MeshletData& GetMeshlets() const { return m_Meshlets; }
+		// Vertices in the compact layout, quantized against the position bounds
+		std::vector<CompactVertex> Compact() const;
+
+		// Object space center in xyz and radius in w
+		glm::vec4 GetBoundingSphere() const { return m_BoundingSphere; }
+		const Math::AABB& GetBoundingBox() const { return m_BoundingBox; }
+		// Center in xyz and half extent of the largest axis in w, compact vertex positions are quantized relative to it
+		glm::vec4 GetPositionBounds() const;
+		int32_t GetMaterialIndex() const { return m_Vertices.empty() ? 0 : m_Vertices.front().MaterialIndex; }
 	public:
 		std::vector<Vertex> m_Vertices;
-		std::vector<uint16_t> m_Indices;
+		std::vector<uint32_t> m_Indices;
+		std::vector<MeshLod> m_Lods;
+		Util::MeshletData m_Meshlets;
+		VkIndexType m_IndexType = VK_INDEX_TYPE_UINT16;
 
 		Ref<BufferRegion> m_VertexRegion;
 		Ref<BufferRegion> m_IndexRegion;
+		Ref<BufferRegion> m_PositionRegion;
+
+		GeometryAllocation m_VertexAllocation;
+		GeometryAllocation m_IndexAllocation;
+
+		glm::vec4 m_BoundingSphere = glm::vec4(0.0f);
+		Math::AABB m_BoundingBox;
+		uint32_t m_InstanceIndex = 0;
 	};
 
 	class Mesh
@@ -43,37 +105,64 @@ namespace Hog
 
 		Mesh(const std::string& name)
 			: m_Name(name) {}
-		~Mesh() = default;
+		~Mesh();
 
-		void AddPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint16_t>& indexData);
+		void AddPrimitive(const std::vector<Vertex>& vertexData, const std::vector<uint32_t>& indexData);
 		size_t GetPrimitiveCount() const { return m_Primitives.size(); }
+		// Combines primitives that share a material into one, so they are drawn by a single draw.
+		// Build does this unless renderer.mergePrimitives is 0, it has to happen before the mesh is built
+		void MergePrimitives();
 		void Build();
 
-		void SetModelMatrix(glm::mat4 matrix) { m_ModelMatrix = matrix; }
-		glm::mat4 GetModelMatrix() const { return m_ModelMatrix; }
-
-		Ref<Buffer> GetVertexBuffer() { return m_VertexBuffer; }
-		Ref<Buffer> GetIndexBuffer() { return m_IndexBuffer; }
-
-		void Draw(VkCommandBuffer commandBuffer);
+		// Places the same geometry once more, all instances are drawn by a single instanced draw per primitive.
+		// Adding instances to a built mesh moves all of them in the scene buffer, so it is not allowed once they are locked
+		uint32_t AddInstance(glm::mat4 matrix);
+		// Called by structures that keep scene buffer slots or instance counts, like DrawList, ClusterList and acceleration structures
+		void LockInstances() { m_InstancesLocked = true; }
+		size_t GetInstanceCount() const { return m_ModelMatrices.size(); }
+
+		// Built meshes copy the new transform into the scene buffer at the start of the next frame
+		void SetModelMatrix(glm::mat4 matrix, uint32_t instance = 0);
+		glm::mat4 GetModelMatrix(uint32_t instance = 0) const { return m_ModelMatrices[instance]; }
+
+		// World space bounds of every primitive instance, indexed by primitive * instance count + instance
+		const std::vector<glm::vec4>& GetWorldSpheres() const { return m_WorldSpheres; }
+		const std::vector<Math::AABB>& GetWorldBoxes() const { return m_WorldBoxes; }
+		// Changes whenever the world bounds do, so cached copies know when to refresh
+		uint64_t GetBoundsVersion() const { return m_BoundsVersion; }
+
+		Ref<Buffer> GetVertexBuffer() { return GeometryArena::GetVertexBuffer(); }
+		Ref<Buffer> GetIndexBuffer() { return GeometryArena::GetIndexBuffer(); }
+
+		// Replaces every non zero entry of a visibility mask, laid out like the world bounds, with one plus the level of detail to draw.
+		// Picks the coarsest level whose error projects to at most one pixel, pixelScale is the viewport height in pixels
+		// divided by twice the error threshold. Stages that can do with less detail, like shadows, skip lodBias levels further
+		void SelectLods(const glm::mat4& viewProjection, float pixelScale, uint32_t lodBias, uint8_t* visibility) const;
+
+		// Expects the geometry arena to be bound and the scene buffer to be accessible by the stage.
+		// The index buffer is only rebound when a primitive's index type differs from boundIndexType, which is updated.
+		// With a visibility mask only visible instances are drawn, at the level of detail SelectLods stored in it
+		void Draw(VkCommandBuffer commandBuffer, VkIndexType& boundIndexType, const uint8_t* visibility = nullptr);
 		
 		std::vector<MeshPrimitive>::iterator begin() { return m_Primitives.begin(); }
 		std::vector<MeshPrimitive>::iterator end() { return m_Primitives.end(); }
 		std::vector<MeshPrimitive>::const_iterator begin() const { return m_Primitives.begin(); }
 		std::vector<MeshPrimitive>::const_iterator end() const { return m_Primitives.end(); }
+	private:
+		// Scene buffer slots are grouped per primitive, so each primitive's instances are consecutive
+		void AllocateInstances();
+		void UpdateBounds();
+		void UpdateBounds(uint32_t instance);
 	private:
 		std::string m_Name;
 		std::vector<MeshPrimitive> m_Primitives;
 
-		Ref<Buffer> m_VertexBuffer;
-		Ref<Buffer> m_IndexBuffer;
-
-		std::vector<uint64_t> m_VertexOffsets;
-		std::vector<uint64_t> m_IndexOffsets;
-
-		size_t m_VertexBufferSize = 0;
-		size_t m_IndexBufferSize = 0;
+		std::vector<glm::mat4> m_ModelMatrices = { glm::mat4(1.0f) };
+		GeometryAllocation m_Instances;
+		bool m_InstancesLocked = false;
 
-		glm::mat4 m_ModelMatrix = glm::mat4(1.0f);
+		std::vector<glm::vec4> m_WorldSpheres;
+		std::vector<Math::AABB> m_WorldBoxes;
+		uint64_t m_BoundsVersion = 0;
 	};
 }
@@ -136,7 +136,7 @@ namespace Hog
 
 	void GraphicsPipeline::Generate(VkRenderPass renderPass, VkSpecializationInfo* specializationInfo)
 	{
-		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources);
+		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources, m_DynamicBindings, m_Config.VertexFormat, m_Config.VertexStream);
 
 		for (const auto& [stage, source] : m_ShaderSources)
 		{
@@ -168,6 +168,19 @@ namespace Hog
 		CheckVkResult(vkCreateGraphicsPipelines(GraphicsContext::GetDevice(), VK_NULL_HANDLE, 1, &m_GraphicsPipelineCreateInfo, nullptr, &m_Handle));
 	}
 
+	void GraphicsPipeline::Generate(const RenderingFormats& formats, VkSpecializationInfo* specializationInfo)
+	{
+		m_RenderingFormats = formats;
+
+		m_RenderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(m_RenderingFormats.Color.size());
+		m_RenderingCreateInfo.pColorAttachmentFormats = m_RenderingFormats.Color.data();
+		m_RenderingCreateInfo.depthAttachmentFormat = m_RenderingFormats.Depth;
+		m_RenderingCreateInfo.stencilAttachmentFormat = m_RenderingFormats.Stencil;
+		m_GraphicsPipelineCreateInfo.pNext = &m_RenderingCreateInfo;
+
+		Generate(VK_NULL_HANDLE, specializationInfo);
+	}
+
 	void GraphicsPipeline::Bind(VkCommandBuffer commandBuffer)
 	{
 		HG_PROFILE_FUNCTION();
@@ -192,7 +205,7 @@ namespace Hog
 
 	void ComputePipeline::Generate(VkRenderPass renderPass, VkSpecializationInfo* specializationInfo)
 	{
-		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources);
+		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources, m_DynamicBindings);
 
 		m_PipelineLayout = data.PipelineLayout;
 		m_ComputePipelineCreateInfo.layout = m_PipelineLayout;
@@ -239,7 +252,9 @@ namespace Hog
 
 	void RayTracingPipeline::Generate(VkRenderPass renderPass, VkSpecializationInfo* specializationInfo)
 	{
-		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources);
+		HG_CORE_ASSERT(GraphicsContext::HasRayTracing(), "Ray tracing pipelines need a device with ray tracing support");
+
+		auto data = ShaderReflection::ReflectPipelineLayout(m_ShaderSources, m_DynamicBindings);
 
 		m_PipelineLayout = data.PipelineLayout;
 
@@ -7,16 +7,34 @@
 
 namespace Hog
 {
+	// Attachment formats a graphics pipeline is built against when it renders without a render pass
+	struct RenderingFormats
+	{
+		std::vector<VkFormat> Color;
+		VkFormat Depth = VK_FORMAT_UNDEFINED;
+		VkFormat Stencil = VK_FORMAT_UNDEFINED;
+		// Sample count the attachments share, the swapchain is always single sampled
+		VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
 	class Pipeline
 	{
 	public:
 		~Pipeline();
 
 		virtual void Generate(VkRenderPass renderPass, VkSpecializationInfo* specializationInfo) = 0;
+		virtual void Generate(const RenderingFormats& formats, VkSpecializationInfo* specializationInfo) { Generate(VK_NULL_HANDLE, specializationInfo); }
 		virtual void Bind(VkCommandBuffer commandBuffer) = 0;
 
 		VkPipeline GetHandle() { return m_Handle; }
 		VkPipelineLayout GetPipelineLayout() { return m_PipelineLayout; }
+		// Vertex buffer of the geometry arena stages bind before drawing with this pipeline
+		virtual VertexStream GetVertexStream() const { return VertexStream::Interleaved; }
+		// Graphics pipelines with a mesh shader are drawn with vkCmdDrawMeshTasksEXT and take no vertex input
+		bool HasMeshShader() const { return m_ShaderSources.contains(ShaderType::Defaults::Mesh); }
+
+		// Buffer bindings of set 0 that take a dynamic offset, has to be set before Generate
+		void SetDynamicBindings(const std::unordered_set<uint32_t>& bindings) { m_DynamicBindings = bindings; }
 	protected:
 		void AddShader(std::string shader);
 		void AddShaderStage(ShaderType type, VkShaderModule shaderModule, VkSpecializationInfo* specializationInfo, const char* main = "main");
@@ -26,6 +44,7 @@ namespace Hog
 		std::vector<VkPipelineShaderStageCreateInfo> m_ShaderStageCreateInfos;
 		VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;;
 		VkPipeline m_Handle = VK_NULL_HANDLE;
+		std::unordered_set<uint32_t> m_DynamicBindings;
 	};
 
 	class GraphicsPipeline : public Pipeline
@@ -34,6 +53,9 @@ namespace Hog
 		struct Configuration
 		{
 			std::vector<std::string> Shaders;
+			// Layout of the vertex buffer, compact pipelines have to be used with renderer.geometry.compactVertices
+			VertexFormat VertexFormat = VertexFormat::Full;
+			VertexStream VertexStream = VertexStream::Interleaved;
 
 			// VkPipelineInputAssemblyStateCreateInfo
 			struct InputAssemblyState
@@ -124,9 +146,16 @@ namespace Hog
 		~GraphicsPipeline();
 
 		virtual void Generate(VkRenderPass renderPass, VkSpecializationInfo* specializationInfo) override;
+		virtual void Generate(const RenderingFormats& formats, VkSpecializationInfo* specializationInfo) override;
 		virtual void Bind(VkCommandBuffer commandBuffer) override;
+		virtual VertexStream GetVertexStream() const override { return m_Config.VertexStream; }
 	private:
 		Configuration m_Config;
+		RenderingFormats m_RenderingFormats;
+
+		VkPipelineRenderingCreateInfo m_RenderingCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		};
 
 		VkPipelineVertexInputStateCreateInfo m_VertexInputStateCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -2,8 +2,263 @@
 
 #include "RenderGraph.h"
 
+#include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Utils/RendererUtils.h"
+
 namespace Hog
 {
+	namespace Util
+	{
+		static constexpr VkAccessFlags2 WriteAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+		// Stages and accesses a barrier recorded on the compute queue may reference
+		static constexpr VkPipelineStageFlags2 ComputeQueueStages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+			VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		static constexpr VkAccessFlags2 ComputeQueueAccess = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT |
+			VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+			VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+		struct ResourceUsage
+		{
+			VkPipelineStageFlags2 Stage = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 Access = VK_ACCESS_2_NONE;
+			ImageLayout Layout = ImageLayout::Undefined;
+			bool Write = false;
+		};
+
+		struct ResourceState
+		{
+			VkPipelineStageFlags2 WriteStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 WriteAccess = VK_ACCESS_2_NONE;
+			VkPipelineStageFlags2 ReadStages = VK_PIPELINE_STAGE_2_NONE;
+			VkPipelineStageFlags2 VisibleStages = VK_PIPELINE_STAGE_2_NONE;
+			ImageLayout Layout = ImageLayout::Undefined;
+			// Stages of this frame that last wrote the resource and read it since
+			uint32_t Writer = UINT32_MAX;
+			std::vector<uint32_t> Readers;
+		};
+
+		template<typename T>
+		struct TrackedUsage
+		{
+			Ref<T> Resource;
+			ResourceUsage Usage;
+		};
+
+		template<typename T>
+		static void AddUsage(std::vector<TrackedUsage<T>>& usages, const Ref<T>& resource, const ResourceUsage& usage)
+		{
+			auto it = std::find_if(usages.begin(), usages.end(), [&resource](const TrackedUsage<T>& tracked) { return tracked.Resource == resource; });
+			if (it == usages.end())
+			{
+				usages.push_back({ resource, usage });
+				return;
+			}
+
+			// Attachments are added first so their layout wins
+			it->Usage.Stage |= usage.Stage;
+			it->Usage.Access |= usage.Access;
+			it->Usage.Write |= usage.Write;
+			if (it->Usage.Layout == ImageLayout::Undefined)
+			{
+				it->Usage.Layout = usage.Layout;
+			}
+		}
+
+		static void CollectUsages(const StageDescription& stage, std::vector<TrackedUsage<Image>>& images, std::vector<TrackedUsage<Buffer>>& buffers)
+		{
+			for (const auto& attachment : stage.Attachments)
+			{
+				switch (attachment.Type)
+				{
+					case AttachmentType::Color:
+					{
+						AddUsage(images, attachment.Image, { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+							VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | (attachment.Clear ? VK_ACCESS_2_NONE : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT),
+							ImageLayout::ColorAttachmentOptimal, true });
+					}break;
+					case AttachmentType::Depth:
+					case AttachmentType::DepthStencil:
+					{
+						AddUsage(images, attachment.Image, { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+							VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+							ImageLayout::DepthStencilAttachmentOptimal, true });
+					}break;
+					// The swapchain image is owned by the frame and transitioned by its render pass
+					case AttachmentType::Swapchain: break;
+				}
+			}
+
+			for (const auto& resource : stage.Resources)
+			{
+				VkPipelineStageFlags2 shaderStages = ToPipelineStageFlags2(resource.BindLocation);
+
+				switch (resource.Type)
+				{
+					case ResourceType::Sampler:
+					{
+						AddUsage(images, resource.Texture->GetImage(), { shaderStages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, ImageLayout::ShaderReadOnlyOptimal, false });
+					}break;
+					case ResourceType::StorageImage:
+					{
+						AddUsage(images, resource.StorageImage, { shaderStages,
+							VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, ImageLayout::General, true });
+					}break;
+					case ResourceType::Uniform:
+					{
+						AddUsage(buffers, resource.Buffer, { shaderStages, VK_ACCESS_2_UNIFORM_READ_BIT, ImageLayout::Undefined, false });
+					}break;
+					case ResourceType::Storage:
+					{
+						AddUsage(buffers, resource.Buffer, { shaderStages,
+							VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, ImageLayout::Undefined, true });
+					}break;
+					default: break;
+				}
+			}
+
+			if (stage.DispatchBuffer)
+			{
+				bool compute = stage.StageType == RendererStageType::ForwardCompute || stage.StageType == RendererStageType::DeferredCompute;
+				if (compute)
+				{
+					// Draw count is cleared before the dispatch appends to it
+					AddUsage(buffers, stage.DispatchBuffer, { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+						VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, ImageLayout::Undefined, true });
+				}
+				else
+				{
+					AddUsage(buffers, stage.DispatchBuffer, { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, ImageLayout::Undefined, false });
+				}
+			}
+		}
+
+		// Advances the tracked state by one usage and reports whether a barrier has to precede it
+		static bool ResolveHazard(ResourceState& state, const ResourceUsage& usage, bool isImage, BarrierDescription& barrier)
+		{
+			bool layoutChange = isImage && state.Layout != usage.Layout;
+			VkPipelineStageFlags2 srcStage = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+			bool needed = layoutChange;
+
+			if (layoutChange || usage.Write)
+			{
+				// Writes and layout transitions wait for the previous write and every read since
+				srcStage = state.WriteStages | state.ReadStages;
+				srcAccess = state.WriteAccess;
+				needed |= srcStage != VK_PIPELINE_STAGE_2_NONE;
+			}
+			else if (state.WriteStages != VK_PIPELINE_STAGE_2_NONE && (state.VisibleStages & usage.Stage) != usage.Stage)
+			{
+				srcStage = state.WriteStages;
+				srcAccess = state.WriteAccess;
+				needed = true;
+			}
+
+			barrier = BarrierDescription(static_cast<PipelineStage>(srcStage), static_cast<AccessFlag>(srcAccess),
+				static_cast<PipelineStage>(usage.Stage), static_cast<AccessFlag>(usage.Access),
+				state.Layout, isImage ? usage.Layout : ImageLayout::Undefined);
+
+			if (layoutChange || usage.Write)
+			{
+				state.WriteStages = usage.Stage;
+				state.WriteAccess = usage.Access & WriteAccessMask;
+				state.ReadStages = usage.Write ? VK_PIPELINE_STAGE_2_NONE : usage.Stage;
+				state.VisibleStages = usage.Stage;
+				state.Layout = usage.Layout;
+			}
+			else
+			{
+				state.ReadStages |= usage.Stage;
+				state.VisibleStages |= usage.Stage;
+			}
+
+			return needed;
+		}
+
+		// Records the earlier stages of the other queue a usage has to wait for, stages on one queue are ordered by barriers
+		static void TrackQueueHazard(ResourceState& state, bool write, uint32_t stage, const std::vector<Ref<Node>>& stages)
+		{
+			auto& waits = stages[stage]->QueueWaits;
+			auto addWait = [&](uint32_t other)
+				{
+					if (other == UINT32_MAX || stages[other]->Queue == stages[stage]->Queue)
+						return;
+
+					if (std::find(waits.begin(), waits.end(), other) == waits.end())
+					{
+						waits.push_back(other);
+					}
+				};
+
+			addWait(state.Writer);
+
+			if (write)
+			{
+				for (auto reader : state.Readers)
+				{
+					addWait(reader);
+				}
+
+				state.Writer = stage;
+				state.Readers.clear();
+			}
+			else
+			{
+				state.Readers.push_back(stage);
+			}
+		}
+
+		// Stages whose results leave the graph, everything they don't depend on is culled
+		static bool IsOutputStage(const StageDescription& stage)
+		{
+			return stage.Output || stage.StageType == RendererStageType::Blit || stage.StageType == RendererStageType::ImGui ||
+				stage.Attachments.ContainsType(AttachmentType::Swapchain);
+		}
+
+		// Async stages only leave the graphics queue when every resource they touch is shared with the compute family
+		static QueueType SelectQueue(const StageDescription& stage, const std::vector<TrackedUsage<Image>>& images, const std::vector<TrackedUsage<Buffer>>& buffers)
+		{
+			bool compute = stage.StageType == RendererStageType::ForwardCompute || stage.StageType == RendererStageType::DeferredCompute;
+			if (!compute || !stage.AsyncCompute || !GraphicsContext::HasAsyncCompute())
+				return QueueType::Graphics;
+
+			bool shared = std::all_of(images.begin(), images.end(), [](const TrackedUsage<Image>& tracked) { return tracked.Resource->IsConcurrent(); }) &&
+				std::all_of(buffers.begin(), buffers.end(), [](const TrackedUsage<Buffer>& tracked) { return tracked.Resource->IsConcurrent(); });
+
+			if (!shared)
+			{
+				HG_CORE_WARN("Async compute stage '{}' uses resources without concurrent sharing, it runs on the graphics queue", stage.Name);
+				return QueueType::Graphics;
+			}
+
+			return QueueType::Compute;
+		}
+
+		static VkExtent2D ScaleExtent(VkExtent2D extent, float scale)
+		{
+			return { std::max(static_cast<uint32_t>(extent.width * scale), 1u), std::max(static_cast<uint32_t>(extent.height * scale), 1u) };
+		}
+
+		// Work from the other queue is ordered by the semaphore wait, so only scopes valid on this queue are kept
+		static void RestrictToQueue(BarrierDescription& barrier, QueueType queue)
+		{
+			if (queue != QueueType::Compute)
+				return;
+
+			barrier.SrcStage = static_cast<PipelineStage>(static_cast<VkPipelineStageFlags2>(barrier.SrcStage) & ComputeQueueStages);
+			barrier.SrcAccessMask = static_cast<AccessFlag>(static_cast<VkAccessFlags2>(barrier.SrcAccessMask) & ComputeQueueAccess);
+			barrier.DstStage = static_cast<PipelineStage>(static_cast<VkPipelineStageFlags2>(barrier.DstStage) & ComputeQueueStages);
+			barrier.DstAccessMask = static_cast<AccessFlag>(static_cast<VkAccessFlags2>(barrier.DstAccessMask) & ComputeQueueAccess);
+
+			if (barrier.SrcStage == PipelineStage::None)
+			{
+				barrier.SrcAccessMask = AccessFlag::None;
+			}
+		}
+	}
+
 	bool AttachmentLayout::ContainsType(AttachmentType type) const
 	{
 		for (const auto& elem : m_Elements)
@@ -27,10 +282,62 @@ namespace Hog
 	void RenderGraph::Cleanup()
 	{
 		m_StartingPoints.clear();
+
+		// Images have to go before the memory they are bound to
+		m_TransientImages.clear();
+		FreeTransientMemory();
+	}
+
+	Ref<Image> RenderGraph::CreateTransientImage(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples)
+	{
+		auto image = Image::CreateTransient(description, width, height, levelCount, format, samples);
+		m_TransientImages.push_back({ image });
+
+		return image;
+	}
+
+	Ref<Image> RenderGraph::CreateTransientImage(ImageDescription description, uint32_t levelCount, VkSampleCountFlagBits samples)
+	{
+		return CreateTransientImage(description, levelCount, 1.0f, samples);
+	}
+
+	Ref<Image> RenderGraph::CreateTransientImage(ImageDescription description, uint32_t levelCount, float scale, VkSampleCountFlagBits samples)
+	{
+		HG_CORE_ASSERT(scale > 0.0f, "Swapchain relative transient images need a positive scale");
+
+		VkExtent2D extent = Util::ScaleExtent(GraphicsContext::GetExtent(), scale);
+		auto image = Image::CreateTransient(description, extent.width, extent.height, levelCount, description, samples);
+		m_TransientImages.push_back({ image, scale });
+
+		return image;
+	}
+
+	void RenderGraph::ResizeTransientImages()
+	{
+		// Memory can't be rebound, so fixed size images are recreated as well to be aliased again
+		for (const auto& [image, scale] : m_TransientImages)
+		{
+			VkExtent2D extent = scale > 0.0f ? Util::ScaleExtent(GraphicsContext::GetExtent(), scale) : image->GetExtent();
+			image->Resize(extent.width, extent.height, image->GetLevelCount());
+		}
+
+		FreeTransientMemory();
+	}
+
+	void RenderGraph::FreeTransientMemory()
+	{
+		m_AliasGroups.clear();
+		for (auto allocation : m_TransientAllocations)
+		{
+			vmaFreeMemory(GraphicsContext::GetAllocator(), allocation);
+		}
+		m_TransientAllocations.clear();
 	}
 
 	Ref<Node> RenderGraph::AddStage(Ref<Node> parent, const StageDescription& stageInfo)
 	{
+		m_Dirty = true;
+
 		if (parent == nullptr)
 		{
 			auto ref = Node::Create(stageInfo);
@@ -46,12 +353,41 @@ namespace Hog
 
 	Ref<Node> RenderGraph::AddStage(const std::vector<Ref<Node>>& parents, const StageDescription& stageInfo)
 	{
+		m_Dirty = true;
+
 		return Node::Create(parents, stageInfo);
 	}
 
-	std::vector<Ref<Node>> RenderGraph::GetStages()
+	const std::vector<Ref<Node>>& RenderGraph::GetStages()
+	{
+		if (m_Dirty)
+		{
+			Sort();
+		}
+
+		return m_Stages;
+	}
+
+	std::vector<Ref<Node>> RenderGraph::GetFinalStages()
 	{
 		std::vector<Ref<Node>> stages;
+		for (const auto& node : GetStages())
+		{
+			if (node->IsEndNode())
+			{
+				stages.push_back(node);
+			}
+		}
+
+		return stages;
+	}
+
+	void RenderGraph::Sort()
+	{
+		HG_PROFILE_FUNCTION();
+
+		std::vector<Ref<Node>> nodes;
+		std::unordered_map<Node*, uint32_t> indices;
 		std::queue<Ref<Node>> toVisit;
 		for (auto node : m_StartingPoints)
 		{
@@ -61,50 +397,306 @@ namespace Hog
 		while (!toVisit.empty())
 		{
 			Ref<Node> visiting = toVisit.front();
+			toVisit.pop();
 
-			if (std::find(stages.begin(), stages.end(), visiting) == stages.end())
-			{
-				stages.push_back(visiting);
-			}
+			if (!indices.emplace(visiting.get(), static_cast<uint32_t>(nodes.size())).second)
+				continue;
+
+			nodes.push_back(visiting);
+			visiting->Level = 0;
 
 			for (auto child : visiting->ChildList)
 			{
 				toVisit.push(child);
 			}
+		}
 
-			toVisit.pop();
+		// Kahn's algorithm, a stage only becomes ready once all of its parents are ordered
+		std::vector<uint32_t> inDegrees(nodes.size(), 0);
+		for (const auto& node : nodes)
+		{
+			for (const auto& child : node->ChildList)
+			{
+				inDegrees[indices[child.get()]]++;
+			}
 		}
 
-		return stages;
+		std::queue<uint32_t> ready;
+		for (uint32_t i = 0; i < nodes.size(); i++)
+		{
+			if (inDegrees[i] == 0)
+			{
+				ready.push(i);
+			}
+		}
+
+		std::vector<Ref<Node>> order;
+		order.reserve(nodes.size());
+		while (!ready.empty())
+		{
+			const auto& node = nodes[ready.front()];
+			ready.pop();
+			order.push_back(node);
+
+			for (const auto& child : node->ChildList)
+			{
+				child->Level = std::max(child->Level, node->Level + 1);
+
+				uint32_t childIndex = indices[child.get()];
+				if (--inDegrees[childIndex] == 0)
+				{
+					ready.push(childIndex);
+				}
+			}
+		}
+
+		HG_CORE_ASSERT(order.size() == nodes.size(), "Render graph contains a cycle");
+
+		// Graphs without any presenting or readback stage keep everything that ends a path
+		bool hasOutputs = std::any_of(order.begin(), order.end(), [](const Ref<Node>& node) { return Util::IsOutputStage(node->StageInfo); });
+
+		// Consumers come after their producers, so walking backwards resolves every child first
+		std::unordered_set<Node*> alive;
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
+		{
+			const auto& node = *it;
+			bool output = hasOutputs ? Util::IsOutputStage(node->StageInfo) : node->IsEndNode();
+
+			if (output || std::any_of(node->ChildList.begin(), node->ChildList.end(), [&alive](const Ref<Node>& child) { return alive.contains(child.get()); }))
+			{
+				alive.insert(node.get());
+			}
+		}
+
+		m_Stages.clear();
+		m_Stages.reserve(alive.size());
+		for (const auto& node : order)
+		{
+			if (!alive.contains(node.get()))
+			{
+				HG_CORE_INFO("Render graph culled stage '{}', its results never reach an output", node->StageInfo.Name);
+				continue;
+			}
+
+			m_Stages.push_back(node);
+		}
+
+		// Parents always sit on a lower level, so grouping by level keeps the order valid
+		std::stable_sort(m_Stages.begin(), m_Stages.end(), [](const Ref<Node>& a, const Ref<Node>& b) { return a->Level < b->Level; });
+
+		m_Dirty = false;
 	}
 
-	std::vector<Ref<Node>> RenderGraph::GetFinalStages()
+	void RenderGraph::AllocateTransientImages(const std::vector<Ref<Node>>& stages)
 	{
-		std::vector<Ref<Node>> stages;
-		std::stack<Ref<Node>> toVisit;
-		for (auto node : m_StartingPoints)
+		struct Lifetime
 		{
-			toVisit.push(node);
+			Ref<Image> Image;
+			VkMemoryRequirements Requirements;
+			size_t First = SIZE_MAX;
+			size_t Last = 0;
+			// Async compute stages overlap graphics stages regardless of their order, so the lifetime doesn't bound its use
+			bool Async = false;
+		};
+
+		struct AliasGroup
+		{
+			std::vector<Lifetime*> Members;
+			VkMemoryRequirements Requirements;
+		};
+
+		std::vector<Lifetime> lifetimes;
+		lifetimes.reserve(m_TransientImages.size());
+		for (const auto& transient : m_TransientImages)
+		{
+			lifetimes.push_back({ transient.Image, transient.Image->GetMemoryRequirements() });
 		}
 
-		while (!toVisit.empty())
+		for (size_t i = 0; i < stages.size(); i++)
 		{
-			Ref<Node> visiting = toVisit.top();
-			toVisit.pop();
+			std::vector<Util::TrackedUsage<Image>> images;
+			std::vector<Util::TrackedUsage<Buffer>> buffers;
+			Util::CollectUsages(stages[i]->StageInfo, images, buffers);
 
-			if (visiting->IsEndNode() &&
-				std::find(stages.begin(), stages.end(), visiting) == stages.end())
+			for (const auto& [image, usage] : images)
 			{
-				stages.push_back(visiting);
+				auto it = std::find_if(lifetimes.begin(), lifetimes.end(), [&image](const Lifetime& lifetime) { return lifetime.Image == image; });
+				if (it == lifetimes.end())
+					continue;
+
+				it->First = std::min(it->First, i);
+				it->Last = std::max(it->Last, i);
+				it->Async |= stages[i]->Queue == QueueType::Compute;
 			}
+		}
 
-			for (auto child : visiting->ChildList)
+		// Largest images first so smaller ones fit into the allocations they leave behind
+		std::vector<Lifetime*> sorted;
+		for (auto& lifetime : lifetimes)
+		{
+			if (lifetime.First == SIZE_MAX)
 			{
-				toVisit.push(child);
+				HG_CORE_WARN("Transient image is not used by any stage");
+				continue;
 			}
+
+			sorted.push_back(&lifetime);
 		}
 
-		return stages;
+		std::sort(sorted.begin(), sorted.end(), [](const Lifetime* a, const Lifetime* b) { return a->Requirements.size > b->Requirements.size; });
+
+		std::vector<AliasGroup> groups;
+		for (auto lifetime : sorted)
+		{
+			auto group = std::find_if(groups.begin(), groups.end(), [lifetime](const AliasGroup& group)
+				{
+					if ((group.Requirements.memoryTypeBits & lifetime->Requirements.memoryTypeBits) == 0)
+						return false;
+
+					// Images of the compute queue keep memory to themselves
+					if (lifetime->Async || group.Members.front()->Async)
+						return false;
+
+					return std::none_of(group.Members.begin(), group.Members.end(), [lifetime](const Lifetime* member)
+						{
+							return member->First <= lifetime->Last && lifetime->First <= member->Last;
+						});
+				});
+
+			if (group == groups.end())
+			{
+				groups.push_back({ { lifetime }, lifetime->Requirements });
+				continue;
+			}
+
+			group->Members.push_back(lifetime);
+			group->Requirements.size = std::max(group->Requirements.size, lifetime->Requirements.size);
+			group->Requirements.alignment = std::max(group->Requirements.alignment, lifetime->Requirements.alignment);
+			group->Requirements.memoryTypeBits &= lifetime->Requirements.memoryTypeBits;
+		}
+
+		VmaAllocationCreateInfo allocationInfo = {
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+			.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		};
+
+		VkDeviceSize totalSize = 0, aliasedSize = 0;
+		for (const auto& group : groups)
+		{
+			VmaAllocation allocation;
+			CheckVkResult(vmaAllocateMemory(GraphicsContext::GetAllocator(), &group.Requirements, &allocationInfo, &allocation, nullptr));
+			m_TransientAllocations.push_back(allocation);
+
+			for (auto member : group.Members)
+			{
+				member->Image->BindMemory(allocation);
+				m_AliasGroups[member->Image.get()] = group.Members.front()->Image.get();
+				totalSize += member->Requirements.size;
+			}
+
+			aliasedSize += group.Requirements.size;
+		}
+
+		HG_CORE_INFO("Render graph aliased {} transient images into {} allocations ({} MB instead of {} MB)", sorted.size(), groups.size(),
+			aliasedSize / (1024 * 1024), totalSize / (1024 * 1024));
+	}
+
+	void RenderGraph::Compile()
+	{
+		auto stages = GetStages();
+		std::unordered_map<Image*, Util::ResourceState> imageStates;
+		std::unordered_map<Buffer*, Util::ResourceState> bufferStates;
+		std::unordered_map<Image*, Image*> occupants;
+
+		for (auto& node : stages)
+		{
+			std::vector<Util::TrackedUsage<Image>> images;
+			std::vector<Util::TrackedUsage<Buffer>> buffers;
+			Util::CollectUsages(node->StageInfo, images, buffers);
+
+			node->Queue = Util::SelectQueue(node->StageInfo, images, buffers);
+		}
+
+		if (m_TransientAllocations.empty() && !m_TransientImages.empty())
+		{
+			AllocateTransientImages(stages);
+		}
+
+		// The first pass only establishes the state the previous frame leaves behind
+		for (int pass = 0; pass < 2; pass++)
+		{
+			// The previous frame's work is waited on as a whole when a queue starts the frame
+			for (auto& [image, state] : imageStates)
+			{
+				state.Writer = UINT32_MAX;
+				state.Readers.clear();
+			}
+
+			for (auto& [buffer, state] : bufferStates)
+			{
+				state.Writer = UINT32_MAX;
+				state.Readers.clear();
+			}
+
+			for (uint32_t i = 0; i < stages.size(); i++)
+			{
+				auto& node = stages[i];
+
+				std::vector<Util::TrackedUsage<Image>> images;
+				std::vector<Util::TrackedUsage<Buffer>> buffers;
+				Util::CollectUsages(node->StageInfo, images, buffers);
+
+				node->Barriers = {};
+				node->QueueWaits.clear();
+
+				for (const auto& [image, usage] : images)
+				{
+					// Aliased images share one hazard state since they share memory
+					auto group = m_AliasGroups.find(image.get());
+					Image* key = group != m_AliasGroups.end() ? group->second : image.get();
+					auto& state = imageStates[key];
+
+					bool discard = false;
+					if (group != m_AliasGroups.end())
+					{
+						auto& occupant = occupants[key];
+						if (occupant != image.get())
+						{
+							// The previous occupant's contents are dead, the new one starts from undefined
+							occupant = image.get();
+							state.Layout = ImageLayout::Undefined;
+							discard = true;
+						}
+					}
+
+					Util::TrackQueueHazard(state, usage.Write || state.Layout != usage.Layout, i, stages);
+
+					BarrierDescription barrier;
+					if (!Util::ResolveHazard(state, usage, true, barrier))
+					{
+						// Still recorded so images are moved out of whatever layout they start the first frame in
+						barrier = { PipelineStage::None, AccessFlag::None,
+							static_cast<PipelineStage>(usage.Stage), static_cast<AccessFlag>(usage.Access), usage.Layout, usage.Layout };
+					}
+
+					Util::RestrictToQueue(barrier, node->Queue);
+					node->Barriers.Images.push_back({ image, barrier, discard });
+				}
+
+				for (const auto& [buffer, usage] : buffers)
+				{
+					auto& state = bufferStates[buffer.get()];
+					Util::TrackQueueHazard(state, usage.Write, i, stages);
+
+					BarrierDescription barrier;
+					if (Util::ResolveHazard(state, usage, false, barrier))
+					{
+						Util::RestrictToQueue(barrier, node->Queue);
+						node->Barriers.Buffers.push_back({ buffer, barrier });
+					}
+				}
+			}
+		}
 	}
 
 	bool RenderGraph::ContainsStageType(RendererStageType type) const
@@ -115,9 +707,14 @@ namespace Hog
 			toVisit.push(node);
 		}
 
+		std::unordered_set<Node*> visited;
 		while (!toVisit.empty())
 		{
 			Ref<Node> visiting = toVisit.front();
+			toVisit.pop();
+
+			if (!visited.insert(visiting.get()).second)
+				continue;
 
 			if (visiting->StageInfo.StageType == type)
 			{
@@ -128,8 +725,6 @@ namespace Hog
 			{
 				toVisit.push(child);
 			}
-
-			toVisit.pop();
 		}
 
 		return false;
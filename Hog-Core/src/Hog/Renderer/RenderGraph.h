@@ -3,6 +3,7 @@
 #include "Hog/Renderer/Types.h"
 #include "Hog/Renderer/Pipeline.h"
 #include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/UploadRing.h"
 #include "Hog/Renderer/Mesh.h"
 #include "Hog/Renderer/Texture.h"
 #include "Hog/Renderer/ShaderBindingTable.h"
@@ -10,6 +11,7 @@
 
 namespace Hog
 {
+	// Barrier is only consulted for Swapchain attachments, every other attachment is synchronized by RenderGraph::Compile
 	struct AttachmentElement
 	{
 		std::string Name;
@@ -149,21 +151,23 @@ namespace Hog
 		ResourceType Type;
 		ShaderType BindLocation;
 		Ref<Buffer> Buffer = nullptr;
+		Ref<DynamicBuffer> DynamicBuffer = nullptr;
 		Ref<Texture> Texture = nullptr;
 		Ref<Image> StorageImage = nullptr;
 		Ref<AccelerationStructure> TLAS = nullptr;
-		std::vector<Ref<Hog::Texture>> Textures;
 		uint32_t ConstantID = 0;
 		size_t ConstantSize = 0;
 		void* ConstantDataPointer = nullptr;
 		uint32_t Binding = 0;
 		uint32_t Set = 0;
-		uint32_t ArrayMaxCount = 0;
 		BarrierDescription Barrier;
 
 		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, Ref<Hog::Buffer> buffer, uint32_t set, uint32_t binding, BarrierDescription barrier = {})
 			: Name(name), Type(type), BindLocation(bindLocation), Buffer(buffer), Binding(binding), Set(set), Barrier(barrier) {}
 
+		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, Ref<Hog::DynamicBuffer> buffer, uint32_t set, uint32_t binding)
+			: Name(name), Type(type), BindLocation(bindLocation), DynamicBuffer(buffer), Binding(binding), Set(set) {}
+
 		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, Ref<Hog::Texture> texture, uint32_t set, uint32_t binding, BarrierDescription barrier = {})
 			: Name(name), Type(type), BindLocation(bindLocation), Texture(texture), Binding(binding), Set(set), Barrier(barrier) {}
 		
@@ -173,9 +177,6 @@ namespace Hog
 		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, Ref<Hog::AccelerationStructure> tlas, uint32_t set, uint32_t binding, BarrierDescription barrier = {})
 			: Name(name), Type(type), BindLocation(bindLocation), TLAS(tlas), Binding(binding), Set(set), Barrier(barrier) {}
 
-		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, const std::vector<Ref<Hog::Texture>>& textures, uint32_t set, uint32_t binding, uint32_t arrayMaxCount,  BarrierDescription barrier = {})
-			: Name(name), Type(type), BindLocation(bindLocation), Textures(textures), Binding(binding), Set(set), ArrayMaxCount(arrayMaxCount), Barrier(barrier) {}
-
 		ResourceElement(const std::string& name, ResourceType type, ShaderType bindLocation, uint32_t constantID, size_t constantSize, void* dataPointer)
 			: Name(name), Type(type), BindLocation(bindLocation), ConstantID(constantID), ConstantSize(constantSize), ConstantDataPointer(dataPointer) {}
 
@@ -216,12 +217,23 @@ namespace Hog
 		std::vector<Ref<Mesh>> Meshes;
 		AttachmentLayout Attachments;
 		glm::ivec3 GroupCounts = {0, 0, 0};
+		// Command buffer of a DrawList. Compute stages reset its draw count before they dispatch,
+		// graphics stages draw it with vkCmdDrawIndexedIndirectCount instead of looping over Meshes
 		Ref<Buffer> DispatchBuffer;
+		// View projection matrix at the start of this buffer, Meshes outside of its frustum are skipped while recording
+		Ref<Hog::DynamicBuffer> CullingViewProjection;
+		// Levels of detail drawn coarser than the culling view needs, for passes like shadows where detail is less visible
+		uint32_t LodBias = 0;
 		BarrierDescription BarrierDescription;
 		Ref<Hog::ShaderBindingTable> ShaderBindingTable;
+		// Compute stages may run on the async compute queue, overlapping graphics work they don't depend on.
+		// Every buffer and image they use has to be created with concurrent sharing, otherwise they stay on the graphics queue
+		bool AsyncCompute = false;
+		// Keeps the stage alive even when no presenting stage consumes its results, e.g. for CPU readback
+		bool Output = false;
 
-		StageDescription(const std::string& name, RendererStageType type, Ref<Hog::Pipeline> pipeline, std::initializer_list<ResourceElement> resources, glm::ivec3 groupCounts)
-			: Name(name), Pipeline(pipeline), StageType(type), Resources(resources), GroupCounts(groupCounts) {}
+		StageDescription(const std::string& name, RendererStageType type, Ref<Hog::Pipeline> pipeline, std::initializer_list<ResourceElement> resources, glm::ivec3 groupCounts, bool asyncCompute = false)
+			: Name(name), Pipeline(pipeline), StageType(type), Resources(resources), GroupCounts(groupCounts), AsyncCompute(asyncCompute) {}
 
 		StageDescription(const std::string& name, RendererStageType type, std::initializer_list<AttachmentElement> attachmentElements)
 			: Name(name), StageType(type), Attachments(attachmentElements) {}
@@ -239,6 +251,29 @@ namespace Hog
 		StageDescription() = default;
 	};
 
+	struct ImageTransition
+	{
+		Ref<Hog::Image> Image;
+		BarrierDescription Barrier;
+		// Set when the image takes over aliased memory from another transient image
+		bool Discard = false;
+	};
+
+	struct BufferTransition
+	{
+		Ref<Hog::Buffer> Buffer;
+		BarrierDescription Barrier;
+	};
+
+	// Synchronization inferred by RenderGraph::Compile, recorded as a single barrier before the stage
+	struct StageBarriers
+	{
+		std::vector<ImageTransition> Images;
+		std::vector<BufferTransition> Buffers;
+
+		bool Empty() const { return Images.empty() && Buffers.empty(); }
+	};
+
 	struct Node
 	{
 		static Ref<Node> Create(const std::vector<Ref<Node>>& parents, StageDescription stageInfo)
@@ -271,6 +306,12 @@ namespace Hog
 		std::vector<Ref<Node>> ChildList;
 		std::vector<WeakRef<Node>> ParentList;
 		StageDescription StageInfo;
+		StageBarriers Barriers;
+		QueueType Queue = QueueType::Graphics;
+		// Earlier stages on the other queue this stage has a resource hazard with, indices into the compiled stage order
+		std::vector<uint32_t> QueueWaits;
+		// Longest path from a starting point, stages on the same level don't depend on each other
+		uint32_t Level = 0;
 
 		Node(const StageDescription& stageInfo)
 			:StageInfo(stageInfo) {}
@@ -305,11 +346,41 @@ namespace Hog
 
 		Ref<Node> AddStage(Ref<Node> parent, const StageDescription& stageInfo);
 		Ref<Node> AddStage(const std::vector<Ref<Node>>& parents, const StageDescription& stageInfo);
-		std::vector<Ref<Node>> GetStages();
+		// Live stages in topological order grouped by level, cached until the graph changes
+		const std::vector<Ref<Node>>& GetStages();
 		std::vector<Ref<Node>> GetFinalStages();
 
+		// Transient images only live between their first and last use in a frame and may share memory with each other
+		Ref<Image> CreateTransientImage(ImageDescription description, uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		Ref<Image> CreateTransientImage(ImageDescription description, uint32_t levelCount, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		// Sized relative to the swapchain, e.g. 0.5 for half resolution targets, and resized along with it
+		Ref<Image> CreateTransientImage(ImageDescription description, uint32_t levelCount, float scale, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+		// Recreates the transient images for the current swapchain extent, their memory is aliased again by the next Compile.
+		// The GPU must no longer use them
+		void ResizeTransientImages();
+
+		// Derives the barriers and layout transitions of every stage from its attachments and resources
+		void Compile();
+
 		bool ContainsStageType(RendererStageType type) const;
 	private:
+		void Sort();
+		// Expects the queue of every stage to be selected already
+		void AllocateTransientImages(const std::vector<Ref<Node>>& stages);
+		void FreeTransientMemory();
+	private:
+		struct TransientImage
+		{
+			Ref<Hog::Image> Image;
+			// Fraction of the swapchain extent, 0 for images of a fixed size
+			float Scale = 0.0f;
+		};
+
 		std::vector<Ref<Node>> m_StartingPoints;
+		std::vector<Ref<Node>> m_Stages;
+		bool m_Dirty = true;
+		std::vector<TransientImage> m_TransientImages;
+		std::vector<VmaAllocation> m_TransientAllocations;
+		std::unordered_map<Image*, Image*> m_AliasGroups;
 	};
 }
\ No newline at end of file
@@ -4,25 +4,67 @@
 #include "Hog/Core/Application.h"
 #include "Hog/Renderer/GraphicsContext.h"
 #include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/BindlessHeap.h"
+#include "Hog/Renderer/UploadRing.h"
+#include "Hog/Renderer/StreamingUploader.h"
+#include "Hog/Renderer/GeometryArena.h"
+#include "Hog/Renderer/SceneBuffer.h"
+#include "Hog/Renderer/DrawList.h"
 #include "Hog/Utils/RendererUtils.h"
 #include "Hog/Core/CVars.h"
+#include "Hog/Core/ThreadPool.h"
 #include "Hog/ImGui/ImGuiLayer.h"
 
 AutoCVar_Int CVar_ImageMipLevels("renderer.enableMipMapping", "Enable mip mapping for textures", 0, CVarFlags::None);
+AutoCVar_Int CVar_RecordingThreads("renderer.recordingThreads", "Worker threads recording mesh stages into secondary command buffers, 0 records everything on the main thread", 0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_MaxFrameLatency("renderer.maxFrameLatency", "Frames the GPU may fall behind the CPU before recording waits, 0 only limits by renderer.frameCount", 0, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_DynamicRendering("renderer.enableDynamicRendering", "Render graphics stages with dynamic rendering instead of render pass and framebuffer objects", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_HeadlessReadback("renderer.headlessReadback", "Copy every headless frame into host memory and hand it to the readback callback", 1, CVarFlags::EditReadOnly);
+AutoCVar_Int CVar_RecordingChunkSize("renderer.recordingChunkSize", "Meshes recorded per secondary command buffer", 256, CVarFlags::EditReadOnly);
+// Registered by Mesh.cpp, which builds the levels of detail it picks between
+extern AutoCVar_Float CVar_LodThreshold;
 
 namespace Hog
 {
+	// Consecutive stages recorded into one command buffer and submitted to the same queue
+	struct SubmitBatch
+	{
+		QueueType Queue = QueueType::Graphics;
+		std::vector<uint32_t> Stages;
+		// Batches of the other queue that have to finish before this one starts
+		std::vector<uint32_t> Waits;
+		bool Waited = false;
+	};
+
 	struct RendererData
 	{
 		RenderGraph Graph;
 		std::vector<RendererFrame> Frames;
 		std::vector<RendererStage> Stages;
+		std::vector<SubmitBatch> Batches;
+		std::array<uint32_t, static_cast<size_t>(QueueType::Count)> FirstBatch;
+		std::array<uint32_t, static_cast<size_t>(QueueType::Count)> LastBatch;
+		std::array<VkSemaphore, static_cast<size_t>(QueueType::Count)> Timelines = {};
+		std::array<uint64_t, static_cast<size_t>(QueueType::Count)> TimelineValues = {};
+		std::array<uint64_t, static_cast<size_t>(QueueType::Count)> PreviousFrameValues = {};
 		bool Present = false;
+		// Swapchain images are offscreen images, nothing is acquired or presented
+		bool Headless = false;
+		// Layout the graph leaves the swapchain image in at the end of a frame
+		ImageLayout SwapchainFinalLayout = ImageLayout::Undefined;
+		ReadbackCallbackFn ReadbackCallback;
+		uint64_t FrameCount = 0;
 		DescriptorLayoutCache DescriptorLayoutCache;
 		Ref<ImGuiLayer> ImGuiLayer;
+		ThreadPool Workers;
 
+		// Slot in the frames in flight ring, independent of which swapchain image gets acquired
 		uint32_t FrameIndex = 0;
+		uint32_t ImageIndex = 0;
 		uint32_t MaxFrameCount = 2;
+		// One per swapchain image, presentation keeps waiting on them after the frame slot is reused
+		std::vector<VkSemaphore> RenderSemaphores;
+		std::vector<Ref<FrameBuffer>> SwapchainFrameBuffers;
 
 		RendererFrame& GetCurrentFrame()
 		{
@@ -32,14 +74,266 @@ namespace Hog
 
 	static RendererData s_Data;
 
+	// Present layouts need VK_KHR_swapchain, headless frames end ready to be copied out instead
+	static ImageLayout SwapchainLayout(ImageLayout layout)
+	{
+		if (s_Data.Headless && layout == ImageLayout::PresentSrcKHR)
+			return ImageLayout::TransferSrcOptimal;
+
+		return layout;
+	}
+
+	static constexpr size_t GraphicsQueueIndex = static_cast<size_t>(QueueType::Graphics);
+	static constexpr size_t ComputeQueueIndex = static_cast<size_t>(QueueType::Compute);
+
+	// Splits the stages into per queue batches, a batch is cut wherever a stage waits on work from the other queue
+	static void BuildSubmitBatches(const std::vector<Ref<Node>>& nodes)
+	{
+		s_Data.Batches.clear();
+
+		std::vector<uint32_t> stageBatches(nodes.size());
+		std::array<uint32_t, static_cast<size_t>(QueueType::Count)> lastBatch;
+		lastBatch.fill(UINT32_MAX);
+
+		for (uint32_t i = 0; i < nodes.size(); i++)
+		{
+			QueueType queue = s_Data.Stages[i].Queue;
+
+			// Hazards rather than graph edges, a stage may touch what another queue wrote several stages up the graph
+			std::vector<uint32_t> waits;
+			for (auto stage : nodes[i]->QueueWaits)
+			{
+				HG_CORE_ASSERT(stage < i && s_Data.Stages[stage].Queue != queue, "Queue waits have to point at earlier stages of the other queue");
+
+				if (std::find(waits.begin(), waits.end(), stageBatches[stage]) == waits.end())
+				{
+					waits.push_back(stageBatches[stage]);
+				}
+			}
+
+			// Batches other work waits on are closed so the signal isn't delayed by stages added later
+			uint32_t& batchIndex = lastBatch[static_cast<size_t>(queue)];
+			bool reuse = batchIndex != UINT32_MAX && !s_Data.Batches[batchIndex].Waited &&
+				std::all_of(waits.begin(), waits.end(), [batchIndex](uint32_t wait)
+					{
+						const auto& batchWaits = s_Data.Batches[batchIndex].Waits;
+						return std::find(batchWaits.begin(), batchWaits.end(), wait) != batchWaits.end();
+					});
+
+			if (!reuse)
+			{
+				s_Data.Batches.push_back({ queue });
+				batchIndex = static_cast<uint32_t>(s_Data.Batches.size() - 1);
+			}
+
+			auto& batch = s_Data.Batches[batchIndex];
+			for (auto wait : waits)
+			{
+				if (std::find(batch.Waits.begin(), batch.Waits.end(), wait) != batch.Waits.end())
+					continue;
+
+				batch.Waits.push_back(wait);
+				s_Data.Batches[wait].Waited = true;
+			}
+
+			batch.Stages.push_back(i);
+			stageBatches[i] = batchIndex;
+		}
+
+		// The frame fence and the present semaphore are signaled by graphics work
+		if (lastBatch[GraphicsQueueIndex] == UINT32_MAX)
+		{
+			SubmitBatch batch = { QueueType::Graphics };
+			if (!s_Data.Batches.empty())
+			{
+				batch.Waits.push_back(static_cast<uint32_t>(s_Data.Batches.size() - 1));
+				s_Data.Batches.back().Waited = true;
+			}
+
+			s_Data.Batches.push_back(batch);
+		}
+
+		s_Data.FirstBatch.fill(UINT32_MAX);
+		s_Data.LastBatch.fill(UINT32_MAX);
+		for (uint32_t i = 0; i < s_Data.Batches.size(); i++)
+		{
+			size_t queue = static_cast<size_t>(s_Data.Batches[i].Queue);
+			if (s_Data.FirstBatch[queue] == UINT32_MAX)
+			{
+				s_Data.FirstBatch[queue] = i;
+			}
+
+			s_Data.LastBatch[queue] = i;
+		}
+
+		if (s_Data.FirstBatch[ComputeQueueIndex] != UINT32_MAX)
+		{
+			HG_CORE_INFO("Render graph submits {} batches, async compute overlaps graphics work", s_Data.Batches.size());
+		}
+	}
+
+	// Copies the final image into the frame's readback buffer and makes the copy visible to the host
+	static void RecordReadback(RendererFrame& frame, VkCommandBuffer commandBuffer)
+	{
+		HG_PROFILE_GPU_EVENT("Readback");
+
+		frame.SwapchainImage->ExecuteBarrier(commandBuffer, {
+			PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
+			PipelineStage::Transfer, AccessFlag::TransferRead,
+			s_Data.SwapchainFinalLayout, ImageLayout::TransferSrcOptimal
+		});
+
+		VkExtent2D extent = frame.SwapchainImage->GetExtent();
+		VkBufferImageCopy region = {
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.layerCount = 1,
+			},
+			.imageExtent = { extent.width, extent.height, 1 },
+		};
+
+		vkCmdCopyImageToBuffer(commandBuffer, frame.SwapchainImage->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.ReadbackBuffer->GetHandle(), 1, &region);
+
+		VkBufferMemoryBarrier2 bufferBarrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+			.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = frame.ReadbackBuffer->GetHandle(),
+			.size = VK_WHOLE_SIZE,
+		};
+
+		VkDependencyInfo dependencyInfo = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = 1,
+			.pBufferMemoryBarriers = &bufferBarrier,
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+		frame.ReadbackFrame = s_Data.FrameCount;
+		frame.ReadbackPending = true;
+	}
+
+	// Only called once the frame's fence signaled, so the copy has landed
+	static void DeliverReadback(RendererFrame& frame)
+	{
+		if (!frame.ReadbackPending)
+			return;
+
+		frame.ReadbackPending = false;
+		if (!s_Data.ReadbackCallback)
+			return;
+
+		frame.ReadbackBuffer->Invalidate();
+
+		VkExtent2D extent = frame.SwapchainImage->GetExtent();
+		s_Data.ReadbackCallback({
+			.Data = static_cast<void*>(*frame.ReadbackBuffer),
+			.Size = frame.ReadbackBuffer->GetSize(),
+			.Extent = extent,
+			.Format = frame.SwapchainImage->GetFormat(),
+			.Frame = frame.ReadbackFrame,
+		});
+	}
+
+	// Records a batch, mesh stages are split into chunks recorded on the worker threads and stitched back in graph order
+	static void RecordBatch(RendererFrame& frame, const SubmitBatch& batch, VkCommandBuffer commandBuffer)
+	{
+		HG_PROFILE_FUNCTION();
+
+		DescriptorAllocator* allocator = &s_Data.GetCurrentFrame().DescriptorAllocator;
+
+		if (s_Data.Workers.GetWorkerCount() == 1)
+		{
+			for (auto stage : batch.Stages)
+			{
+				s_Data.Stages[stage].Prepare(allocator);
+				s_Data.Stages[stage].Execute(commandBuffer);
+			}
+
+			return;
+		}
+
+		struct RecordJob
+		{
+			RendererStage* Stage;
+			uint32_t FirstMesh;
+			uint32_t MeshCount;
+			VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		};
+
+		uint32_t chunkSize = std::max(static_cast<uint32_t>(CVar_RecordingChunkSize.Get()), 1u);
+		std::vector<RecordJob> jobs;
+		std::vector<std::pair<size_t, size_t>> stageJobs(batch.Stages.size());
+
+		// Layouts and descriptor sets depend on the stages before, so preparation stays serial
+		for (size_t i = 0; i < batch.Stages.size(); i++)
+		{
+			auto& stage = s_Data.Stages[batch.Stages[i]];
+			stage.Prepare(allocator);
+
+			stageJobs[i].first = jobs.size();
+			if (stage.RecordsInParallel())
+			{
+				uint32_t meshCount = static_cast<uint32_t>(stage.Info.Meshes.size());
+				for (uint32_t first = 0; first < meshCount; first += chunkSize)
+				{
+					jobs.push_back({ &stage, first, std::min(chunkSize, meshCount - first) });
+				}
+			}
+			stageJobs[i].second = jobs.size();
+		}
+
+		s_Data.Workers.Execute(static_cast<uint32_t>(jobs.size()), [&jobs, &frame](uint32_t job, uint32_t worker)
+			{
+				auto& recordJob = jobs[job];
+				recordJob.CommandBuffer = frame.AcquireSecondaryCommandBuffer(worker);
+				recordJob.Stage->RecordChunk(recordJob.CommandBuffer, recordJob.FirstMesh, recordJob.MeshCount);
+			});
+
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		for (size_t i = 0; i < batch.Stages.size(); i++)
+		{
+			auto& stage = s_Data.Stages[batch.Stages[i]];
+			auto [first, last] = stageJobs[i];
+
+			if (first == last)
+			{
+				stage.Execute(commandBuffer);
+				continue;
+			}
+
+			secondaryCommandBuffers.clear();
+			for (size_t job = first; job < last; job++)
+			{
+				secondaryCommandBuffers.push_back(jobs[job].CommandBuffer);
+			}
+
+			stage.ExecuteSecondary(commandBuffer, secondaryCommandBuffers);
+		}
+	}
+
 	void Renderer::Initialize(RenderGraph renderGraph)
 	{
 		s_Data.MaxFrameCount = *CVarSystem::Get()->GetIntCVar("renderer.frameCount");
+		s_Data.Headless = GraphicsContext::IsHeadless();
+
+		if (CVar_RecordingThreads.Get() > 0)
+		{
+			s_Data.Workers.Init(static_cast<uint32_t>(CVar_RecordingThreads.Get()));
+		}
 
 		s_Data.Graph = renderGraph;
 
 		s_Data.DescriptorLayoutCache.Init(GraphicsContext::GetDevice());
+		UploadRing::Initialize(s_Data.MaxFrameCount);
+		StreamingUploader::Initialize();
 
+		s_Data.Graph.Compile();
 		auto stages = s_Data.Graph.GetStages();
 		s_Data.Stages.resize(stages.size());
 
@@ -49,13 +343,24 @@ namespace Hog
 		{
 			auto& stage = s_Data.Stages[i];
 			stage.Info = stages[i]->StageInfo;
+			stage.Barriers = stages[i]->Barriers;
+			stage.Queue = stages[i]->Queue;
 
 			stage.Init();
 
+			for (const auto& attachment : stage.Info.Attachments)
+			{
+				if (attachment.Type == AttachmentType::Swapchain)
+				{
+					s_Data.SwapchainFinalLayout = SwapchainLayout(attachment.Barrier.NewLayout);
+				}
+			}
+
 			switch (stage.Info.StageType)
 			{
 				case RendererStageType::ImGui:
 				{
+					HG_CORE_ASSERT(!s_Data.Headless, "ImGui stages need a window, remove them from headless render graphs");
 					s_Data.ImGuiLayer = CreateRef<ImGuiLayer>(stage.RenderPass);
 					Application::Get().SetImGuiLayer(s_Data.ImGuiLayer);
 					s_Data.Present = true;
@@ -81,19 +386,63 @@ namespace Hog
 			}
 		}
 
+		// The extent a culling stage picks levels of detail for is the one its commands are drawn at
+		for (auto& stage : s_Data.Stages)
+		{
+			if (stage.Info.StageType != RendererStageType::ForwardCompute || !stage.Info.DispatchBuffer)
+				continue;
+
+			for (auto& drawStage : s_Data.Stages)
+			{
+				if (drawStage.Info.StageType != RendererStageType::ForwardCompute && drawStage.Info.DispatchBuffer == stage.Info.DispatchBuffer)
+				{
+					stage.DrawStage = &drawStage;
+					break;
+				}
+			}
+		}
+
+		BuildSubmitBatches(stages);
+
+		for (auto& timeline : s_Data.Timelines)
+		{
+			timeline = GraphicsContext::CreateTimelineSemaphore();
+		}
+
 		s_Data.Frames.resize(s_Data.MaxFrameCount);
+		for (int i = 0; i < s_Data.Frames.size(); ++i)
+		{
+			s_Data.Frames[i].Init();
+		}
+
 		if (s_Data.Present)
 		{
-			for (int i = 0; i < s_Data.Frames.size(); ++i)
+			for (const auto& swapchainImage : GraphicsContext::GetSwapchainImages())
 			{
-				s_Data.Frames[i].Init(GraphicsContext::GetSwapchainImages()[i], blitRenderPass);
+				if (!s_Data.Headless)
+				{
+					s_Data.RenderSemaphores.push_back(GraphicsContext::CreateVkSemaphore());
+				}
+
+				// Dynamic rendering binds the swapchain view directly
+				if (blitRenderPass != VK_NULL_HANDLE)
+				{
+					std::vector<Ref<Image>> attachments(1);
+					attachments[0] = swapchainImage;
+					s_Data.SwapchainFrameBuffers.push_back(FrameBuffer::Create(attachments, blitRenderPass));
+				}
 			}
 		}
-		else
+
+		if (s_Data.Headless && s_Data.Present && CVar_HeadlessReadback.Get() && s_Data.SwapchainFinalLayout != ImageLayout::Undefined)
 		{
-			for (int i = 0; i < s_Data.Frames.size(); ++i)
+			VkExtent2D extent = GraphicsContext::GetExtent();
+			uint32_t texelSize = DataType(GraphicsContext::GetSwapchainFormat()).TypeSize();
+			HG_CORE_ASSERT(texelSize, "Readback does not support the swapchain format!");
+			size_t size = static_cast<size_t>(extent.width) * extent.height * texelSize;
+			for (auto& frame : s_Data.Frames)
 			{
-				s_Data.Frames[i].Init();
+				frame.ReadbackBuffer = Buffer::Create(BufferDescription::Defaults::ReadbackStorageBuffer, size);
 			}
 		}
 	}
@@ -106,23 +455,124 @@ namespace Hog
 
 		currentFrame.BeginFrame();
 
-		for (auto& stage : s_Data.Stages)
+		for (uint32_t i = 0; i < s_Data.Batches.size(); i++)
 		{
-			stage.Execute(currentFrame.CommandBuffer);
+			VkCommandBuffer commandBuffer = currentFrame.BeginBatch(i);
+
+			RecordBatch(currentFrame, s_Data.Batches[i], commandBuffer);
+			UploadRing::Flush();
+
+			if (currentFrame.ReadbackBuffer && i == s_Data.LastBatch[GraphicsQueueIndex])
+			{
+				RecordReadback(currentFrame, commandBuffer);
+			}
+
+			currentFrame.SubmitBatch(i);
 		}
 
 		currentFrame.EndFrame();
 
+		s_Data.FrameCount++;
+		BindlessHeap::NextFrame();
+		GeometryArena::NextFrame();
+		SceneBuffer::NextFrame();
 		s_Data.FrameIndex = (s_Data.FrameIndex + 1) % s_Data.MaxFrameCount;
 	}
 
+	void Renderer::Resize()
+	{
+		HG_PROFILE_FUNCTION();
+
+		// Waits for the device first, so none of the images recreated below are still in use
+		GraphicsContext::RecreateSwapChain();
+
+		s_Data.Graph.ResizeTransientImages();
+		s_Data.Graph.Compile();
+
+		auto stages = s_Data.Graph.GetStages();
+		VkRenderPass blitRenderPass = VK_NULL_HANDLE;
+		for (int i = 0; i < s_Data.Stages.size(); ++i)
+		{
+			auto& stage = s_Data.Stages[i];
+			stage.Barriers = stages[i]->Barriers;
+			stage.CreateFrameBuffer();
+
+			if (stage.Info.StageType == RendererStageType::Blit)
+			{
+				blitRenderPass = stage.RenderPass;
+			}
+		}
+
+		for (auto& frame : s_Data.Frames)
+		{
+			frame.Swapchain = GraphicsContext::GetSwapchain();
+		}
+
+		if (!s_Data.Present || s_Data.Headless)
+			return;
+
+		// The new swapchain may come with a different number of images
+		for (auto semaphore : s_Data.RenderSemaphores)
+		{
+			vkDestroySemaphore(GraphicsContext::GetDevice(), semaphore, nullptr);
+		}
+		s_Data.RenderSemaphores.clear();
+		s_Data.SwapchainFrameBuffers.clear();
+
+		for (const auto& swapchainImage : GraphicsContext::GetSwapchainImages())
+		{
+			s_Data.RenderSemaphores.push_back(GraphicsContext::CreateVkSemaphore());
+
+			if (blitRenderPass != VK_NULL_HANDLE)
+			{
+				std::vector<Ref<Image>> attachments(1);
+				attachments[0] = swapchainImage;
+				s_Data.SwapchainFrameBuffers.push_back(FrameBuffer::Create(attachments, blitRenderPass));
+			}
+		}
+	}
+
 	void Renderer::Cleanup()
 	{
+		s_Data.Workers.Shutdown();
+
+		// Hand out the frames still in flight, oldest first
+		for (uint32_t i = 0; i < s_Data.Frames.size(); i++)
+		{
+			auto& frame = s_Data.Frames[(s_Data.FrameIndex + i) % s_Data.Frames.size()];
+			if (frame.ReadbackPending)
+			{
+				CheckVkResult(vkWaitForFences(frame.Device, 1, &frame.Fence, VK_TRUE, UINT64_MAX));
+				DeliverReadback(frame);
+			}
+		}
+
 		std::for_each(s_Data.Frames.begin(), s_Data.Frames.end(), [](RendererFrame& elem) {elem.Cleanup(); });
 		s_Data.Frames.clear();
+		for (auto semaphore : s_Data.RenderSemaphores)
+		{
+			vkDestroySemaphore(GraphicsContext::GetDevice(), semaphore, nullptr);
+		}
+		s_Data.RenderSemaphores.clear();
+		s_Data.SwapchainFrameBuffers.clear();
 		std::for_each(s_Data.Stages.begin(), s_Data.Stages.end(), [](RendererStage& elem) {elem.Cleanup(); });
 		s_Data.Stages.clear();
+		s_Data.Batches.clear();
+		for (auto& timeline : s_Data.Timelines)
+		{
+			vkDestroySemaphore(GraphicsContext::GetDevice(), timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+		s_Data.TimelineValues = {};
+		s_Data.PreviousFrameValues = {};
+		s_Data.SwapchainFinalLayout = ImageLayout::Undefined;
+		s_Data.FrameCount = 0;
 		s_Data.DescriptorLayoutCache.Cleanup();
+		UploadRing::Deinitialize();
+		StreamingUploader::Deinitialize();
+		BindlessHeap::Deinitialize();
+		GeometryArena::Deinitialize();
+		SceneBuffer::Deinitialize();
 		s_Data.Graph.Cleanup();
 		
 		Application::Get().PopOverlay(s_Data.ImGuiLayer);
@@ -136,37 +586,46 @@ namespace Hog
 
 	Renderer::RendererStats Renderer::GetStats()
 	{
-		return RendererStats();
+		return { .FrameCount = s_Data.FrameCount };
 	}
 
-	void RendererFrame::Init()
+	void Renderer::SetReadbackCallback(ReadbackCallbackFn callback)
 	{
-		Device = GraphicsContext::GetDevice();
-		Queue = GraphicsContext::GetQueue();
-		Swapchain = GraphicsContext::GetSwapchain();
-		CommandPool = GraphicsContext::CreateCommandPool();
-		CommandBuffer = GraphicsContext::CreateCommandBuffer(CommandPool);
-		Fence = GraphicsContext::CreateFence(true);
-		PresentSemaphore = GraphicsContext::CreateVkSemaphore();
-		RenderSemaphore = GraphicsContext::CreateVkSemaphore();
-		DescriptorAllocator.Init(Device);
+		s_Data.ReadbackCallback = callback;
 	}
 
-	void RendererFrame::Init(Ref<Image> swapchainImage, VkRenderPass renderPass)
+	void RendererFrame::Init()
 	{
 		Device = GraphicsContext::GetDevice();
 		Queue = GraphicsContext::GetQueue();
+		ComputeQueue = GraphicsContext::GetComputeQueue();
 		Swapchain = GraphicsContext::GetSwapchain();
 		CommandPool = GraphicsContext::CreateCommandPool();
-		CommandBuffer = GraphicsContext::CreateCommandBuffer(CommandPool);
+		if (s_Data.FirstBatch[ComputeQueueIndex] != UINT32_MAX)
+		{
+			ComputeCommandPool = GraphicsContext::CreateCommandPool(GraphicsContext::GetComputeQueueFamily());
+		}
+
+		CommandBuffers.resize(s_Data.Batches.size());
+		BatchValues.resize(s_Data.Batches.size());
+		for (int i = 0; i < CommandBuffers.size(); ++i)
+		{
+			CommandBuffers[i] = GraphicsContext::CreateCommandBuffer(s_Data.Batches[i].Queue == QueueType::Compute ? ComputeCommandPool : CommandPool);
+		}
+
+		// The main thread records as the last worker, so it gets a pool of its own as well
+		if (s_Data.Workers.GetWorkerCount() > 1)
+		{
+			Workers.resize(s_Data.Workers.GetWorkerCount());
+			for (auto& worker : Workers)
+			{
+				worker.CommandPool = GraphicsContext::CreateCommandPool();
+			}
+		}
+
 		Fence = GraphicsContext::CreateFence(true);
 		PresentSemaphore = GraphicsContext::CreateVkSemaphore();
-		RenderSemaphore = GraphicsContext::CreateVkSemaphore();
 		DescriptorAllocator.Init(Device);
-		SwapchainImage = swapchainImage;
-		std::vector<Ref<Image>> attachments(1);
-		attachments[0] = SwapchainImage;
-		FrameBuffer = FrameBuffer::Create(attachments, renderPass);
 	}
 
 	void RendererFrame::BeginFrame()
@@ -174,59 +633,210 @@ namespace Hog
 		CheckVkResult(vkWaitForFences(Device, 1, &Fence, VK_TRUE, UINT64_MAX));
 		vkResetFences(Device, 1, &Fence);
 
-		DescriptorAllocator.ResetPools();
+		DeliverReadback(*this);
+		UploadRing::BeginFrame(s_Data.FrameIndex);
+
+		// The fence only covers the graphics queue
+		if (ComputeValue > 0)
+		{
+			VkSemaphoreWaitInfo waitInfo = {
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+				.semaphoreCount = 1,
+				.pSemaphores = &s_Data.Timelines[ComputeQueueIndex],
+				.pValues = &ComputeValue,
+			};
+
+			CheckVkResult(vkWaitSemaphores(Device, &waitInfo, UINT64_MAX));
+		}
+
+		// The frame submitted maxFrameLatency frames ago has to finish, even if the ring would allow more frames in flight
+		uint32_t latency = static_cast<uint32_t>(CVar_MaxFrameLatency.Get());
+		if (latency > 0 && latency < s_Data.MaxFrameCount)
+		{
+			const auto& previousFrame = s_Data.Frames[(s_Data.FrameIndex + s_Data.MaxFrameCount - latency) % s_Data.MaxFrameCount];
+			if (previousFrame.GraphicsValue > 0)
+			{
+				VkSemaphoreWaitInfo waitInfo = {
+					.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+					.semaphoreCount = 1,
+					.pSemaphores = &s_Data.Timelines[GraphicsQueueIndex],
+					.pValues = &previousFrame.GraphicsValue,
+				};
+
+				HG_PROFILE_SCOPE("Frame latency wait");
+				CheckVkResult(vkWaitSemaphores(Device, &waitInfo, UINT64_MAX));
+			}
+		}
+
+		for (auto& worker : Workers)
+		{
+			CheckVkResult(vkResetCommandPool(Device, worker.CommandPool, 0));
+			worker.Used = 0;
+		}
 
-		vkAcquireNextImageKHR(Device, Swapchain, UINT64_MAX, PresentSemaphore, VK_NULL_HANDLE, &s_Data.FrameIndex);
+		if (s_Data.Present)
+		{
+			// Headless creates one offscreen image per frame in flight
+			if (s_Data.Headless)
+			{
+				s_Data.ImageIndex = s_Data.FrameIndex;
+			}
+			else
+			{
+				vkAcquireNextImageKHR(Device, Swapchain, UINT64_MAX, PresentSemaphore, VK_NULL_HANDLE, &s_Data.ImageIndex);
+				RenderSemaphore = s_Data.RenderSemaphores[s_Data.ImageIndex];
+			}
+
+			SwapchainImage = GraphicsContext::GetSwapchainImages()[s_Data.ImageIndex];
+			FrameBuffer = s_Data.SwapchainFrameBuffers.empty() ? nullptr : s_Data.SwapchainFrameBuffers[s_Data.ImageIndex];
+		}
+
+		// Values are handed out up front since a wait may reference a batch that is submitted later
+		s_Data.PreviousFrameValues = s_Data.TimelineValues;
+		for (uint32_t i = 0; i < s_Data.Batches.size(); i++)
+		{
+			BatchValues[i] = ++s_Data.TimelineValues[static_cast<size_t>(s_Data.Batches[i].Queue)];
+		}
+
+		ComputeValue = s_Data.LastBatch[ComputeQueueIndex] != UINT32_MAX ? BatchValues[s_Data.LastBatch[ComputeQueueIndex]] : 0;
+		GraphicsValue = BatchValues[s_Data.LastBatch[GraphicsQueueIndex]];
+	}
+
+	VkCommandBuffer RendererFrame::BeginBatch(uint32_t batch)
+	{
+		VkCommandBuffer commandBuffer = CommandBuffers[batch];
 
 		// begin command buffer
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-		CheckVkResult(vkBeginCommandBuffer(CommandBuffer, &beginInfo));
-		HG_PROFILE_GPU_CONTEXT(currentFrame.CommandBuffer);
+		CheckVkResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		HG_PROFILE_GPU_CONTEXT(commandBuffer);
 		HG_PROFILE_GPU_EVENT("Begin CommandBuffer");
 
-		if (SwapchainImage)
+		// Streamed uploads finished since the last frame and changed scene instances become visible to every stage of this one
+		if (batch == s_Data.FirstBatch[GraphicsQueueIndex])
+		{
+			StreamingValue = StreamingUploader::RecordAcquires(commandBuffer);
+			SceneBuffer::RecordUpdates(commandBuffer);
+		}
+
+		if (SwapchainImage && batch == s_Data.FirstBatch[GraphicsQueueIndex])
 		{
-			SwapchainImage->ExecuteBarrier(CommandBuffer, {ImageLayout::Undefined, ImageLayout::ColorAttachmentOptimal});
+			SwapchainImage->ExecuteBarrier(commandBuffer, {
+				PipelineStage::ColorAttachmentOutput, AccessFlag::None,
+				PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
+				ImageLayout::Undefined, ImageLayout::ColorAttachmentOptimal
+			});
 		}
+
+		return commandBuffer;
 	}
 
-	void RendererFrame::EndFrame()
+	void RendererFrame::SubmitBatch(uint32_t batch)
 	{
+		const auto& submitBatch = s_Data.Batches[batch];
+		size_t queue = static_cast<size_t>(submitBatch.Queue);
+		size_t otherQueue = queue == GraphicsQueueIndex ? ComputeQueueIndex : GraphicsQueueIndex;
+
 		// end command buffer
-		CheckVkResult(vkEndCommandBuffer(CommandBuffer));
+		CheckVkResult(vkEndCommandBuffer(CommandBuffers[batch]));
 
 		// Submit
 		const VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-			.commandBuffer = CommandBuffer,
+			.commandBuffer = CommandBuffers[batch],
 		};
 
-		const VkSemaphoreSubmitInfo waitSemaphoreInfo = {
-			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-			.semaphore = PresentSemaphore,
-		};
+		std::vector<VkSemaphoreSubmitInfo> waitSemaphoreInfos;
+		std::vector<VkSemaphoreSubmitInfo> signalSemaphoreInfos;
 
-		const VkSemaphoreSubmitInfo signalSemaphoreInfo = {
+		for (auto wait : submitBatch.Waits)
+		{
+			waitSemaphoreInfos.push_back({
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = s_Data.Timelines[otherQueue],
+				.value = BatchValues[wait],
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			});
+		}
+
+		// The other queue may still be working on the previous frame's resources
+		if (batch == s_Data.FirstBatch[queue] && s_Data.PreviousFrameValues[otherQueue] > 0)
+		{
+			waitSemaphoreInfos.push_back({
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = s_Data.Timelines[otherQueue],
+				.value = s_Data.PreviousFrameValues[otherQueue],
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			});
+		}
+
+		if (StreamingValue > 0 && batch == s_Data.FirstBatch[GraphicsQueueIndex])
+		{
+			waitSemaphoreInfos.push_back({
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = StreamingUploader::GetTimeline(),
+				.value = StreamingValue,
+				.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			});
+		}
+
+		if (s_Data.Present && !s_Data.Headless && batch == s_Data.FirstBatch[GraphicsQueueIndex])
+		{
+			waitSemaphoreInfos.push_back({
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = PresentSemaphore,
+				.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			});
+		}
+
+		signalSemaphoreInfos.push_back({
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-			.semaphore = RenderSemaphore,
-		};
+			.semaphore = s_Data.Timelines[queue],
+			.value = BatchValues[batch],
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		});
+
+		bool lastGraphicsBatch = batch == s_Data.LastBatch[GraphicsQueueIndex];
+		if (s_Data.Present && !s_Data.Headless && lastGraphicsBatch)
+		{
+			signalSemaphoreInfos.push_back({
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+				.semaphore = RenderSemaphore,
+			});
+		}
 
 		const VkSubmitInfo2 submitInfo = {
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-			.waitSemaphoreInfoCount = 1,
-			.pWaitSemaphoreInfos = &waitSemaphoreInfo,
+			.waitSemaphoreInfoCount = static_cast<uint32_t>(waitSemaphoreInfos.size()),
+			.pWaitSemaphoreInfos = waitSemaphoreInfos.data(),
 			.commandBufferInfoCount = 1,
 			.pCommandBufferInfos = &commandBufferSubmitInfo,
-			.signalSemaphoreInfoCount = 1,
-			.pSignalSemaphoreInfos = &signalSemaphoreInfo,
+			.signalSemaphoreInfoCount = static_cast<uint32_t>(signalSemaphoreInfos.size()),
+			.pSignalSemaphoreInfos = signalSemaphoreInfos.data(),
 		};
 
-		CheckVkResult(vkQueueSubmit2(Queue, 1, &submitInfo, Fence));
+		std::lock_guard lock(GraphicsContext::GetQueueMutex());
+		CheckVkResult(vkQueueSubmit2(submitBatch.Queue == QueueType::Compute ? ComputeQueue : Queue, 1, &submitInfo, lastGraphicsBatch ? Fence : VK_NULL_HANDLE));
+	}
+
+	VkCommandBuffer RendererFrame::AcquireSecondaryCommandBuffer(uint32_t worker)
+	{
+		auto& workerCommandBuffers = Workers[worker];
+
+		if (workerCommandBuffers.Used == workerCommandBuffers.CommandBuffers.size())
+		{
+			workerCommandBuffers.CommandBuffers.push_back(GraphicsContext::CreateCommandBuffer(workerCommandBuffers.CommandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+		}
+
+		return workerCommandBuffers.CommandBuffers[workerCommandBuffers.Used++];
+	}
 
+	void RendererFrame::EndFrame()
+	{
 		// Present
-		if (s_Data.Present)
+		if (s_Data.Present && !s_Data.Headless)
 		{
 			VkPresentInfoKHR presentInfo{};
 			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -238,10 +848,11 @@ namespace Hog
 			presentInfo.swapchainCount = 1;
 			presentInfo.pSwapchains = swapChains;
 
-			presentInfo.pImageIndices = &s_Data.FrameIndex;
+			presentInfo.pImageIndices = &s_Data.ImageIndex;
 
 			HG_PROFILE_GPU_FLIP(Swapchain);
 
+			std::lock_guard lock(GraphicsContext::GetQueueMutex());
 			CheckVkResult(vkQueuePresentKHR(Queue, &presentInfo));
 		}
 	}
@@ -250,17 +861,42 @@ namespace Hog
 	{
 		vkDestroyFence(Device, Fence, nullptr);
 		vkDestroyCommandPool(Device, CommandPool, nullptr);
+		vkDestroyCommandPool(Device, ComputeCommandPool, nullptr);
+		for (auto& worker : Workers)
+		{
+			vkDestroyCommandPool(Device, worker.CommandPool, nullptr);
+		}
+		Workers.clear();
 		vkDestroySemaphore(Device, PresentSemaphore, nullptr);
-		vkDestroySemaphore(Device, RenderSemaphore, nullptr);
 		DescriptorAllocator.Cleanup();
 		FrameBuffer.reset();
+		SwapchainImage.reset();
+		ReadbackBuffer.reset();
+		ReadbackPending = false;
 	}
 
 	void RendererStage::Init()
 	{
-		if (Info.StageType == RendererStageType::DeferredGraphics || Info.StageType == RendererStageType::ForwardGraphics
+		DescriptorSets.resize(s_Data.MaxFrameCount);
+
+		// Mesh shaders decode the arena's vertices themselves and only know the full float layout
+		HG_CORE_ASSERT(!Info.Pipeline || !Info.Pipeline->HasMeshShader() || GeometryArena::GetVertexFormat() == VertexFormat::Full,
+			"Mesh shader stages need full float vertices, disable renderer.geometry.compactVertices");
+		HG_CORE_ASSERT(!Info.Pipeline || Info.Pipeline->GetVertexStream() != VertexStream::Position || GeometryArena::HasPositionStream(),
+			"Position stream stages need renderer.geometry.positionStream");
+
+		bool graphics = Info.StageType == RendererStageType::DeferredGraphics || Info.StageType == RendererStageType::ForwardGraphics
 			|| Info.StageType == RendererStageType::ImGui || Info.StageType == RendererStageType::Blit
-			|| Info.StageType == RendererStageType::ScreenSpacePass)
+			|| Info.StageType == RendererStageType::ScreenSpacePass;
+
+		// The ImGui backend is initialized against a render pass, so that stage keeps one
+		DynamicRendering = graphics && Info.StageType != RendererStageType::ImGui && CVar_DynamicRendering.Get();
+
+		if (DynamicRendering)
+		{
+			InitRendering();
+		}
+		else if (graphics)
 		{
 			std::vector<VkAttachmentDescription2> attachments(Info.Attachments.size());
 			std::unordered_map<AttachmentType, std::vector<VkAttachmentReference2>> attachmentRefs;
@@ -284,7 +920,7 @@ namespace Hog
 				}
 				attachments[i].loadOp = (Info.Attachments[i].Clear) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
 
-				if (Info.Attachments[i].Barrier.OldLayout == ImageLayout::Undefined)
+				if (Info.Attachments[i].Type == AttachmentType::Swapchain && Info.Attachments[i].Barrier.OldLayout == ImageLayout::Undefined)
 				{
 					attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 				}
@@ -295,9 +931,6 @@ namespace Hog
 					attachments[i].stencilLoadOp = (Info.Attachments[i].Clear) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
 					attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
 				}
-				attachments[i].initialLayout = static_cast<VkImageLayout>(Info.Attachments[i].Barrier.OldLayout);
-				attachments[i].finalLayout = static_cast<VkImageLayout>(Info.Attachments[i].Barrier.NewLayout);
-
 				VkAttachmentReference2 attachRef = {
 					.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 					.attachment = static_cast<uint32_t>(i),
@@ -314,22 +947,29 @@ namespace Hog
 				if (Info.Attachments[i].Type == AttachmentType::Swapchain)
 				{
 					attachmentRefs[AttachmentType::Color].push_back(attachRef);
+
+					attachments[i].initialLayout = static_cast<VkImageLayout>(Info.Attachments[i].Barrier.OldLayout);
+					attachments[i].finalLayout = static_cast<VkImageLayout>(SwapchainLayout(Info.Attachments[i].Barrier.NewLayout));
+
+					VkSubpassDependency2 dependency = {
+						.sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2,
+						.srcSubpass = VK_SUBPASS_EXTERNAL,
+						.srcStageMask = ToStageFlags1(static_cast<VkPipelineStageFlags2>(Info.Attachments[i].Barrier.SrcStage)),
+						.dstStageMask = ToStageFlags1(static_cast<VkPipelineStageFlags2>(Info.Attachments[i].Barrier.DstStage)),
+						.srcAccessMask = ToAccessFlags1(static_cast<VkAccessFlags2>(Info.Attachments[i].Barrier.SrcAccessMask)),
+						.dstAccessMask = ToAccessFlags1(static_cast<VkAccessFlags2>(Info.Attachments[i].Barrier.DstAccessMask)),
+					};
+
+					dependencies.push_back(dependency);
 				}
 				else
 				{
+					// Transitions into and out of the pass are issued by the stage barriers compiled from the graph
 					attachmentRefs[Info.Attachments[i].Type].push_back(attachRef);
-				}
-
-				VkSubpassDependency2 dependency = {
-					.sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2,
-					.srcSubpass = VK_SUBPASS_EXTERNAL,
-					.srcStageMask = ToStageFlags1(static_cast<VkPipelineStageFlags2>(Info.Attachments[i].Barrier.SrcStage)),
-					.dstStageMask = ToStageFlags1(static_cast<VkPipelineStageFlags2>(Info.Attachments[i].Barrier.DstStage)),
-					.srcAccessMask = ToAccessFlags1(static_cast<VkAccessFlags2>(Info.Attachments[i].Barrier.SrcAccessMask)),
-					.dstAccessMask = ToAccessFlags1(static_cast<VkAccessFlags2>(Info.Attachments[i].Barrier.DstAccessMask)),
-				};
 
-				dependencies.push_back(dependency);
+					attachments[i].initialLayout = attachRef.layout;
+					attachments[i].finalLayout = attachRef.layout;
+				}
 
 				if (Info.Attachments[i].Clear)
 				{
@@ -382,6 +1022,18 @@ namespace Hog
 
 		if (Info.Pipeline)
 		{
+			std::unordered_set<uint32_t> dynamicBindings;
+			for (const auto& resource : Info.Resources)
+			{
+				if (resource.Type == ResourceType::DynamicUniform || resource.Type == ResourceType::DynamicStorage)
+				{
+					HG_CORE_ASSERT(resource.Set == 0, "Dynamic buffers can only be bound in set 0");
+					dynamicBindings.insert(resource.Binding);
+				}
+			}
+
+			Info.Pipeline->SetDynamicBindings(dynamicBindings);
+
 			if (Info.Resources.ContainsType(ResourceType::Constant))
 			{
 				uint32_t offset = 0;
@@ -389,153 +1041,460 @@ namespace Hog
 
 				for (const auto& resource : Info.Resources)
 				{
-					if (resource.Type == ResourceType::Constant)
+					if (resource.Type == ResourceType::Constant)
+					{
+						specializationMapEntries.push_back({ resource.ConstantID, offset, resource.ConstantSize });
+						size += resource.ConstantSize;
+
+						buffer.resize(size);
+						std::memcpy(buffer.data() + offset, resource.ConstantDataPointer, resource.ConstantSize);
+
+						offset += (uint32_t)resource.ConstantSize;
+					}
+				}
+
+				specializationInfo.mapEntryCount = (uint32_t)specializationMapEntries.size();
+				specializationInfo.pMapEntries = specializationMapEntries.data();
+				specializationInfo.dataSize = size;
+				specializationInfo.pData = buffer.data();
+			}
+
+			if (DynamicRendering)
+			{
+				Info.Pipeline->Generate(m_RenderingFormats, &specializationInfo);
+			}
+			else if (RenderPass != VK_NULL_HANDLE)
+			{
+				uint32_t colorCount = 0;
+				std::for_each(Info.Attachments.begin(), Info.Attachments.end(), [&colorCount](AttachmentElement& attachment) 
+					{ 
+						colorCount += (attachment.Type == AttachmentType::Color || attachment.Type == AttachmentType::Swapchain) ? 1 : 0;
+					});
+
+				Info.Pipeline->Generate(RenderPass, &specializationInfo);
+			}
+			else
+			{
+				Info.Pipeline->Generate(nullptr, &specializationInfo);
+			}
+		}
+
+		if (Info.StageType == RendererStageType::RayTracing)
+		{
+			Info.ShaderBindingTable = ShaderBindingTable::Create(Info.Pipeline->GetHandle());
+		}
+
+		CreateFrameBuffer();
+	}
+
+	void RendererStage::CreateFrameBuffer()
+	{
+		if (Info.StageType == RendererStageType::Blit || RenderPass == VK_NULL_HANDLE)
+			return;
+
+		auto attachments = Info.Attachments.GetElements();
+		std::vector<Ref<Image>> fbAttachments(attachments.size());
+		for (int i = 0; i < attachments.size(); ++i)
+		{
+			fbAttachments[i] = attachments[i].Image;
+		}
+
+		FrameBuffer = FrameBuffer::Create(fbAttachments, RenderPass, fbAttachments[0]->GetExtent());
+	}
+
+	void RendererStage::Prepare(DescriptorAllocator* allocator)
+	{
+		PrepareBarriers();
+
+		if (Info.Pipeline)
+		{
+			PrepareResources(allocator);
+		}
+
+		if (Info.CullingViewProjection && !Info.Meshes.empty())
+		{
+			CullMeshes();
+		}
+	}
+
+	void RendererStage::Execute(VkCommandBuffer commandBuffer)
+	{
+		RecordBarriers(commandBuffer);
+
+		switch (Info.StageType)
+		{
+			case RendererStageType::Blit:
+			{
+				BlitStage(commandBuffer);
+			}break;
+			case RendererStageType::DeferredCompute:
+			case RendererStageType::ForwardCompute:
+			{
+				ForwardCompute(commandBuffer);
+			}break;
+			case RendererStageType::ImGui:
+			{
+				ImGui(commandBuffer);
+			}break;
+			case RendererStageType::ForwardGraphics:
+			case RendererStageType::DeferredGraphics:
+			case RendererStageType::ScreenSpacePass:
+			{
+				ForwardGraphics(commandBuffer);
+			}break;
+			case RendererStageType::RayTracing:
+			{
+				RayTracing(commandBuffer);
+			}break;
+			case RendererStageType::DepthPyramid:
+			{
+				DepthPyramid(commandBuffer);
+			}break;
+		}
+	}
+
+	void RendererStage::PrepareBarriers()
+	{
+		m_ImageBarriers.clear();
+		m_BufferBarriers.clear();
+
+		for (const auto& transition : Barriers.Images)
+		{
+			// The old layout is taken from the image so the first frame starts from its real layout
+			BarrierDescription description = transition.Barrier;
+			description.OldLayout = transition.Discard ? ImageLayout::Undefined : static_cast<ImageLayout>(transition.Image->GetImageLayout());
+
+			if (description.OldLayout == description.NewLayout && description.SrcStage == PipelineStage::None)
+				continue;
+
+			m_ImageBarriers.push_back(transition.Image->CreateBarrier(description));
+			transition.Image->SetImageLayout(static_cast<VkImageLayout>(description.NewLayout));
+		}
+
+		for (const auto& transition : Barriers.Buffers)
+		{
+			m_BufferBarriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = static_cast<VkPipelineStageFlags2>(transition.Barrier.SrcStage),
+				.srcAccessMask = static_cast<VkAccessFlags2>(transition.Barrier.SrcAccessMask),
+				.dstStageMask = static_cast<VkPipelineStageFlags2>(transition.Barrier.DstStage),
+				.dstAccessMask = static_cast<VkAccessFlags2>(transition.Barrier.DstAccessMask),
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = transition.Buffer->GetHandle(),
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			});
+		}
+	}
+
+	void RendererStage::RecordBarriers(VkCommandBuffer commandBuffer)
+	{
+		if (m_ImageBarriers.empty() && m_BufferBarriers.empty())
+			return;
+
+		VkDependencyInfo info = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = static_cast<uint32_t>(m_BufferBarriers.size()),
+			.pBufferMemoryBarriers = m_BufferBarriers.data(),
+			.imageMemoryBarrierCount = static_cast<uint32_t>(m_ImageBarriers.size()),
+			.pImageMemoryBarriers = m_ImageBarriers.data(),
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &info);
+	}
+
+	void RendererStage::Cleanup()
+	{
+		FrameBuffer.reset();
+		vkDestroyRenderPass(GraphicsContext::GetDevice(), RenderPass, nullptr);
+	}
+
+	void RendererStage::ForwardGraphics(VkCommandBuffer commandBuffer)
+	{
+		HG_PROFILE_GPU_EVENT("ForwardGraphics Pass");
+		HG_PROFILE_TAG("Name", Info.Name.c_str());
+
+		BeginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+		SetDynamicState(commandBuffer);
+
+		Info.Pipeline->Bind(commandBuffer);
+
+		BindResources(commandBuffer);
+
+		if (Info.StageType == RendererStageType::ScreenSpacePass)
+		{
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		}
+		else if (Info.Pipeline->HasMeshShader())
+		{
+			// Task shaders find their own work, e.g. the clusters of a ClusterList, and launch the mesh shader groups
+			vkCmdDrawMeshTasksEXT(commandBuffer, Info.GroupCounts.x, Info.GroupCounts.y, Info.GroupCounts.z);
+		}
+		else if (Info.DispatchBuffer)
+		{
+			// Draws whatever the culling pass left in the list, objects are found through gl_InstanceIndex
+			GeometryArena::Bind(commandBuffer, Info.Pipeline->GetVertexStream());
+
+			VkBuffer commands = Info.DispatchBuffer->GetHandle();
+			uint32_t maxDrawCount = DrawList::GetMaxDrawCount(Info.DispatchBuffer);
+			vkCmdDrawIndexedIndirectCount(commandBuffer, commands, DrawList::CommandOffset, commands, DrawList::CountOffset,
+				maxDrawCount, DrawList::CommandStride);
+
+			GeometryArena::BindIndices(commandBuffer, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexedIndirectCount(commandBuffer, commands, DrawList::GetWideCommandOffset(Info.DispatchBuffer), commands, DrawList::WideCountOffset,
+				maxDrawCount, DrawList::CommandStride);
+		}
+		else 
+		{
+			DrawMeshes(commandBuffer, 0, static_cast<uint32_t>(Info.Meshes.size()));
+		}
+
+		EndRenderPass(commandBuffer);
+	}
+
+	void RendererStage::ExecuteSecondary(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer>& secondaryCommandBuffers)
+	{
+		HG_PROFILE_GPU_EVENT("ForwardGraphics Pass");
+		HG_PROFILE_TAG("Name", Info.Name.c_str());
+
+		RecordBarriers(commandBuffer);
+
+		BeginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+
+		EndRenderPass(commandBuffer);
+	}
+
+	void RendererStage::RecordChunk(VkCommandBuffer commandBuffer, uint32_t firstMesh, uint32_t meshCount)
+	{
+		HG_PROFILE_FUNCTION();
+
+		VkCommandBufferInheritanceRenderingInfo renderingInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+			.colorAttachmentCount = static_cast<uint32_t>(m_RenderingFormats.Color.size()),
+			.pColorAttachmentFormats = m_RenderingFormats.Color.data(),
+			.depthAttachmentFormat = m_RenderingFormats.Depth,
+			.stencilAttachmentFormat = m_RenderingFormats.Stencil,
+			.rasterizationSamples = m_RenderingFormats.Samples,
+		};
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		};
+
+		if (DynamicRendering)
+		{
+			inheritanceInfo.pNext = &renderingInfo;
+		}
+		else
+		{
+			inheritanceInfo.renderPass = RenderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = static_cast<VkFramebuffer>(*FrameBuffer);
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+			.pInheritanceInfo = &inheritanceInfo,
+		};
+
+		CheckVkResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		// Secondary command buffers inherit no state from the primary
+		SetDynamicState(commandBuffer);
+
+		Info.Pipeline->Bind(commandBuffer);
+
+		BindResources(commandBuffer);
+
+		DrawMeshes(commandBuffer, firstMesh, meshCount);
+
+		CheckVkResult(vkEndCommandBuffer(commandBuffer));
+	}
+
+	bool RendererStage::RecordsInParallel() const
+	{
+		// Indirect and mesh shader draws are a single command, there is nothing to split across the workers
+		return s_Data.Workers.GetWorkerCount() > 1 && !Info.Meshes.empty() && !Info.DispatchBuffer && !Info.Pipeline->HasMeshShader() &&
+			(Info.StageType == RendererStageType::ForwardGraphics || Info.StageType == RendererStageType::DeferredGraphics);
+	}
+
+	void RendererStage::InitRendering()
+	{
+		m_RenderingFormats = {};
+		m_ColorAttachments.clear();
+		m_DepthAttachment = {};
+
+		for (const auto& attachment : Info.Attachments)
+		{
+			VkRenderingAttachmentInfo attachmentInfo = {
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.loadOp = attachment.Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			};
+
+			switch (attachment.Type)
+			{
+				case AttachmentType::Swapchain:
+				{
+					if (attachment.Barrier.OldLayout == ImageLayout::Undefined)
 					{
-						specializationMapEntries.push_back({ resource.ConstantID, offset, resource.ConstantSize });
-						size += resource.ConstantSize;
-
-						buffer.resize(size);
-						std::memcpy(buffer.data() + offset, resource.ConstantDataPointer, resource.ConstantSize);
-
-						offset += (uint32_t)resource.ConstantSize;
+						attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 					}
-				}
 
-				specializationInfo.mapEntryCount = (uint32_t)specializationMapEntries.size();
-				specializationInfo.pMapEntries = specializationMapEntries.data();
-				specializationInfo.dataSize = size;
-				specializationInfo.pData = buffer.data();
-			}
+					attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					attachmentInfo.clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					m_RenderingFormats.Color.push_back(GraphicsContext::GetSwapchainFormat());
+					m_ColorAttachments.push_back(attachmentInfo);
+				}break;
 
-			if (RenderPass != VK_NULL_HANDLE)
-			{
-				uint32_t colorCount = 0;
-				std::for_each(Info.Attachments.begin(), Info.Attachments.end(), [&colorCount](AttachmentElement& attachment) 
-					{ 
-						colorCount += (attachment.Type == AttachmentType::Color || attachment.Type == AttachmentType::Swapchain) ? 1 : 0;
-					});
+				case AttachmentType::Color:
+				{
+					attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					attachmentInfo.clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					m_RenderingFormats.Color.push_back(attachment.Image->GetFormat());
+					m_RenderingFormats.Samples = attachment.Image->GetSamples();
+					m_ColorAttachments.push_back(attachmentInfo);
+				}break;
 
-				Info.Pipeline->Generate(RenderPass, &specializationInfo);
-			}
-			else
-			{
-				Info.Pipeline->Generate(nullptr, &specializationInfo);
+				case AttachmentType::Depth:
+				case AttachmentType::DepthStencil:
+				{
+					attachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+					attachmentInfo.clearValue.depthStencil.depth = 1.f;
+					m_RenderingFormats.Depth = attachment.Image->GetFormat();
+					m_RenderingFormats.Samples = attachment.Image->GetSamples();
+					if (attachment.Type == AttachmentType::DepthStencil)
+					{
+						m_RenderingFormats.Stencil = attachment.Image->GetFormat();
+					}
+					m_DepthAttachment = attachmentInfo;
+				}break;
 			}
 		}
+	}
 
-		if (Info.StageType == RendererStageType::RayTracing)
+	void RendererStage::BeginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		if (!DynamicRendering)
 		{
-			Info.ShaderBindingTable = ShaderBindingTable::Create(Info.Pipeline->GetHandle());
-		}
+			Ref<Hog::FrameBuffer> frameBuffer = (Info.StageType == RendererStageType::Blit) ? s_Data.GetCurrentFrame().FrameBuffer : FrameBuffer;
+
+			VkRenderPassBeginInfo renderPassBeginInfo = {
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = RenderPass,
+				.framebuffer = static_cast<VkFramebuffer>(*frameBuffer),
+				.renderArea = {
+					.extent = frameBuffer->GetExtent()
+				},
+				.clearValueCount = static_cast<uint32_t>(ClearValues.size()),
+				.pClearValues = ClearValues.data(),
+			};
 
-		if (Info.StageType != RendererStageType::Blit && RenderPass != VK_NULL_HANDLE)
-		{
-			auto attachments = Info.Attachments.GetElements();
-			std::vector<Ref<Image>> fbAttachments(attachments.size());
-			for (int i = 0; i < attachments.size(); ++i)
-			{
-				fbAttachments[i] = attachments[i].Image;
-			}
+			VkSubpassBeginInfo subpassBeginInfo = {
+				.sType = VK_STRUCTURE_TYPE_SUBPASS_BEGIN_INFO,
+				.contents = contents,
+			};
 
-			FrameBuffer = FrameBuffer::Create(fbAttachments, RenderPass, fbAttachments[0]->GetExtent());
+			vkCmdBeginRenderPass2(commandBuffer, &renderPassBeginInfo, &subpassBeginInfo);
+			return;
 		}
-	}
 
-	void RendererStage::Execute(VkCommandBuffer commandBuffer)
-	{
-		/*for (const auto& resource : stage.Info.Resources)
+		// Views are resolved on every begin so swapped or resized attachments need no rebuild
+		RendererFrame& currentFrame = s_Data.GetCurrentFrame();
+		auto colorAttachment = m_ColorAttachments.begin();
+		for (const auto& attachment : Info.Attachments)
 		{
-			if (resource.Barrier)
+			switch (attachment.Type)
 			{
-				if (resource.StorageImage)
+				case AttachmentType::Swapchain:
 				{
-					resource.StorageImage->ExecuteBarrier(currentFrame.CommandBuffer, resource.Barrier);
-				}
-				else if (resource.Texture)
+					// Without a render pass the swapchain transitions are no longer implied by the attachment layouts
+					VkImageLayout layout = currentFrame.SwapchainImage->GetImageLayout();
+					if (layout != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+					{
+						currentFrame.SwapchainImage->ExecuteBarrier(commandBuffer, {
+							PipelineStage::ColorAttachmentOutput, AccessFlag::None,
+							PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
+							static_cast<ImageLayout>(layout), ImageLayout::ColorAttachmentOptimal
+						});
+					}
+
+					(colorAttachment++)->imageView = currentFrame.SwapchainImage->GetImageView();
+				}break;
+
+				case AttachmentType::Color:
 				{
-					resource.Texture->GetImage()->ExecuteBarrier(currentFrame.CommandBuffer, resource.Barrier);
-				}
-			}
-		}*/
+					(colorAttachment++)->imageView = attachment.Image->GetImageView();
+				}break;
 
-		for (const auto& attachment : Info.Attachments)
-		{
-			if (attachment.Image)
-			{
-				if (attachment.Image->GetImageLayout() != static_cast<VkImageLayout>(attachment.Barrier.OldLayout) && attachment.Barrier.OldLayout != ImageLayout::Undefined)
+				case AttachmentType::Depth:
+				case AttachmentType::DepthStencil:
 				{
-					attachment.Image->ExecuteBarrier(commandBuffer, { static_cast<ImageLayout>(attachment.Image->GetImageLayout()), attachment.Barrier.OldLayout});
-				}
+					m_DepthAttachment.imageView = attachment.Image->GetImageView();
+				}break;
 			}
 		}
 
-		switch (Info.StageType)
+		VkRenderingInfo renderingInfo = {
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.flags = (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0u,
+			.renderArea = {
+				.extent = GetRenderExtent()
+			},
+			.layerCount = 1,
+			.colorAttachmentCount = static_cast<uint32_t>(m_ColorAttachments.size()),
+			.pColorAttachments = m_ColorAttachments.data(),
+			.pDepthAttachment = (m_RenderingFormats.Depth != VK_FORMAT_UNDEFINED) ? &m_DepthAttachment : nullptr,
+			.pStencilAttachment = (m_RenderingFormats.Stencil != VK_FORMAT_UNDEFINED) ? &m_DepthAttachment : nullptr,
+		};
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void RendererStage::EndRenderPass(VkCommandBuffer commandBuffer)
+	{
+		if (!DynamicRendering)
 		{
-			case RendererStageType::Blit:
-			{
-				BlitStage(commandBuffer);
-			}break;
-			case RendererStageType::DeferredCompute:
-			case RendererStageType::ForwardCompute:
-			{
-				ForwardCompute(commandBuffer);
-			}break;
-			case RendererStageType::ImGui:
-			{
-				ImGui(commandBuffer);
-			}break;
-			case RendererStageType::ForwardGraphics:
-			case RendererStageType::DeferredGraphics:
-			case RendererStageType::ScreenSpacePass:
-			{
-				ForwardGraphics(commandBuffer);
-			}break;
-			case RendererStageType::RayTracing:
-			{
-				RayTracing(commandBuffer);
-			}break;
+			vkCmdEndRenderPass(commandBuffer);
+			return;
 		}
 
+		vkCmdEndRendering(commandBuffer);
+
+		// Matches the final layout the render pass would have left the swapchain in
 		for (const auto& attachment : Info.Attachments)
 		{
-			if (attachment.Image)
-			{
-				attachment.Image->SetImageLayout(static_cast<VkImageLayout>(attachment.Barrier.NewLayout));
-			}
+			ImageLayout finalLayout = SwapchainLayout(attachment.Barrier.NewLayout);
+			if (attachment.Type != AttachmentType::Swapchain || finalLayout == ImageLayout::ColorAttachmentOptimal)
+				continue;
+
+			s_Data.GetCurrentFrame().SwapchainImage->ExecuteBarrier(commandBuffer, {
+				PipelineStage::ColorAttachmentOutput, AccessFlag::ColorAttachmentWrite,
+				PipelineStage::BottomOfPipe, AccessFlag::None,
+				ImageLayout::ColorAttachmentOptimal, finalLayout
+			});
 		}
 	}
 
-	void RendererStage::Cleanup()
+	VkExtent2D RendererStage::GetRenderExtent() const
 	{
-		FrameBuffer.reset();
-		vkDestroyRenderPass(GraphicsContext::GetDevice(), RenderPass, nullptr);
+		const auto& attachment = *Info.Attachments.begin();
+		if (attachment.Type == AttachmentType::Swapchain)
+		{
+			return s_Data.GetCurrentFrame().SwapchainImage->GetExtent();
+		}
+
+		return attachment.Image->GetExtent();
 	}
 
-	void RendererStage::ForwardGraphics(VkCommandBuffer commandBuffer)
+	void RendererStage::SetDynamicState(VkCommandBuffer commandBuffer)
 	{
-		HG_PROFILE_GPU_EVENT("ForwardGraphics Pass");
-		HG_PROFILE_TAG("Name", Info.Name.c_str());
-
-		RendererFrame& currentFrame = s_Data.GetCurrentFrame();
-		VkExtent2D extent = Info.Attachments.begin()->Image->GetExtent();
-
-		VkRenderPassBeginInfo renderPassBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = RenderPass,
-			.framebuffer = static_cast<VkFramebuffer>(*FrameBuffer),
-			.renderArea = {
-				.extent = extent
-			},
-			.clearValueCount = static_cast<uint32_t>(ClearValues.size()),
-			.pClearValues = ClearValues.data(),
-		};
-
-		VkSubpassBeginInfo subpassBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_SUBPASS_BEGIN_INFO,
-			.contents = VK_SUBPASS_CONTENTS_INLINE,
-		};
-
-		vkCmdBeginRenderPass2(commandBuffer, &renderPassBeginInfo, &subpassBeginInfo);
+		VkExtent2D extent = GetRenderExtent();
 
 		VkViewport viewport;
 		viewport.x = 0.0f;
@@ -562,40 +1521,67 @@ namespace Hog
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
 		vkCmdSetDepthBias(commandBuffer, 0, 0, 0);
+	}
 
-		Info.Pipeline->Bind(commandBuffer);
+	void RendererStage::DrawMeshes(VkCommandBuffer commandBuffer, uint32_t firstMesh, uint32_t meshCount)
+	{
+		GeometryArena::Bind(commandBuffer, Info.Pipeline->GetVertexStream());
+		VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+		// Transforms come from the scene buffer through firstInstance, nothing is pushed per mesh
+		for (uint32_t m = firstMesh; m < firstMesh + meshCount; m++)
+		{
+			Info.Meshes[m]->Draw(commandBuffer, indexType, m_Visibility.empty() ? nullptr : m_Visibility.data() + m_BoundsOffsets[m]);
+		}
+	}
 
-		BindResources(commandBuffer, &s_Data.GetCurrentFrame().DescriptorAllocator);
+	void RendererStage::CullMeshes()
+	{
+		HG_PROFILE_FUNCTION();
 
-		if (Info.StageType == RendererStageType::ScreenSpacePass)
+		bool layoutChanged = m_BoundsOffsets.size() != Info.Meshes.size() + 1;
+		for (size_t i = 0; i < Info.Meshes.size() && !layoutChanged; i++)
 		{
-			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			layoutChanged = m_BoundsOffsets[i + 1] - m_BoundsOffsets[i] != Info.Meshes[i]->GetWorldSpheres().size();
 		}
-		else 
+
+		if (layoutChanged)
 		{
-			for (auto && mesh : Info.Meshes)
+			m_BoundsOffsets.assign(1, 0);
+			for (const auto& mesh : Info.Meshes)
 			{
-				glm::mat4 modelMat = mesh->GetModelMatrix();
-				for (int i = 0; i < Info.Resources.size(); i++)
-				{
-					const auto& resource = Info.Resources[i];
+				m_BoundsOffsets.push_back(m_BoundsOffsets.back() + static_cast<uint32_t>(mesh->GetWorldSpheres().size()));
+			}
 
-					switch (resource.Type)
-					{
-						case ResourceType::PushConstant:
-						{
-							std::memcpy(resource.ConstantDataPointer, &modelMat, resource.ConstantSize);
-							vkCmdPushConstants(commandBuffer, Info.Pipeline->GetPipelineLayout(), resource.BindLocation, 0, static_cast<uint32_t>(resource.ConstantSize), resource.ConstantDataPointer);
-						}break;
-						default: break;
-					}
-				}
+			m_BoundingSpheres.Resize(m_BoundsOffsets.back());
+			m_BoundsVersions.assign(Info.Meshes.size(), UINT64_MAX);
+		}
+
+		for (size_t i = 0; i < Info.Meshes.size(); i++)
+		{
+			const auto& mesh = Info.Meshes[i];
+			if (m_BoundsVersions[i] == mesh->GetBoundsVersion())
+				continue;
 
-				mesh->Draw(commandBuffer);
+			const auto& spheres = mesh->GetWorldSpheres();
+			for (size_t j = 0; j < spheres.size(); j++)
+			{
+				m_BoundingSpheres.Set(m_BoundsOffsets[i] + j, spheres[j]);
 			}
+
+			m_BoundsVersions[i] = mesh->GetBoundsVersion();
 		}
 
-		vkCmdEndRenderPass(commandBuffer);
+		glm::mat4 viewProjection = *static_cast<const glm::mat4*>(Info.CullingViewProjection->GetData());
+		uint32_t visible = Math::CullSpheres(Math::ExtractFrustumPlanes(viewProjection), m_BoundingSpheres, m_Visibility);
+		HG_PROFILE_TAG("Visible", visible);
+
+		// Levels of detail are picked for the view the meshes were culled against
+		float pixelScale = static_cast<float>(GetRenderExtent().height) / (2.0f * CVar_LodThreshold.GetFloat());
+		for (size_t i = 0; i < Info.Meshes.size(); i++)
+		{
+			Info.Meshes[i]->SelectLods(viewProjection, pixelScale, Info.LodBias, m_Visibility.data() + m_BoundsOffsets[i]);
+		}
 	}
 
 	void RendererStage::ForwardCompute(VkCommandBuffer commandBuffer)
@@ -603,13 +1589,131 @@ namespace Hog
 		HG_PROFILE_GPU_EVENT("ForwardCompute Pass");
 		HG_PROFILE_TAG("Name", Info.Name.c_str());
 
+		if (Info.DispatchBuffer)
+		{
+			ResetDrawCount(commandBuffer);
+		}
+
 		Info.Pipeline->Bind(commandBuffer);
 
-		BindResources(commandBuffer, &s_Data.GetCurrentFrame().DescriptorAllocator);
+		BindResources(commandBuffer);
 
 		vkCmdDispatch(commandBuffer, Info.GroupCounts.x, Info.GroupCounts.y, Info.GroupCounts.z);
 	}
 
+	void RendererStage::ResetDrawCount(VkCommandBuffer commandBuffer)
+	{
+		vkCmdFillBuffer(commandBuffer, Info.DispatchBuffer->GetHandle(), DrawList::CountOffset, DrawList::CountSize, 0);
+
+		// Recorded every frame, so resizes and stages rendering at their own extent like shadow maps pick the right levels
+		if (DrawStage)
+		{
+			float lodPixelScale = static_cast<float>(DrawStage->GetRenderExtent().height) / (2.0f * CVar_LodThreshold.GetFloat());
+			vkCmdUpdateBuffer(commandBuffer, Info.DispatchBuffer->GetHandle(), DrawList::LodPixelScaleOffset, sizeof(lodPixelScale), &lodPixelScale);
+		}
+
+		VkBufferMemoryBarrier2 barrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = Info.DispatchBuffer->GetHandle(),
+			.offset = 0,
+			.size = DrawList::CommandOffset,
+		};
+
+		VkDependencyInfo info = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = 1,
+			.pBufferMemoryBarriers = &barrier,
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &info);
+	}
+
+	void RendererStage::DepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		HG_PROFILE_GPU_EVENT("DepthPyramid Pass");
+		HG_PROFILE_TAG("Name", Info.Name.c_str());
+
+		// Matches the push constant block and local size of the reduction shader
+		struct DepthPyramidConstants
+		{
+			glm::ivec2 SourceSize;
+			glm::ivec2 DestinationSize;
+			uint32_t Level;
+			uint32_t Source;
+			uint32_t Destination;
+		};
+		constexpr uint32_t groupSize = 8;
+
+		auto depth = std::find_if(Info.Resources.begin(), Info.Resources.end(), [](const ResourceElement& resource) { return resource.Type == ResourceType::Sampler; });
+		auto pyramid = std::find_if(Info.Resources.begin(), Info.Resources.end(), [](const ResourceElement& resource) { return resource.Type == ResourceType::StorageImage; });
+		HG_CORE_ASSERT(depth != Info.Resources.end() && pyramid != Info.Resources.end(), "Depth pyramid stages need the depth as a Sampler and the pyramid as a StorageImage resource");
+
+		const Ref<Image>& image = pyramid->StorageImage;
+		VkExtent2D depthExtent = depth->Texture->GetImage()->GetExtent();
+
+		Info.Pipeline->Bind(commandBuffer);
+
+		BindResources(commandBuffer);
+
+		glm::ivec2 sourceSize = { depthExtent.width, depthExtent.height };
+		for (uint32_t level = 0; level < image->GetLevelCount(); level++)
+		{
+			glm::ivec2 destinationSize = { std::max(image->GetWidth() >> level, 1u), std::max(image->GetHeight() >> level, 1u) };
+
+			// Level 0 reads the depth through the sampler, every other level the one before it
+			DepthPyramidConstants constants = {
+				.SourceSize = sourceSize,
+				.DestinationSize = destinationSize,
+				.Level = level,
+				.Source = level > 0 ? image->GetLevelStorageIndex(level - 1) : 0,
+				.Destination = image->GetLevelStorageIndex(level),
+			};
+
+			vkCmdPushConstants(commandBuffer, Info.Pipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			vkCmdDispatch(commandBuffer, (destinationSize.x + groupSize - 1) / groupSize, (destinationSize.y + groupSize - 1) / groupSize, 1);
+
+			sourceSize = destinationSize;
+
+			// The render graph synchronizes the finished pyramid with its readers
+			if (level + 1 == image->GetLevelCount())
+				break;
+
+			VkImageMemoryBarrier2 barrier = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image->GetHandle(),
+				.subresourceRange = {
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = level,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+			};
+
+			VkDependencyInfo info = {
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.imageMemoryBarrierCount = 1,
+				.pImageMemoryBarriers = &barrier,
+			};
+
+			vkCmdPipelineBarrier2(commandBuffer, &info);
+		}
+	}
+
 	void RendererStage::ImGui(VkCommandBuffer commandBuffer)
 	{
 		// ImGui
@@ -643,26 +1747,9 @@ namespace Hog
 	{
 		// Copy to final target
 		HG_PROFILE_GPU_EVENT("Blit Pass");
-		RendererFrame& currentFrame = s_Data.GetCurrentFrame();
-		VkExtent2D extent = currentFrame.FrameBuffer->GetExtent();
-
-		VkRenderPassBeginInfo renderPassBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = RenderPass,
-			.framebuffer = static_cast<VkFramebuffer>(*(currentFrame.FrameBuffer)),
-			.renderArea = {
-				.extent = extent
-			},
-			.clearValueCount = static_cast<uint32_t>(ClearValues.size()),
-			.pClearValues = ClearValues.data(),
-		};
-
-		VkSubpassBeginInfo subpassBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_SUBPASS_BEGIN_INFO,
-			.contents = VK_SUBPASS_CONTENTS_INLINE,
-		};
+		VkExtent2D extent = GetRenderExtent();
 
-		vkCmdBeginRenderPass2(commandBuffer, &renderPassBeginInfo, &subpassBeginInfo);
+		BeginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport;
 		viewport.x = 0.0f;
@@ -683,17 +1770,17 @@ namespace Hog
 
 		Info.Pipeline->Bind(commandBuffer);
 
-		BindResources(commandBuffer, &currentFrame.DescriptorAllocator);
+		BindResources(commandBuffer);
 
 		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-		vkCmdEndRenderPass(commandBuffer);
+		EndRenderPass(commandBuffer);
 	}
 
 	void RendererStage::RayTracing(VkCommandBuffer commandBuffer)
 	{
 		Info.Pipeline->Bind(commandBuffer);
-		BindResources(commandBuffer, &s_Data.GetCurrentFrame().DescriptorAllocator);
+		BindResources(commandBuffer);
 
 		vkCmdTraceRaysKHR(commandBuffer,
 			Info.ShaderBindingTable->GetRaygenShaderSBTEntry(),
@@ -706,110 +1793,199 @@ namespace Hog
 		);
 	}
 
-	void RendererStage::BindResources(VkCommandBuffer commandBuffer, DescriptorAllocator* allocator)
+	size_t RendererStage::HashResources() const
 	{
-		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-		auto db = DescriptorBuilder::Begin(Renderer::GetDescriptorLayoutCache(), allocator);
-		std::vector<VkDescriptorImageInfo*> imageInfos;
-		std::vector<VkDescriptorBufferInfo*> bufferInfos;
-		std::vector<VkWriteDescriptorSetAccelerationStructureKHR*> acceleratrionStructureInfos;
+		size_t result = std::hash<size_t>()(Info.Resources.size());
+		auto combine = [&result](auto value)
+		{
+			result ^= std::hash<decltype(value)>()(value) + 0x9e3779b9 + (result << 6) + (result >> 2);
+		};
 
-		for (int i = 0; i < Info.Resources.size(); i++)
+		for (const auto& resource : Info.Resources)
 		{
-			const auto& resource = Info.Resources[i];
+			combine(resource.Binding);
+			combine(static_cast<uint32_t>(resource.Type));
 
-			switch(resource.Type)
+			switch (resource.Type)
 			{
 				case ResourceType::Sampler:
 				{
-					VkDescriptorImageInfo* sourceImage = new VkDescriptorImageInfo;
-					sourceImage->sampler = resource.Texture->GetSampler();
-
-					sourceImage->imageView = resource.Texture->GetImageView();
-					sourceImage->imageLayout = resource.Texture->GetImageLayout();
-					imageInfos.push_back(sourceImage);
-					
-					db.BindImage(resource.Binding, imageInfos.back(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, resource.BindLocation);
+					combine(reinterpret_cast<uintptr_t>(resource.Texture->GetSampler()));
+					combine(reinterpret_cast<uintptr_t>(resource.Texture->GetImageView()));
+					combine(static_cast<uint32_t>(resource.Texture->GetImageLayout()));
 				}break;
 				case ResourceType::StorageImage:
 				{
-					VkDescriptorImageInfo* sourceImage = new VkDescriptorImageInfo;
-					sourceImage->imageView = resource.StorageImage->GetImageView();
-					sourceImage->imageLayout = resource.StorageImage->GetImageLayout();
-					imageInfos.push_back(sourceImage);
-
-					db.BindImage(resource.Binding, imageInfos.back(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, resource.BindLocation);
+					combine(reinterpret_cast<uintptr_t>(resource.StorageImage->GetImageView()));
+					combine(static_cast<uint32_t>(resource.StorageImage->GetImageLayout()));
 				}break;
 				case ResourceType::Storage:
+				case ResourceType::Uniform:
 				{
-					VkDescriptorBufferInfo* bufferInfo = new VkDescriptorBufferInfo;
-					bufferInfo->buffer = resource.Buffer->GetHandle();
-					bufferInfo->offset = 0;
-					bufferInfo->range = VK_WHOLE_SIZE;
-					bufferInfos.push_back(bufferInfo);
-
-					db.BindBuffer(resource.Binding, bufferInfos.back(), resource.Buffer->GetBufferDescription(), resource.BindLocation);
+					combine(reinterpret_cast<uintptr_t>(resource.Buffer->GetHandle()));
+					combine(static_cast<size_t>(resource.Buffer->GetSize()));
 				}break;
-				case ResourceType::Uniform:
+				case ResourceType::DynamicUniform:
+				case ResourceType::DynamicStorage:
 				{
-					VkDescriptorBufferInfo* bufferInfo = new VkDescriptorBufferInfo;
-					bufferInfo->buffer = resource.Buffer->GetHandle();
-					bufferInfo->offset = 0;
-					bufferInfo->range = VK_WHOLE_SIZE;
-					bufferInfos.push_back(bufferInfo);
-
-					db.BindBuffer(resource.Binding, bufferInfos.back(), resource.Buffer->GetBufferDescription(), resource.BindLocation);
+					// The offset changes every frame and is passed at bind time, so it stays out of the hash
+					combine(reinterpret_cast<uintptr_t>(UploadRing::GetBuffer()));
+					combine(resource.DynamicBuffer->GetSize());
 				}break;
-				case ResourceType::PushConstant: break;
-				case ResourceType::Constant: break;
-				case ResourceType::SamplerArray:
+				case ResourceType::AccelerationStructure:
 				{
-					VkDescriptorImageInfo* imageInfosLocal = new VkDescriptorImageInfo[resource.Textures.size()];
-					for (int i = 0; i < resource.Textures.size(); ++i)
-					{
-						imageInfosLocal[i].sampler = resource.Textures[i]->GetSampler();
+					combine(reinterpret_cast<uintptr_t>(*resource.TLAS->GetHandlePtr()));
+				}break;
+				default: break;
+			}
+		}
 
-						imageInfosLocal[i].imageView = resource.Textures[i]->GetImageView();
-						imageInfosLocal[i].imageLayout = resource.Textures[i]->GetImageLayout();
-					}
+		return result;
+	}
 
-					imageInfos.push_back(imageInfosLocal);
+	void RendererStage::PrepareResources(DescriptorAllocator* allocator)
+	{
+		auto& cached = DescriptorSets[s_Data.FrameIndex];
+		size_t hash = HashResources();
 
-					db.BindImage(resource.Binding, imageInfos.back(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, resource.BindLocation, resource.Textures.size(), resource.ArrayMaxCount);
-				}break;
-				case ResourceType::AccelerationStructure:
+		if (cached.Set == VK_NULL_HANDLE || cached.Hash != hash)
+		{
+			auto db = DescriptorBuilder::Begin(Renderer::GetDescriptorLayoutCache(), allocator);
+
+			// Reserve up front so the pointers handed to the builder stay valid
+			size_t imageInfoCount = 0;
+			size_t bufferInfoCount = 0;
+			size_t accelerationStructureInfoCount = 0;
+			for (const auto& resource : Info.Resources)
+			{
+				switch (resource.Type)
 				{
-					VkWriteDescriptorSetAccelerationStructureKHR* accelerationStructureInfo = new VkWriteDescriptorSetAccelerationStructureKHR;
-					accelerationStructureInfo->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
-					accelerationStructureInfo->pNext = nullptr;
-					accelerationStructureInfo->accelerationStructureCount = 1;
-					accelerationStructureInfo->pAccelerationStructures = resource.TLAS->GetHandlePtr();
+					case ResourceType::Sampler:
+					case ResourceType::StorageImage: imageInfoCount++; break;
+					case ResourceType::Storage:
+					case ResourceType::Uniform:
+					case ResourceType::DynamicStorage:
+					case ResourceType::DynamicUniform: bufferInfoCount++; break;
+					case ResourceType::AccelerationStructure: accelerationStructureInfoCount++; break;
+					default: break;
+				}
+			}
 
-					acceleratrionStructureInfos.push_back(accelerationStructureInfo);
+			std::vector<VkDescriptorImageInfo> imageInfos;
+			std::vector<VkDescriptorBufferInfo> bufferInfos;
+			std::vector<VkWriteDescriptorSetAccelerationStructureKHR> accelerationStructureInfos;
+			imageInfos.reserve(imageInfoCount);
+			bufferInfos.reserve(bufferInfoCount);
+			accelerationStructureInfos.reserve(accelerationStructureInfoCount);
 
-					db.BindAccelerationStructure(resource.Binding, acceleratrionStructureInfos.back(), VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, resource.BindLocation);
-				}break;
+			for (const auto& resource : Info.Resources)
+			{
+				switch(resource.Type)
+				{
+					case ResourceType::Sampler:
+					{
+						imageInfos.push_back({
+							.sampler = resource.Texture->GetSampler(),
+							.imageView = resource.Texture->GetImageView(),
+							.imageLayout = resource.Texture->GetImageLayout(),
+						});
+
+						db.BindImage(resource.Binding, &imageInfos.back(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, resource.BindLocation);
+					}break;
+					case ResourceType::StorageImage:
+					{
+						imageInfos.push_back({
+							.imageView = resource.StorageImage->GetImageView(),
+							.imageLayout = resource.StorageImage->GetImageLayout(),
+						});
+
+						db.BindImage(resource.Binding, &imageInfos.back(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, resource.BindLocation);
+					}break;
+					case ResourceType::Storage:
+					case ResourceType::Uniform:
+					{
+						bufferInfos.push_back({
+							.buffer = resource.Buffer->GetHandle(),
+							.offset = 0,
+							.range = VK_WHOLE_SIZE,
+						});
+
+						db.BindBuffer(resource.Binding, &bufferInfos.back(), resource.Buffer->GetBufferDescription(), resource.BindLocation);
+					}break;
+					case ResourceType::DynamicUniform:
+					case ResourceType::DynamicStorage:
+					{
+						bufferInfos.push_back({
+							.buffer = UploadRing::GetBuffer(),
+							.offset = 0,
+							.range = resource.DynamicBuffer->GetSize(),
+						});
+
+						VkDescriptorType type = (resource.Type == ResourceType::DynamicUniform) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+						db.BindBuffer(resource.Binding, &bufferInfos.back(), type, resource.BindLocation);
+					}break;
+					case ResourceType::PushConstant: break;
+					case ResourceType::Constant: break;
+					case ResourceType::AccelerationStructure:
+					{
+						accelerationStructureInfos.push_back({
+							.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
+							.accelerationStructureCount = 1,
+							.pAccelerationStructures = resource.TLAS->GetHandlePtr(),
+						});
+
+						db.BindAccelerationStructure(resource.Binding, &accelerationStructureInfos.back(), VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, resource.BindLocation);
+					}break;
+				}
+			}
+
+			// The set of this frame slot is no longer in flight, so it can be rewritten in place
+			if (cached.Set == VK_NULL_HANDLE)
+			{
+				db.Build(cached.Set);
+			}
+			else
+			{
+				db.Update(cached.Set);
 			}
-		}
 
-		db.Build(descriptorSet);
+			cached.Hash = hash;
+		}
 
-		vkCmdBindDescriptorSets(commandBuffer, ToPipelineBindPoint(Info.StageType), Info.Pipeline->GetPipelineLayout(),
-			0, 1, &descriptorSet, 0, nullptr);
+		m_DescriptorSet = cached.Set;
 
-		for (size_t i = 0; i < imageInfos.size(); i++)
+		// Dynamic offsets are consumed in binding order
+		std::vector<std::pair<uint32_t, uint32_t>> dynamicOffsets;
+		for (const auto& resource : Info.Resources)
 		{
-			delete imageInfos[i];
+			if (resource.Type == ResourceType::DynamicUniform || resource.Type == ResourceType::DynamicStorage)
+			{
+				dynamicOffsets.push_back({ resource.Binding, resource.DynamicBuffer->GetOffset() });
+			}
 		}
 
-		for (size_t i = 0; i < bufferInfos.size(); i++)
+		std::sort(dynamicOffsets.begin(), dynamicOffsets.end());
+
+		m_DynamicOffsets.clear();
+		for (const auto& [binding, offset] : dynamicOffsets)
 		{
-			delete bufferInfos[i];
+			m_DynamicOffsets.push_back(offset);
 		}
-		
-		for (size_t i = 0; i < acceleratrionStructureInfos.size(); i++)
+	}
+
+	void RendererStage::BindResources(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, ToPipelineBindPoint(Info.StageType), Info.Pipeline->GetPipelineLayout(),
+			0, 1, &m_DescriptorSet, static_cast<uint32_t>(m_DynamicOffsets.size()), m_DynamicOffsets.data());
+
+		BindlessHeap::Bind(commandBuffer, ToPipelineBindPoint(Info.StageType), Info.Pipeline->GetPipelineLayout());
+
+		for (const auto& resource : Info.Resources)
 		{
-			delete acceleratrionStructureInfos[i];
+			if (resource.Type == ResourceType::PushConstant)
+			{
+				vkCmdPushConstants(commandBuffer, Info.Pipeline->GetPipelineLayout(), resource.BindLocation, 0, static_cast<uint32_t>(resource.ConstantSize), resource.ConstantDataPointer);
+			}
 		}
 	}
 }
@@ -1,13 +1,28 @@
 #pragma once
 
 #include "Hog/Renderer/Image.h"
+#include "Hog/Renderer/Buffer.h"
 #include "Hog/Renderer/RenderGraph.h"
 #include "Hog/Renderer/FrameBuffer.h"
 #include "Hog/Renderer/Descriptor.h"
 #include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Math/Math.h"
 
 namespace Hog
 {
+	struct ReadbackImage
+	{
+		const void* Data = nullptr;
+		size_t Size = 0;
+		VkExtent2D Extent = {};
+		VkFormat Format = VK_FORMAT_UNDEFINED;
+		// Renderer frame the image was rendered in
+		uint64_t Frame = 0;
+	};
+
+	// Data is only valid for the duration of the call
+	using ReadbackCallbackFn = std::function<void(const ReadbackImage&)>;
+
 	class Renderer
 	{
 	public:
@@ -15,6 +30,8 @@ namespace Hog
 		static void Cleanup();
 		static DescriptorLayoutCache* GetDescriptorLayoutCache();
 		static void Draw();
+		// Recreates the swapchain along with the transient images sized by it, their aliased memory and the framebuffers
+		static void Resize();
 
 		struct RendererStats
 		{
@@ -22,48 +39,137 @@ namespace Hog
 		};
 
 		static RendererStats GetStats();
+
+		// Receives the final image of every headless frame once the GPU finished it, a few frames after it was drawn
+		static void SetReadbackCallback(ReadbackCallbackFn callback);
 	};
 
 	class RendererFrame
 	{
 	public:
 		void Init();
-		void Init(Ref<Image> swapchainImage, VkRenderPass renderPass);
 		void BeginFrame();
+		VkCommandBuffer BeginBatch(uint32_t batch);
+		void SubmitBatch(uint32_t batch);
+		VkCommandBuffer AcquireSecondaryCommandBuffer(uint32_t worker);
 		void EndFrame();
 		void Cleanup();
 	public:
 		VkDevice Device = VK_NULL_HANDLE;
 		VkQueue Queue = VK_NULL_HANDLE;
+		VkQueue ComputeQueue = VK_NULL_HANDLE;
 		VkSwapchainKHR Swapchain = VK_NULL_HANDLE;
 		VkCommandPool CommandPool = VK_NULL_HANDLE;
-		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkCommandPool ComputeCommandPool = VK_NULL_HANDLE;
+		// One command buffer per submit batch, allocated from the pool of the batch's queue
+		std::vector<VkCommandBuffer> CommandBuffers;
+		// Timeline values signaled by each batch this frame
+		std::vector<uint64_t> BatchValues;
+		uint64_t ComputeValue = 0;
+		uint64_t GraphicsValue = 0;
+		// Transfer timeline value the first graphics batch waits on, 0 when nothing was streamed in
+		uint64_t StreamingValue = 0;
+
+		struct WorkerCommandBuffers
+		{
+			VkCommandPool CommandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> CommandBuffers;
+			uint32_t Used = 0;
+		};
+
+		// Secondary command buffers of each recording thread, recycled once the frame's fence signaled
+		std::vector<WorkerCommandBuffers> Workers;
 		VkFence Fence = VK_NULL_HANDLE;
 		VkSemaphore PresentSemaphore = VK_NULL_HANDLE;
+		// Swapchain image acquired this frame along with its render semaphore and framebuffer, owned by the renderer
 		VkSemaphore RenderSemaphore = VK_NULL_HANDLE;
 		Ref<FrameBuffer> FrameBuffer;
 		DescriptorAllocator DescriptorAllocator;
 		Ref<Image> SwapchainImage;
+		// Host copy of the headless swapchain image, filled at the end of the frame and read once the fence signaled
+		Ref<Buffer> ReadbackBuffer;
+		uint64_t ReadbackFrame = 0;
+		bool ReadbackPending = false;
 	};
 
 	class RendererStage
 	{
 	public:
 		void Init();
+		// Resolves barriers and descriptor sets, stages have to be prepared in graph order
+		void Prepare(DescriptorAllocator* allocator);
 		void Execute(VkCommandBuffer commandBuffer);
+		void ExecuteSecondary(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer>& secondaryCommandBuffers);
+		void RecordChunk(VkCommandBuffer commandBuffer, uint32_t firstMesh, uint32_t meshCount);
+		bool RecordsInParallel() const;
+		// Render pass stages keep the attachment views in a framebuffer, it is recreated whenever they are resized
+		void CreateFrameBuffer();
 		void Cleanup();
 	public:
 		StageDescription Info;
 		VkRenderPass RenderPass = VK_NULL_HANDLE;
 		Ref<FrameBuffer> FrameBuffer;
 		std::vector<VkClearValue> ClearValues;
+		// Renders straight into the attachment views instead of going through RenderPass and FrameBuffer
+		bool DynamicRendering = false;
+		StageBarriers Barriers;
+		QueueType Queue = QueueType::Graphics;
+		// Graphics stage drawing the commands a culling stage writes into Info.DispatchBuffer
+		RendererStage* DrawStage = nullptr;
+
+		struct CachedDescriptorSet
+		{
+			size_t Hash = 0;
+			VkDescriptorSet Set = VK_NULL_HANDLE;
+		};
+
+		// One set per frame in flight, only rewritten when the bound resources change
+		std::vector<CachedDescriptorSet> DescriptorSets;
 	private:
 		void ForwardGraphics(VkCommandBuffer commandBuffer);
 		void ForwardCompute(VkCommandBuffer commandBuffer);
+		// Clears the draw count of Info.DispatchBuffer so the culling dispatch can append to it,
+		// and writes the level of detail scale for the render extent of DrawStage
+		void ResetDrawCount(VkCommandBuffer commandBuffer);
+		// Reduces the Sampler depth resource into every level of the StorageImage resource, keeping the farthest depth
+		void DepthPyramid(VkCommandBuffer commandBuffer);
 		void ImGui(VkCommandBuffer commandBuffer);
 		void BlitStage(VkCommandBuffer commandBuffer);
 		void RayTracing(VkCommandBuffer commandBuffer);
 
-		void BindResources(VkCommandBuffer commandBuffer, DescriptorAllocator* allocator);
+		void InitRendering();
+		void BeginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents);
+		void EndRenderPass(VkCommandBuffer commandBuffer);
+		VkExtent2D GetRenderExtent() const;
+		void SetDynamicState(VkCommandBuffer commandBuffer);
+		void DrawMeshes(VkCommandBuffer commandBuffer, uint32_t firstMesh, uint32_t meshCount);
+		// Tests the world bounds of every mesh instance against Info.CullingViewProjection
+		void CullMeshes();
+
+		void PrepareBarriers();
+		void RecordBarriers(VkCommandBuffer commandBuffer);
+
+		size_t HashResources() const;
+		void PrepareResources(DescriptorAllocator* allocator);
+		void BindResources(VkCommandBuffer commandBuffer);
+	private:
+		std::vector<VkImageMemoryBarrier2> m_ImageBarriers;
+		std::vector<VkBufferMemoryBarrier2> m_BufferBarriers;
+		VkDescriptorSet m_DescriptorSet = VK_NULL_HANDLE;
+		// Offsets of this frame's dynamic buffers inside the upload ring
+		std::vector<uint32_t> m_DynamicOffsets;
+
+		RenderingFormats m_RenderingFormats;
+		std::vector<VkRenderingAttachmentInfo> m_ColorAttachments;
+		VkRenderingAttachmentInfo m_DepthAttachment = {};
+
+		// World bounding spheres of every mesh instance, refreshed only for meshes whose bounds changed
+		Math::SphereArray m_BoundingSpheres;
+		std::vector<uint64_t> m_BoundsVersions;
+		// First entry of each mesh in m_BoundingSpheres and m_Visibility
+		std::vector<uint32_t> m_BoundsOffsets;
+		// Zero for culled instances, otherwise one plus the level of detail to draw.
+		// Written by CullMeshes on the main thread, only read while recording
+		std::vector<uint8_t> m_Visibility;
 	};
 }
@@ -0,0 +1,195 @@
+#include "hgpch.h"
+#include "SceneBuffer.h"
+
+#include "Hog/Renderer/UploadRing.h"
+#include "Hog/Core/CVars.h"
+
+AutoCVar_Int CVar_SceneObjectCount("renderer.scene.objectCount", "Number of mesh primitive instances the scene buffer holds", 128 * 1024, CVarFlags::EditReadOnly);
+
+namespace Hog
+{
+	SceneObject SceneBuffer::CreateObject(const glm::mat4& model, int32_t materialIndex, const glm::vec4& positionBounds)
+	{
+		return {
+			.Model = model,
+			.NormalMatrix = glm::transpose(glm::inverse(model)),
+			.PositionBounds = positionBounds,
+			.MaterialIndex = materialIndex,
+		};
+	}
+
+	void SceneBuffer::InitializeImpl()
+	{
+		uint32_t objectCount = static_cast<uint32_t>(CVar_SceneObjectCount.Get());
+
+		m_Buffer = Buffer::Create(BufferDescription::Defaults::StorageBuffer, static_cast<size_t>(objectCount) * sizeof(SceneObject));
+		m_Allocator.Init(objectCount);
+
+		m_Initialized = true;
+	}
+
+	void SceneBuffer::DeinitializeImpl()
+	{
+		m_Buffer.reset();
+		m_Objects.clear();
+		m_DirtyInstances.clear();
+		m_OverflowStaging.clear();
+		m_PendingFrees.clear();
+
+		m_Initialized = false;
+	}
+
+	uint32_t SceneBuffer::AllocateImpl(const std::vector<SceneObject>& objects)
+	{
+		uint32_t count = static_cast<uint32_t>(objects.size());
+		uint32_t firstInstance = m_Allocator.Allocate(count);
+		HG_CORE_ASSERT(firstInstance != RangeAllocator::InvalidOffset, "Scene buffer is full, raise renderer.scene.objectCount");
+
+		if (m_Objects.size() < firstInstance + count)
+		{
+			m_Objects.resize(firstInstance + count);
+		}
+
+		std::copy(objects.begin(), objects.end(), m_Objects.begin() + firstInstance);
+		m_Buffer->WriteData(&m_Objects[firstInstance], count * sizeof(SceneObject), firstInstance * sizeof(SceneObject));
+
+		return firstInstance;
+	}
+
+	void SceneBuffer::FreeImpl(uint32_t firstInstance, uint32_t count)
+	{
+		if (!m_Initialized || count == 0)
+			return;
+
+		// Frames still in flight may draw the instances, so the slots are only reused once they retire
+		m_PendingFrees.push_back({ { firstInstance, count }, m_FrameCount });
+	}
+
+	void SceneBuffer::UpdateImpl(uint32_t instance, const glm::mat4& model, int32_t materialIndex)
+	{
+		// The bounds belong to the primitive's geometry, only the transform changes
+		m_Objects[instance] = CreateObject(model, materialIndex, m_Objects[instance].PositionBounds);
+		m_DirtyInstances.push_back(instance);
+	}
+
+	void SceneBuffer::RecordUpdatesImpl(VkCommandBuffer commandBuffer)
+	{
+		if (m_DirtyInstances.empty())
+			return;
+
+		HG_PROFILE_FUNCTION();
+
+		std::sort(m_DirtyInstances.begin(), m_DirtyInstances.end());
+		m_DirtyInstances.erase(std::unique(m_DirtyInstances.begin(), m_DirtyInstances.end()), m_DirtyInstances.end());
+
+		VkDeviceSize size = m_DirtyInstances.size() * sizeof(SceneObject);
+		VkBuffer source;
+		VkDeviceSize sourceOffset;
+		SceneObject* destination;
+		Ref<Buffer> overflow;
+
+		if (size <= UploadRing::GetAvailable())
+		{
+			UploadAllocation staging = UploadRing::Allocate(size);
+			source = UploadRing::GetBuffer();
+			sourceOffset = staging.Offset;
+			destination = static_cast<SceneObject*>(staging.Data);
+		}
+		else
+		{
+			// Updates the ring segment can't hold go through a staging buffer per frame in flight, reused once that frame retired
+			uint32_t frameIndex = UploadRing::GetFrameIndex();
+			if (m_OverflowStaging.size() <= frameIndex)
+			{
+				m_OverflowStaging.resize(frameIndex + 1);
+			}
+
+			overflow = m_OverflowStaging[frameIndex];
+			if (!overflow || overflow->GetSize() < size)
+			{
+				overflow = Buffer::Create(BufferDescription::Defaults::TransferSourceBuffer, size);
+				m_OverflowStaging[frameIndex] = overflow;
+			}
+
+			source = overflow->GetHandle();
+			sourceOffset = 0;
+			destination = static_cast<SceneObject*>(static_cast<void*>(*overflow));
+		}
+
+		// Consecutive instances are copied as one range
+		std::vector<VkBufferCopy> regions;
+		for (size_t i = 0; i < m_DirtyInstances.size();)
+		{
+			size_t first = i;
+			while (i + 1 < m_DirtyInstances.size() && m_DirtyInstances[i + 1] == m_DirtyInstances[i] + 1)
+			{
+				i++;
+			}
+			i++;
+
+			size_t count = i - first;
+			std::memcpy(destination + first, &m_Objects[m_DirtyInstances[first]], count * sizeof(SceneObject));
+
+			regions.push_back({
+				.srcOffset = sourceOffset + first * sizeof(SceneObject),
+				.dstOffset = m_DirtyInstances[first] * sizeof(SceneObject),
+				.size = count * sizeof(SceneObject),
+			});
+		}
+
+		m_DirtyInstances.clear();
+
+		if (overflow)
+		{
+			overflow->Flush(0, size);
+		}
+
+		// The previous frame may still read the instances that are about to be overwritten
+		VkBufferMemoryBarrier2 barrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.srcAccessMask = VK_ACCESS_2_NONE,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = m_Buffer->GetHandle(),
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		};
+
+		VkDependencyInfo info = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = 1,
+			.pBufferMemoryBarriers = &barrier,
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &info);
+
+		vkCmdCopyBuffer(commandBuffer, source, m_Buffer->GetHandle(), static_cast<uint32_t>(regions.size()), regions.data());
+
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+		vkCmdPipelineBarrier2(commandBuffer, &info);
+	}
+
+	void SceneBuffer::NextFrameImpl()
+	{
+		m_FrameCount++;
+
+		uint64_t framesInFlight = static_cast<uint64_t>(*CVarSystem::Get()->GetIntCVar("renderer.frameCount"));
+		auto it = std::remove_if(m_PendingFrees.begin(), m_PendingFrees.end(), [this, framesInFlight](const PendingFree& pending)
+			{
+				if (m_FrameCount - pending.Frame <= framesInFlight)
+					return false;
+
+				m_Allocator.Free(pending.Allocation.Offset, pending.Allocation.Count);
+				return true;
+			});
+
+		m_PendingFrees.erase(it, m_PendingFrees.end());
+	}
+}
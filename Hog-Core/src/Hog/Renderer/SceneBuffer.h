@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/GeometryArena.h"
+
+namespace Hog
+{
+	// Per instance data shaders read through gl_InstanceIndex, laid out for std430
+	struct SceneObject
+	{
+		glm::mat4 Model;
+		glm::mat4 NormalMatrix;
+		// Center in xyz and half extent in w of the primitive, compact vertex positions are relative to it
+		glm::vec4 PositionBounds;
+		int32_t MaterialIndex;
+		int32_t Padding[3];
+	};
+
+	// Device local storage buffer holding every mesh primitive instance of the scene.
+	// Stages bind it once and draws select their instance with firstInstance, so nothing is pushed per draw
+	// and passes drawing the same meshes share one upload. Changed instances are copied at the start of the next frame.
+	class SceneBuffer
+	{
+	public:
+		static SceneBuffer& Get()
+		{
+			static SceneBuffer instance;
+
+			return instance;
+		}
+
+		~SceneBuffer() { Deinitialize(); }
+		static void Initialize() { if (Get().m_Initialized == false) Get().InitializeImpl(); }
+		static void Deinitialize() { if (Get().m_Initialized == true) Get().DeinitializeImpl(); }
+
+		// Returns the first instance, new slots are not read by frames in flight so they are uploaded right away
+		static uint32_t Allocate(const std::vector<SceneObject>& objects) { Initialize(); return Get().AllocateImpl(objects); }
+		static void Free(uint32_t firstInstance, uint32_t count) { Get().FreeImpl(firstInstance, count); }
+		static void Update(uint32_t instance, const glm::mat4& model, int32_t materialIndex) { Get().UpdateImpl(instance, model, materialIndex); }
+
+		// Copies the instances changed since the last call, main thread only
+		static void RecordUpdates(VkCommandBuffer commandBuffer) { Get().RecordUpdatesImpl(commandBuffer); }
+		static void NextFrame() { Get().NextFrameImpl(); }
+
+		static Ref<Buffer> GetBuffer() { Initialize(); return Get().m_Buffer; }
+		static SceneObject CreateObject(const glm::mat4& model, int32_t materialIndex, const glm::vec4& positionBounds = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	public:
+		SceneBuffer(SceneBuffer const&) = delete;
+		void operator=(SceneBuffer const&) = delete;
+	private:
+		SceneBuffer() = default;
+
+		void InitializeImpl();
+		void DeinitializeImpl();
+		uint32_t AllocateImpl(const std::vector<SceneObject>& objects);
+		void FreeImpl(uint32_t firstInstance, uint32_t count);
+		void UpdateImpl(uint32_t instance, const glm::mat4& model, int32_t materialIndex);
+		void RecordUpdatesImpl(VkCommandBuffer commandBuffer);
+		void NextFrameImpl();
+	private:
+		struct PendingFree
+		{
+			GeometryAllocation Allocation;
+			uint64_t Frame;
+		};
+
+		bool m_Initialized = false;
+
+		Ref<Buffer> m_Buffer;
+		RangeAllocator m_Allocator;
+		// CPU copy of every allocated instance, dirty ones are copied from here
+		std::vector<SceneObject> m_Objects;
+		std::vector<uint32_t> m_DirtyInstances;
+		// Staging for updates larger than the upload ring segment, indexed by frame in flight
+		std::vector<Ref<Buffer>> m_OverflowStaging;
+		std::vector<PendingFree> m_PendingFrees;
+		uint64_t m_FrameCount = 0;
+	};
+}
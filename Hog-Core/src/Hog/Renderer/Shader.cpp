@@ -15,6 +15,7 @@
 #include "Hog/Utils/Filesystem.h"
 #include "Hog/Utils/RendererUtils.h"
 #include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Renderer/BindlessHeap.h"
 #include "Hog/Debug/Instrumentor.h"
 
 AutoCVar_String CVar_ShaderCacheDBFile("shader.cacheDBFile", "Shader cache database filename", ".db", CVarFlags::EditReadOnly);
@@ -307,7 +308,8 @@ namespace Hog {
 		return shaderData;
 	}
 
-	ShaderReflection::ReflectionData ShaderReflection::ReflectPipelineLayout(const std::unordered_map<ShaderType, Ref<ShaderSource>>& sources)
+	ShaderReflection::ReflectionData ShaderReflection::ReflectPipelineLayout(const std::unordered_map<ShaderType, Ref<ShaderSource>>& sources, const std::unordered_set<uint32_t>& dynamicBindings,
+		VertexFormat vertexFormat, VertexStream vertexStream)
 	{
 		HG_PROFILE_FUNCTION();
 
@@ -344,6 +346,17 @@ namespace Hog {
 						layoutBinding.descriptorCount *= refl_binding.array.dims[i_dim];
 					}
 					layoutBinding.stageFlags |= static_cast<VkShaderStageFlags>(spvmodule.shader_stage);
+
+					// SPIR-V has no notion of dynamic offsets, the stage decides which buffers get one
+					if (refl_set.set == 0 && dynamicBindings.contains(refl_binding.binding))
+					{
+						switch (layoutBinding.descriptorType)
+						{
+							case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; break;
+							case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC; break;
+							default: break;
+						}
+					}
 				}
 			}
 
@@ -396,11 +409,38 @@ namespace Hog {
 				std::sort(std::begin(data.VertexInputAttributeDescriptions), std::end(data.VertexInputAttributeDescriptions),
 					[](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
 						return a.location < b.location; });
-				// Compute final offsets of each attribute, and total vertex stride.
-				for (auto& attribute : data.VertexInputAttributeDescriptions) {
-					uint32_t format_size = DataType(attribute.format).TypeSize();
-					attribute.offset = bindingDescription.stride;
-					bindingDescription.stride += format_size;
+				if (vertexStream == VertexStream::Position)
+				{
+					bool compact = vertexFormat == VertexFormat::Compact;
+					for (auto& attribute : data.VertexInputAttributeDescriptions)
+					{
+						HG_CORE_ASSERT(attribute.location == 0, "Position stream pipelines can only read the position at location 0");
+						attribute.format = compact ? GetCompactVertexAttributes()[0].format : VK_FORMAT_R32G32B32_SFLOAT;
+						attribute.offset = 0;
+					}
+
+					bindingDescription.stride = compact ? sizeof(CompactVertex::Position) : sizeof(glm::vec3);
+				}
+				else if (vertexFormat == VertexFormat::Compact)
+				{
+					const auto& compactAttributes = GetCompactVertexAttributes();
+					for (auto& attribute : data.VertexInputAttributeDescriptions)
+					{
+						HG_CORE_ASSERT(attribute.location < compactAttributes.size(), "Compact vertices have no attribute at this location");
+						attribute.format = compactAttributes[attribute.location].format;
+						attribute.offset = compactAttributes[attribute.location].offset;
+					}
+
+					bindingDescription.stride = sizeof(CompactVertex);
+				}
+				else
+				{
+					// Compute final offsets of each attribute, and total vertex stride.
+					for (auto& attribute : data.VertexInputAttributeDescriptions) {
+						uint32_t format_size = DataType(attribute.format).TypeSize();
+						attribute.offset = bindingDescription.stride;
+						bindingDescription.stride += format_size;
+					}
 				}
 				// Nothing further is done with attribute_descriptions or binding_description
 				// in this sample. A real application would probably derive this information from its
@@ -416,6 +456,13 @@ namespace Hog {
 
 		for (int i = 0; i < data.DescriptorSetLayoutBinding.size(); ++i)
 		{
+			// Every pipeline shares the global heap layout so the heap set stays compatible across stages
+			if (i == BindlessHeap::SetIndex)
+			{
+				data.DescriptorSetLayouts[i] = BindlessHeap::GetLayout();
+				continue;
+			}
+
 			std::vector<VkDescriptorBindingFlags> bindingFlags(data.DescriptorSetLayoutBinding[i].size(), VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
 
 			VkDescriptorSetLayoutBindingFlagsCreateInfo layoutBindingFlags = {
@@ -82,6 +82,9 @@ namespace Hog {
 			VkPipelineLayout PipelineLayout;
 		};
 	public:
-		static ReflectionData ReflectPipelineLayout(const std::unordered_map<ShaderType, Ref<ShaderSource>>& sources);
+		// Vertex inputs of compact vertex pipelines are mapped to CompactVertex by location, SPIR-V only knows their shader side type.
+		// Position stream pipelines read location 0 from the geometry arena's position buffer
+		static ReflectionData ReflectPipelineLayout(const std::unordered_map<ShaderType, Ref<ShaderSource>>& sources, const std::unordered_set<uint32_t>& dynamicBindings = {},
+			VertexFormat vertexFormat = VertexFormat::Full, VertexStream vertexStream = VertexStream::Interleaved);
 	};
 }
@@ -0,0 +1,381 @@
+#include "hgpch.h"
+#include "StreamingUploader.h"
+
+#include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Utils/RendererUtils.h"
+
+namespace Hog
+{
+	static constexpr VkDeviceSize StagingAlignment = 16;
+
+	void StreamingUploader::InitializeImpl()
+	{
+		m_Device = GraphicsContext::GetDevice();
+		m_GraphicsQueueFamily = GraphicsContext::GetQueueFamily();
+
+		if (GraphicsContext::HasTransferQueue())
+		{
+			m_Queue = GraphicsContext::GetTransferQueue();
+			m_QueueFamily = GraphicsContext::GetTransferQueueFamily();
+			m_OwnershipTransfer = true;
+			m_SharedQueue = false;
+		}
+		else
+		{
+			// The worker shares the graphics queue with the main thread, so submissions to it are serialized
+			m_Queue = GraphicsContext::GetQueue();
+			m_QueueFamily = m_GraphicsQueueFamily;
+			m_OwnershipTransfer = false;
+			m_SharedQueue = true;
+		}
+
+		m_CommandPool = GraphicsContext::CreateCommandPool(m_QueueFamily);
+		m_Timeline = GraphicsContext::CreateTimelineSemaphore();
+		m_NextValue = 1;
+		m_AcquiredValue = 0;
+
+		m_Running = true;
+		m_Thread = std::thread(&StreamingUploader::WorkerLoop, this);
+
+		m_Initialized = true;
+	}
+
+	void StreamingUploader::DeinitializeImpl()
+	{
+		if (m_Thread.joinable())
+		{
+			{
+				std::lock_guard lock(m_Mutex);
+				m_Running = false;
+			}
+
+			// The worker submits whatever is still queued before it exits
+			m_WakeCondition.notify_all();
+			m_Thread.join();
+
+			uint64_t lastValue = m_NextValue - 1;
+			VkSemaphoreWaitInfo waitInfo = {
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+				.semaphoreCount = 1,
+				.pSemaphores = &m_Timeline,
+				.pValues = &lastValue,
+			};
+
+			CheckVkResult(vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX));
+
+			m_Submissions.clear();
+			m_FreeCommandBuffers.clear();
+			vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+			vkDestroySemaphore(m_Device, m_Timeline, nullptr);
+			m_CommandPool = VK_NULL_HANDLE;
+			m_Timeline = VK_NULL_HANDLE;
+		}
+
+		m_Queue = VK_NULL_HANDLE;
+		m_Initialized = false;
+	}
+
+	StreamHandle StreamingUploader::UploadBufferImpl(const Ref<Buffer>& buffer, const void* data, size_t size, size_t bufferOffset)
+	{
+		HG_CORE_ASSERT(m_Initialized, "StreamingUploader used before Renderer::Initialize");
+		HG_CORE_ASSERT(bufferOffset + size <= buffer->GetSize(), "Invalid upload. Tried to write more data then can fit buffer.");
+
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		return Enqueue({ .DstBuffer = buffer, .Data = std::vector<uint8_t>(bytes, bytes + size), .Size = size, .BufferOffset = bufferOffset });
+	}
+
+	StreamHandle StreamingUploader::UploadImageImpl(const Ref<Image>& image, const void* data, size_t size)
+	{
+		HG_CORE_ASSERT(m_Initialized, "StreamingUploader used before Renderer::Initialize");
+
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		return Enqueue({ .DstImage = image, .Data = std::vector<uint8_t>(bytes, bytes + size), .Size = size });
+	}
+
+	StreamHandle StreamingUploader::Enqueue(StreamRequest&& request)
+	{
+		StreamHandle handle;
+
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Requests.push_back(std::move(request));
+			handle.Value = m_NextValue;
+		}
+
+		m_WakeCondition.notify_one();
+
+		return handle;
+	}
+
+	void StreamingUploader::WorkerLoop()
+	{
+		while (true)
+		{
+			std::vector<StreamRequest> requests;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			uint64_t value;
+
+			{
+				std::unique_lock lock(m_Mutex);
+				m_WakeCondition.wait(lock, [this] { return !m_Running || !m_Requests.empty(); });
+
+				if (m_Requests.empty())
+					return;
+
+				// Everything queued so far goes out together and signals the value its handles were given
+				requests.swap(m_Requests);
+				value = m_NextValue++;
+
+				RetireSubmissions();
+				if (!m_FreeCommandBuffers.empty())
+				{
+					commandBuffer = m_FreeCommandBuffers.back();
+					m_FreeCommandBuffers.pop_back();
+				}
+			}
+
+			if (commandBuffer == VK_NULL_HANDLE)
+			{
+				commandBuffer = GraphicsContext::CreateCommandBuffer(m_CommandPool);
+			}
+
+			Submit(commandBuffer, value, std::move(requests));
+		}
+	}
+
+	void StreamingUploader::Submit(VkCommandBuffer commandBuffer, uint64_t value, std::vector<StreamRequest>&& requests)
+	{
+		HG_PROFILE_FUNCTION();
+
+		VkDeviceSize stagingSize = 0;
+		for (const auto& request : requests)
+		{
+			stagingSize = (stagingSize + StagingAlignment - 1) / StagingAlignment * StagingAlignment + request.Size;
+		}
+
+		auto staging = Buffer::Create(BufferDescription::Defaults::TransferSourceBuffer, stagingSize);
+		uint8_t* stagingData = static_cast<uint8_t*>(static_cast<void*>(*staging));
+
+		VkCommandBufferBeginInfo beginInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		};
+
+		CheckVkResult(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+		std::vector<VkImageMemoryBarrier2> imageBarriers;
+
+		VkDeviceSize offset = 0;
+		for (auto& request : requests)
+		{
+			offset = (offset + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+			memcpy(stagingData + offset, request.Data.data(), request.Size);
+
+			// The copy lives in the staging buffer now
+			std::vector<uint8_t>().swap(request.Data);
+
+			if (request.DstBuffer)
+			{
+				VkBufferCopy copy = {
+					.srcOffset = offset,
+					.dstOffset = request.BufferOffset,
+					.size = request.Size,
+				};
+
+				vkCmdCopyBuffer(commandBuffer, staging->GetHandle(), request.DstBuffer->GetHandle(), 1, &copy);
+
+				if (m_OwnershipTransfer && !request.DstBuffer->IsConcurrent())
+				{
+					auto barrier = CreateBufferTransfer(request);
+					barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+					barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+					bufferBarriers.push_back(barrier);
+				}
+			}
+			else
+			{
+				request.DstImage->RecordCopy(commandBuffer, staging->GetHandle(), offset);
+
+				if (m_OwnershipTransfer && !request.DstImage->IsConcurrent())
+				{
+					auto barrier = CreateImageTransfer(request);
+					barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+					barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+					imageBarriers.push_back(barrier);
+				}
+			}
+
+			offset += request.Size;
+		}
+
+		staging->Flush();
+
+		// Release half of the ownership transfers, the renderer records the acquire half
+		if (!bufferBarriers.empty() || !imageBarriers.empty())
+		{
+			VkDependencyInfo dependencyInfo = {
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+				.pBufferMemoryBarriers = bufferBarriers.data(),
+				.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+				.pImageMemoryBarriers = imageBarriers.data(),
+			};
+
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+
+		CheckVkResult(vkEndCommandBuffer(commandBuffer));
+
+		VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = commandBuffer,
+		};
+
+		VkSemaphoreSubmitInfo signalSemaphoreInfo = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = m_Timeline,
+			.value = value,
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		};
+
+		VkSubmitInfo2 submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = &commandBufferSubmitInfo,
+			.signalSemaphoreInfoCount = 1,
+			.pSignalSemaphoreInfos = &signalSemaphoreInfo,
+		};
+
+		if (m_SharedQueue)
+		{
+			std::lock_guard queueLock(GraphicsContext::GetQueueMutex());
+			CheckVkResult(vkQueueSubmit2(m_Queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+		else
+		{
+			// Only this thread submits to the transfer queue
+			CheckVkResult(vkQueueSubmit2(m_Queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+
+		std::lock_guard lock(m_Mutex);
+		m_Submissions.push_back({ value, commandBuffer, staging, std::move(requests) });
+	}
+
+	uint64_t StreamingUploader::RecordAcquiresImpl(VkCommandBuffer commandBuffer)
+	{
+		if (!m_Initialized)
+			return 0;
+
+		std::lock_guard lock(m_Mutex);
+
+		RetireSubmissions();
+
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+		std::vector<VkImageMemoryBarrier2> imageBarriers;
+		std::vector<Ref<Image>> images;
+		uint64_t waitValue = 0;
+
+		for (auto& submission : m_Submissions)
+		{
+			if (submission.Acquired)
+				continue;
+
+			for (const auto& request : submission.Requests)
+			{
+				if (request.DstImage)
+				{
+					images.push_back(request.DstImage);
+
+					if (m_OwnershipTransfer && !request.DstImage->IsConcurrent())
+					{
+						auto barrier = CreateImageTransfer(request);
+						barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+						barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+						imageBarriers.push_back(barrier);
+					}
+				}
+				else if (m_OwnershipTransfer && !request.DstBuffer->IsConcurrent())
+				{
+					auto barrier = CreateBufferTransfer(request);
+					barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+					barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+					bufferBarriers.push_back(barrier);
+				}
+			}
+
+			submission.Acquired = true;
+			waitValue = submission.Value;
+		}
+
+		if (waitValue == 0)
+			return 0;
+
+		if (!bufferBarriers.empty() || !imageBarriers.empty())
+		{
+			VkDependencyInfo dependencyInfo = {
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+				.pBufferMemoryBarriers = bufferBarriers.data(),
+				.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+				.pImageMemoryBarriers = imageBarriers.data(),
+			};
+
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+
+		// Blits need a graphics queue, so the mip chain and the final layout are done here
+		for (const auto& image : images)
+		{
+			image->GenerateMips(commandBuffer);
+		}
+
+		m_AcquiredValue = waitValue;
+
+		return waitValue;
+	}
+
+	void StreamingUploader::RetireSubmissions()
+	{
+		uint64_t value;
+		CheckVkResult(vkGetSemaphoreCounterValue(m_Device, m_Timeline, &value));
+
+		// Staging memory can go once the copy finished and a frame took over the resources
+		while (!m_Submissions.empty() && m_Submissions.front().Acquired && m_Submissions.front().Value <= value)
+		{
+			m_FreeCommandBuffers.push_back(m_Submissions.front().CommandBuffer);
+			m_Submissions.pop_front();
+		}
+	}
+
+	VkBufferMemoryBarrier2 StreamingUploader::CreateBufferTransfer(const StreamRequest& request) const
+	{
+		return {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcQueueFamilyIndex = m_QueueFamily,
+			.dstQueueFamilyIndex = m_GraphicsQueueFamily,
+			.buffer = request.DstBuffer->GetHandle(),
+			.offset = request.BufferOffset,
+			.size = request.Size,
+		};
+	}
+
+	VkImageMemoryBarrier2 StreamingUploader::CreateImageTransfer(const StreamRequest& request) const
+	{
+		return {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.srcQueueFamilyIndex = m_QueueFamily,
+			.dstQueueFamilyIndex = m_GraphicsQueueFamily,
+			.image = request.DstImage->GetHandle(),
+			.subresourceRange = {
+				.aspectMask = request.DstImage->GetDescription().ImageAspectFlags,
+				.baseMipLevel = 0,
+				.levelCount = request.DstImage->GetLevelCount(),
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+	}
+}
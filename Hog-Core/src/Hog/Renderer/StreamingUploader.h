@@ -0,0 +1,113 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+#include "Hog/Renderer/Image.h"
+
+namespace Hog
+{
+	// Transfer timeline value of the submission that carries a streamed upload
+	struct StreamHandle
+	{
+		uint64_t Value = 0;
+	};
+
+	// Uploads buffers and images from any thread without blocking it.
+	// A background thread batches the queued requests into one submission on the dedicated transfer queue, the renderer acquires them at the start of the next frame.
+	// Without a transfer queue the thread submits to the graphics queue instead, holding GraphicsContext::GetQueueMutex.
+	class StreamingUploader
+	{
+	public:
+		static StreamingUploader& Get()
+		{
+			static StreamingUploader instance;
+
+			return instance;
+		}
+
+		~StreamingUploader() { Deinitialize(); }
+		static void Initialize() { if (Get().m_Initialized == false) Get().InitializeImpl(); }
+		static void Deinitialize() { if (Get().m_Initialized == true) Get().DeinitializeImpl(); }
+
+		// Data is copied, the caller's memory can be released as soon as the call returns
+		static StreamHandle UploadBuffer(const Ref<Buffer>& buffer, const void* data, size_t size, size_t bufferOffset = 0) { return Get().UploadBufferImpl(buffer, data, size, bufferOffset); }
+		static StreamHandle UploadImage(const Ref<Image>& image, const void* data, size_t size) { return Get().UploadImageImpl(image, data, size); }
+		// True once a frame acquired the upload, from then on the resource can be used by any stage
+		static bool IsReady(StreamHandle handle) { return handle.Value <= Get().m_AcquiredValue.load(); }
+
+		// Main thread only. Records the graphics queue side of every finished transfer submission and
+		// returns the transfer timeline value the command buffer has to wait on, 0 when there is nothing to wait for
+		static uint64_t RecordAcquires(VkCommandBuffer commandBuffer) { return Get().RecordAcquiresImpl(commandBuffer); }
+		static VkSemaphore GetTimeline() { return Get().m_Timeline; }
+	public:
+		StreamingUploader(StreamingUploader const&) = delete;
+		void operator=(StreamingUploader const&) = delete;
+	private:
+		StreamingUploader() = default;
+
+		void InitializeImpl();
+		void DeinitializeImpl();
+		StreamHandle UploadBufferImpl(const Ref<Buffer>& buffer, const void* data, size_t size, size_t bufferOffset);
+		StreamHandle UploadImageImpl(const Ref<Image>& image, const void* data, size_t size);
+		uint64_t RecordAcquiresImpl(VkCommandBuffer commandBuffer);
+
+		struct StreamRequest
+		{
+			Ref<Buffer> DstBuffer;
+			Ref<Image> DstImage;
+			std::vector<uint8_t> Data;
+			size_t Size = 0;
+			size_t BufferOffset = 0;
+		};
+
+		struct StreamSubmission
+		{
+			uint64_t Value = 0;
+			VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+			Ref<Buffer> Staging;
+			std::vector<StreamRequest> Requests;
+			bool Acquired = false;
+		};
+
+		StreamHandle Enqueue(StreamRequest&& request);
+		void WorkerLoop();
+		void Submit(VkCommandBuffer commandBuffer, uint64_t value, std::vector<StreamRequest>&& requests);
+		void RetireSubmissions();
+		VkBufferMemoryBarrier2 CreateBufferTransfer(const StreamRequest& request) const;
+		VkImageMemoryBarrier2 CreateImageTransfer(const StreamRequest& request) const;
+	private:
+		bool m_Initialized = false;
+		// Uploads run on another queue family, exclusive resources have their ownership released and acquired
+		bool m_OwnershipTransfer = false;
+		// No transfer queue, the worker submits to the graphics queue the main thread also uses
+		bool m_SharedQueue = false;
+
+		VkDevice m_Device = VK_NULL_HANDLE;
+		VkQueue m_Queue = VK_NULL_HANDLE;
+		uint32_t m_QueueFamily = 0;
+		uint32_t m_GraphicsQueueFamily = 0;
+		// Owned by the worker, the main thread only hands retired command buffers back through m_FreeCommandBuffers
+		VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+		VkSemaphore m_Timeline = VK_NULL_HANDLE;
+
+		std::thread m_Thread;
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		bool m_Running = false;
+
+		// Everything below is guarded by m_Mutex
+		std::vector<StreamRequest> m_Requests;
+		// Value the submission carrying the queued requests will signal
+		uint64_t m_NextValue = 1;
+		std::deque<StreamSubmission> m_Submissions;
+		std::vector<VkCommandBuffer> m_FreeCommandBuffers;
+
+		std::atomic<uint64_t> m_AcquiredValue = 0;
+	};
+}
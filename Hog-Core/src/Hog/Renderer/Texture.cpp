@@ -32,7 +32,8 @@ namespace Hog {
 		{
 			samplerInfo.mipmapMode = m_SamplerType.MipMode;
 			samplerInfo.minLod = 0.0f; // Optional
-			samplerInfo.maxLod = static_cast<float>(m_Image->GetLevelCount());
+			// Resized images may come back with more levels
+			samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 			samplerInfo.mipLodBias = 0.0f; // Optional
 		}
 		
@@ -40,10 +41,31 @@ namespace Hog {
 		samplerInfo.maxAnisotropy = GraphicsContext::GetGPUInfo()->DeviceProperties2.properties.limits.maxSamplerAnisotropy;
 
 		CheckVkResult(vkCreateSampler(GraphicsContext::GetDevice(), &samplerInfo, nullptr, &m_Sampler));
+
+		// Transient images get their view once the render graph has bound their memory
+		if (m_Image->GetImageView() != VK_NULL_HANDLE)
+		{
+			GetGPUIndex();
+		}
+	}
+
+	int32_t Texture::GetGPUIndex()
+	{
+		// Resized images come back with a new view, the old slot is released with it
+		if (m_GPUView != m_Image->GetImageView())
+		{
+			BindlessHeap::Release(BindlessType::Texture, m_GPUIndex);
+			m_GPUIndex = BindlessHeap::RegisterTexture(m_Sampler, m_Image->GetImageView());
+			m_GPUView = m_Image->GetImageView();
+		}
+
+		return static_cast<int32_t>(m_GPUIndex);
 	}
 
 	Texture::~Texture()
 	{
+		BindlessHeap::Release(BindlessType::Texture, m_GPUIndex);
+
 		if (m_Sampler)
 			vkDestroySampler(GraphicsContext::GetDevice(), m_Sampler, nullptr);
 	}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Hog/Renderer/Image.h"
+#include "Hog/Renderer/BindlessHeap.h"
 
 namespace Hog {
 
@@ -27,8 +28,7 @@ namespace Hog {
 		VkImageView GetImageView() { return m_Image->GetImageView(); }
 		VkImageLayout GetImageLayout() { return m_Image->GetImageLayout(); }
 		VkFormat GetFormat() const { return m_Image->GetFormat(); }
-		void SetGPUIndex(int32_t ind) { m_GPUIndex = ind; }
-		int32_t GetGPUIndex() const { return m_GPUIndex; }
+		int32_t GetGPUIndex();
 		Ref<Image> GetImage() { return m_Image; }
 		VkSampleCountFlagBits GetSamples() const { return m_Image->GetSamples(); }
 		void ExecuteBarrier(VkCommandBuffer commandBuffer, const BarrierDescription& description) { m_Image->ExecuteBarrier(commandBuffer, description); }
@@ -37,6 +37,7 @@ namespace Hog {
 		Ref<Image> m_Image;
 		VkSampler m_Sampler;
 		SamplerType m_SamplerType;
-		int32_t m_GPUIndex = 0;
+		uint32_t m_GPUIndex = BindlessHeap::InvalidIndex;
+		VkImageView m_GPUView = VK_NULL_HANDLE;
 	};
 }
@@ -114,6 +114,52 @@ namespace Hog
 
 			BufferUsageFlags = VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
 		}break;
+
+		case Defaults::UploadRing:
+		{
+			MemoryUsage = VMA_MEMORY_USAGE_AUTO;
+			AllocationCreateFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+			BufferUsageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			DescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		}break;
+
+		case Defaults::GeometryVertexBuffer:
+		{
+			MemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+			BufferUsageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+				VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+			DescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}break;
+
+		case Defaults::GeometryIndexBuffer:
+		{
+			MemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+			BufferUsageFlags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+				VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+			DescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}break;
+
+		case Defaults::StorageBuffer:
+		{
+			MemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+			BufferUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			DescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}break;
+
+		case Defaults::IndirectBuffer:
+		{
+			MemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+			BufferUsageFlags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			DescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}break;
 		}
 	}
 
@@ -292,6 +338,13 @@ namespace Hog
 				Format = static_cast<VkFormat>(DataType::Defaults::Depth32);
 			}break;
 
+			case Defaults::SampledDepth:
+			{
+				ImageUsageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+				ImageAspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+				Format = static_cast<VkFormat>(DataType::Defaults::Depth32);
+			}break;
+
 			case Defaults::DepthStencil:
 			{
 				ImageUsageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
@@ -375,7 +428,8 @@ namespace Hog
 			case shaderc_glsl_intersection_shader:	Stage = VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
 			case shaderc_glsl_miss_shader:			Stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 			case shaderc_glsl_closesthit_shader:	Stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-			case shaderc_glsl_mesh_shader:			Stage = VK_SHADER_STAGE_MESH_BIT_NV;
+			case shaderc_glsl_task_shader:			Stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+			case shaderc_glsl_mesh_shader:			Stage = VK_SHADER_STAGE_MESH_BIT_EXT;
 		}
 	}
 
@@ -399,7 +453,22 @@ namespace Hog
 			Stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 		if (name == "closesthit")
 			Stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+		if (name == "task")
+			Stage = VK_SHADER_STAGE_TASK_BIT_EXT;
 		if (name == "mesh")
-			Stage = VK_SHADER_STAGE_MESH_BIT_NV;
+			Stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+
+	const std::vector<VkVertexInputAttributeDescription>& GetCompactVertexAttributes()
+	{
+		static const std::vector<VkVertexInputAttributeDescription> attributes = {
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, Position) },
+			{ 1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, TexCoords) },
+			{ 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, Normal) },
+			{ 3, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, Tangent) },
+			{ 4, 0, VK_FORMAT_R16_SINT, offsetof(CompactVertex, MaterialIndex) },
+		};
+
+		return attributes;
 	}
-};
\ No newline at end of file
+};
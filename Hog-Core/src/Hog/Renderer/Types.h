@@ -283,6 +283,38 @@ namespace Hog
 		int32_t MaterialIndex;
 	};
 
+	enum class VertexFormat
+	{
+		// Vertex
+		Full,
+		// CompactVertex
+		Compact,
+	};
+
+	// Vertex buffer a graphics pipeline reads
+	enum class VertexStream
+	{
+		// Every attribute of the vertex format, interleaved
+		Interleaved,
+		// Just the positions, for depth only and shadow passes. Vertex shaders may only declare location 0
+		Position,
+	};
+
+	// Opt-in 24 byte layout of Vertex. Position is snorm16 relative to the primitive's position bounds with the tangent
+	// sign in w, normal and tangent are octahedral snorm16, texture coordinates are half floats
+	struct CompactVertex
+	{
+		int16_t Position[4];
+		uint16_t TexCoords[2];
+		int16_t Normal[2];
+		int16_t Tangent[2];
+		int16_t MaterialIndex;
+		int16_t Padding;
+	};
+
+	// Attribute of every CompactVertex member indexed by shader location, compact vertex shaders may declare a subset
+	const std::vector<VkVertexInputAttributeDescription>& GetCompactVertexAttributes();
+
 	struct BufferDescription
 	{
 		enum class Defaults
@@ -299,6 +331,11 @@ namespace Hog
 			AccelerationStructure,
 			AccelerationStructureScratchBuffer,
 			ShaderBindingTable,
+			UploadRing,
+			GeometryVertexBuffer,
+			GeometryIndexBuffer,
+			StorageBuffer,
+			IndirectBuffer,
 		};
 
 		VmaMemoryUsage MemoryUsage = VMA_MEMORY_USAGE_AUTO;
@@ -313,6 +350,7 @@ namespace Hog
 		VkDescriptorType DescriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
 		operator VkDescriptorType() const { return DescriptorType; }
 
+		// Concurrent buffers are shared by every queue family, async compute stages may only use those
 		VkSharingMode SharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		operator VkSharingMode() const { return SharingMode; }
 
@@ -378,6 +416,7 @@ namespace Hog
 		enum class Defaults
 		{
 			Depth,
+			SampledDepth,
 			DepthStencil,
 			ShadowMap,
 			RenderTarget,
@@ -408,6 +447,9 @@ namespace Hog
 		VkImageLayout ImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		operator VkImageLayout() const { return ImageLayout; }
 
+		// Concurrent images are shared by every queue family, async compute stages may only use those
+		VkSharingMode SharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
 		ImageDescription() = default;
 		ImageDescription(Defaults options);
 	};
@@ -425,8 +467,10 @@ namespace Hog
 			Intersection		= VK_SHADER_STAGE_INTERSECTION_BIT_KHR,
 			Miss				= VK_SHADER_STAGE_MISS_BIT_KHR,
 			ClosestHit			= VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-			Mesh				= VK_SHADER_STAGE_MESH_BIT_NV,
+			Task				= VK_SHADER_STAGE_TASK_BIT_EXT,
+			Mesh				= VK_SHADER_STAGE_MESH_BIT_EXT,
 			CombinedFragVert	= VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+			CombinedTaskMesh	= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
 			CombinedRaygenClosestHit = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
 		};
 
@@ -452,7 +496,8 @@ namespace Hog
 				case VK_SHADER_STAGE_INTERSECTION_BIT_KHR:	return shaderc_glsl_intersection_shader;
 				case VK_SHADER_STAGE_MISS_BIT_KHR:			return shaderc_glsl_miss_shader;
 				case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:	return shaderc_glsl_closesthit_shader;
-				case VK_SHADER_STAGE_MESH_BIT_NV:			return shaderc_glsl_mesh_shader;
+				case VK_SHADER_STAGE_TASK_BIT_EXT:			return shaderc_glsl_task_shader;
+				case VK_SHADER_STAGE_MESH_BIT_EXT:			return shaderc_glsl_mesh_shader;
 			}
 
 			return (shaderc_shader_kind)0;
@@ -471,7 +516,8 @@ namespace Hog
 				case VK_SHADER_STAGE_INTERSECTION_BIT_KHR:	return "intersection";
 				case VK_SHADER_STAGE_MISS_BIT_KHR:			return "miss";
 				case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:	return "closesthit";
-				case VK_SHADER_STAGE_MESH_BIT_NV:			return "mesh";
+				case VK_SHADER_STAGE_TASK_BIT_EXT:			return "task";
+				case VK_SHADER_STAGE_MESH_BIT_EXT:			return "mesh";
 			}
 
 			return "";
@@ -491,12 +537,17 @@ namespace Hog
 
 	enum class ResourceType
 	{
-		Uniform, Constant, PushConstant, Storage, StorageImage, Sampler, SamplerArray, AccelerationStructure
+		Uniform, Constant, PushConstant, Storage, StorageImage, Sampler, AccelerationStructure, DynamicUniform, DynamicStorage
 	};
 
 	enum class RendererStageType
 	{
-		ForwardCompute, DeferredCompute, ForwardGraphics, DeferredGraphics, Blit, ImGui, Barrier, ScreenSpacePass, RayTracing
+		ForwardCompute, DeferredCompute, ForwardGraphics, DeferredGraphics, Blit, ImGui, Barrier, ScreenSpacePass, RayTracing, DepthPyramid
+	};
+
+	enum class QueueType
+	{
+		Graphics = 0, Compute = 1, Count
 	};
 
 	static inline VkPipelineBindPoint ToPipelineBindPoint(RendererStageType type)
@@ -509,6 +560,9 @@ namespace Hog
 			case RendererStageType::DeferredGraphics:	return VK_PIPELINE_BIND_POINT_GRAPHICS;
 			case RendererStageType::Blit:				return VK_PIPELINE_BIND_POINT_GRAPHICS;
 			case RendererStageType::ImGui:				return VK_PIPELINE_BIND_POINT_GRAPHICS;
+			case RendererStageType::ScreenSpacePass:	return VK_PIPELINE_BIND_POINT_GRAPHICS;
+			case RendererStageType::RayTracing:			return VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR;
+			case RendererStageType::DepthPyramid:		return VK_PIPELINE_BIND_POINT_COMPUTE;
 		}
 
 		return (VkPipelineBindPoint)0;
@@ -663,6 +717,27 @@ namespace Hog
 		return VK_ACCESS_2_NONE;
 	}
 
+	static inline VkPipelineStageFlags2 ToPipelineStageFlags2(VkShaderStageFlags stages)
+	{
+		VkPipelineStageFlags2 result = VK_PIPELINE_STAGE_2_NONE;
+
+		if (stages & VK_SHADER_STAGE_VERTEX_BIT)					result |= VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT)		result |= VK_PIPELINE_STAGE_2_TESSELLATION_CONTROL_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT)	result |= VK_PIPELINE_STAGE_2_TESSELLATION_EVALUATION_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_GEOMETRY_BIT)					result |= VK_PIPELINE_STAGE_2_GEOMETRY_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_FRAGMENT_BIT)					result |= VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_COMPUTE_BIT)					result |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		if (stages & VK_SHADER_STAGE_TASK_BIT_EXT)					result |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT;
+		if (stages & VK_SHADER_STAGE_MESH_BIT_EXT)					result |= VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+		if (stages & (VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+			VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_INTERSECTION_BIT_KHR | VK_SHADER_STAGE_CALLABLE_BIT_KHR))
+		{
+			result |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+		}
+
+		return result;
+	}
+
 	struct BarrierDescription
 	{
 		enum class Defaults
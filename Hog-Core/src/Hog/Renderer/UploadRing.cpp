@@ -0,0 +1,105 @@
+#include "hgpch.h"
+#include "UploadRing.h"
+
+#include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Core/CVars.h"
+
+AutoCVar_Int CVar_UploadRingSize("renderer.uploadRingSize", "Bytes of per frame shader data each frame in flight can allocate from the upload ring", 4 * 1024 * 1024, CVarFlags::EditReadOnly);
+
+namespace Hog
+{
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void UploadRing::InitializeImpl(uint32_t frameCount)
+	{
+		const auto& limits = GraphicsContext::GetGPUInfo()->DeviceProperties2.properties.limits;
+
+		m_Alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+		m_SegmentSize = AlignUp(static_cast<VkDeviceSize>(CVar_UploadRingSize.Get()), m_Alignment);
+		m_Buffer = Buffer::Create(BufferDescription::Defaults::UploadRing, m_SegmentSize * frameCount);
+
+		m_Begin = 0;
+		m_Head = 0;
+		m_Flushed = 0;
+		m_FrameCount = 0;
+
+		m_Initialized = true;
+	}
+
+	void UploadRing::DeinitializeImpl()
+	{
+		m_Buffer.reset();
+
+		m_Initialized = false;
+	}
+
+	UploadAllocation UploadRing::AllocateImpl(VkDeviceSize size)
+	{
+		VkDeviceSize offset = AlignUp(m_Head, m_Alignment);
+		HG_CORE_ASSERT(offset + size <= m_Begin + m_SegmentSize, "Upload ring segment is full, raise renderer.uploadRingSize");
+
+		m_Head = offset + size;
+
+		return { static_cast<uint8_t*>(static_cast<void*>(*m_Buffer)) + offset, offset, size };
+	}
+
+	VkDeviceSize UploadRing::GetAvailableImpl() const
+	{
+		VkDeviceSize offset = AlignUp(m_Head, m_Alignment);
+		VkDeviceSize end = m_Begin + m_SegmentSize;
+
+		return offset < end ? end - offset : 0;
+	}
+
+	void UploadRing::BeginFrameImpl(uint32_t frameIndex)
+	{
+		m_Begin = m_SegmentSize * frameIndex;
+		m_Head = m_Begin;
+		m_Flushed = m_Begin;
+		m_FrameCount++;
+	}
+
+	void UploadRing::FlushImpl()
+	{
+		if (m_Head == m_Flushed)
+			return;
+
+		m_Buffer->Flush(m_Flushed, m_Head - m_Flushed);
+		m_Flushed = m_Head;
+	}
+
+	Ref<DynamicBuffer> DynamicBuffer::Create(size_t size)
+	{
+		return CreateRef<DynamicBuffer>(size);
+	}
+
+	DynamicBuffer::DynamicBuffer(size_t size)
+		: m_Data(size)
+	{
+	}
+
+	void DynamicBuffer::WriteData(const void* data, size_t size, size_t bufferOffset)
+	{
+		HG_CORE_ASSERT(bufferOffset + size <= m_Data.size(), "Invalid write command. Tried to write more data then can fit buffer.");
+
+		std::memcpy(m_Data.data() + bufferOffset, data, size);
+		m_Frame = UINT64_MAX;
+	}
+
+	uint32_t DynamicBuffer::GetOffset()
+	{
+		if (m_Frame != UploadRing::GetFrame())
+		{
+			UploadAllocation allocation = UploadRing::Allocate(m_Data.size());
+			std::memcpy(allocation.Data, m_Data.data(), m_Data.size());
+
+			m_Offset = static_cast<uint32_t>(allocation.Offset);
+			m_Frame = UploadRing::GetFrame();
+		}
+
+		return m_Offset;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <volk.h>
+
+#include "Hog/Renderer/Buffer.h"
+
+namespace Hog
+{
+	struct UploadAllocation
+	{
+		void* Data = nullptr;
+		VkDeviceSize Offset = 0;
+		VkDeviceSize Size = 0;
+	};
+
+	// Persistently mapped buffer split into one segment per frame in flight.
+	// Allocations are linear and stay valid until the segment is reused, which only happens once that frame's fence signaled.
+	class UploadRing
+	{
+	public:
+		static UploadRing& Get()
+		{
+			static UploadRing instance;
+
+			return instance;
+		}
+
+		~UploadRing() { Deinitialize(); }
+		static void Initialize(uint32_t frameCount) { if (Get().m_Initialized == false) Get().InitializeImpl(frameCount); }
+		static void Deinitialize() { if (Get().m_Initialized == true) Get().DeinitializeImpl(); }
+
+		static UploadAllocation Allocate(VkDeviceSize size) { return Get().AllocateImpl(size); }
+		static void BeginFrame(uint32_t frameIndex) { Get().BeginFrameImpl(frameIndex); }
+		static void Flush() { Get().FlushImpl(); }
+
+		static VkBuffer GetBuffer() { return Get().m_Buffer->GetHandle(); }
+		// Largest allocation the current frame's segment still fits
+		static VkDeviceSize GetAvailable() { return Get().GetAvailableImpl(); }
+		// Frame in flight whose segment is current
+		static uint32_t GetFrameIndex() { return static_cast<uint32_t>(Get().m_Begin / Get().m_SegmentSize); }
+		static uint64_t GetFrame() { return Get().m_FrameCount; }
+	public:
+		UploadRing(UploadRing const&) = delete;
+		void operator=(UploadRing const&) = delete;
+	private:
+		UploadRing() = default;
+
+		void InitializeImpl(uint32_t frameCount);
+		void DeinitializeImpl();
+		UploadAllocation AllocateImpl(VkDeviceSize size);
+		VkDeviceSize GetAvailableImpl() const;
+		void BeginFrameImpl(uint32_t frameIndex);
+		void FlushImpl();
+	private:
+		bool m_Initialized = false;
+
+		Ref<Buffer> m_Buffer;
+		VkDeviceSize m_SegmentSize = 0;
+		VkDeviceSize m_Alignment = 1;
+		// Bounds of the current frame's segment, absolute offsets into the buffer
+		VkDeviceSize m_Begin = 0;
+		VkDeviceSize m_Head = 0;
+		VkDeviceSize m_Flushed = 0;
+		uint64_t m_FrameCount = 0;
+	};
+
+	// Per frame shader data bound through a dynamic uniform or storage buffer descriptor.
+	// Writes go to a CPU copy that is placed into the ring the first time a frame binds it, so the frame the GPU still reads is never touched.
+	class DynamicBuffer
+	{
+	public:
+		static Ref<DynamicBuffer> Create(size_t size);
+	public:
+		DynamicBuffer(size_t size);
+
+		void WriteData(const void* data, size_t size, size_t bufferOffset = 0);
+
+		// Offset of this frame's copy inside UploadRing::GetBuffer()
+		uint32_t GetOffset();
+		size_t GetSize() const { return m_Data.size(); }
+		const void* GetData() const { return m_Data.data(); }
+	private:
+		std::vector<uint8_t> m_Data;
+		uint32_t m_Offset = 0;
+		uint64_t m_Frame = UINT64_MAX;
+	};
+}
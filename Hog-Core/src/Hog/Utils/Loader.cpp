@@ -10,11 +10,85 @@
 
 #include "Hog/Debug/Instrumentor.h"
 #include "Hog/Math/Math.h"
+#include "Hog/Renderer/GraphicsContext.h"
+#include "Hog/Utils/MeshOptimizer.h"
 
 namespace Hog
 {
 	namespace Util
 	{
+		// Sums the face normals around every vertex, the cross product's length weights each face by its area
+		static void GenerateNormals(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, bool swappedWinding, std::vector<glm::vec3>& normals)
+		{
+			normals.assign(positions.size(), glm::vec3(0.0f));
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				const glm::vec3& a = positions[indices[i + 0]];
+				const glm::vec3& b = positions[indices[i + 1]];
+				const glm::vec3& c = positions[indices[i + 2]];
+
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				normals[indices[i + 0]] += normal;
+				normals[indices[i + 1]] += normal;
+				normals[indices[i + 2]] += normal;
+			}
+
+			// The indices are already reversed when the front face is swapped, glTF faces are counter clockwise
+			float sign = swappedWinding ? -1.0f : 1.0f;
+			for (auto& normal : normals)
+			{
+				float length = glm::length(normal);
+				normal = length > 0.0f ? normal * (sign / length) : glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+		}
+
+		// Tangents follow the texture coordinate gradients of the surrounding faces, w is the handedness glTF expects.
+		// Without texture coordinates any direction perpendicular to the normal is as good as another
+		static void GenerateTangents(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texcoords,
+			const std::vector<uint32_t>& indices, std::vector<glm::vec4>& tangents)
+		{
+			std::vector<glm::vec3> directions(positions.size(), glm::vec3(0.0f));
+			std::vector<glm::vec3> bitangents(positions.size(), glm::vec3(0.0f));
+			for (size_t i = 0; i + 2 < indices.size() && texcoords.size() >= positions.size(); i += 3)
+			{
+				uint32_t a = indices[i + 0];
+				uint32_t b = indices[i + 1];
+				uint32_t c = indices[i + 2];
+
+				glm::vec3 edge1 = positions[b] - positions[a];
+				glm::vec3 edge2 = positions[c] - positions[a];
+				glm::vec2 delta1 = texcoords[b] - texcoords[a];
+				glm::vec2 delta2 = texcoords[c] - texcoords[a];
+
+				float determinant = delta1.x * delta2.y - delta2.x * delta1.y;
+				if (determinant == 0.0f)
+					continue;
+
+				glm::vec3 direction = (edge1 * delta2.y - edge2 * delta1.y) / determinant;
+				glm::vec3 bitangent = (edge2 * delta1.x - edge1 * delta2.x) / determinant;
+				for (uint32_t vertex : { a, b, c })
+				{
+					directions[vertex] += direction;
+					bitangents[vertex] += bitangent;
+				}
+			}
+
+			tangents.resize(positions.size());
+			for (size_t i = 0; i < positions.size(); i++)
+			{
+				const glm::vec3& normal = normals[i];
+				glm::vec3 direction = directions[i] - normal * glm::dot(normal, directions[i]);
+				if (glm::length(direction) == 0.0f)
+				{
+					direction = glm::cross(normal, glm::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+				}
+
+				direction = glm::normalize(direction);
+				float handedness = glm::dot(glm::cross(normal, direction), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+				tangents[i] = glm::vec4(direction, handedness);
+			}
+		}
+
 		bool Loader::LoadGltf(const std::string& filepath, Options options, std::vector<Ref<Mesh>>& opaque,
 			std::vector<Ref<Mesh>>& transparent, std::unordered_map<std::string, Camera>& cameras,
 			std::vector<Ref<Texture>>& textures, std::vector<Ref<Material>>& materials, Ref<Buffer>& materialBuffer,
@@ -31,6 +105,17 @@ namespace Hog
 				return false;
 			}
 
+			// KHR_mesh_quantization stores attributes as normalized or plain integers,
+			// cgltf_accessor_unpack_floats converts them so they load like float attributes
+			static const std::unordered_set<std::string> supportedExtensions = { "KHR_mesh_quantization", "KHR_lights_punctual" };
+			for (cgltf_size i = 0; i < data->extensions_required_count; ++i)
+			{
+				if (!supportedExtensions.contains(data->extensions_required[i]))
+				{
+					HG_CORE_WARN("{} requires unsupported glTF extension {}", filepath, data->extensions_required[i]);
+				}
+			}
+
 			// Extract name from filepath
 			auto path = std::filesystem::path(filepath);
 			auto currentPath = std::filesystem::current_path();
@@ -46,6 +131,9 @@ namespace Hog
 				}
 			}
 
+			// Every texture, mesh and material upload below goes out in a single submission
+			UploadScope uploadScope;
+
 			std::vector<Ref<Image>> images(data->images_count);
 
 			for (int i = 0; i < data->images_count; i++)
@@ -97,10 +185,7 @@ namespace Hog
 					case 10497: type.AddressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT; break;
 				}
 
-				Ref<Texture> textureRef = Texture::Create(images[texture->image - data->images], type);
-				textureRef->SetGPUIndex(initialSize + i);
-
-				textures.push_back(textureRef);
+				textures.push_back(Texture::Create(images[texture->image - data->images], type));
 			}
 
 			materialBuffer = Buffer::Create(BufferDescription::Defaults::UniformBuffer, sizeof(MaterialGPUData) * data->materials_count);
@@ -118,12 +203,12 @@ namespace Hog
 
 				if (material->pbr_metallic_roughness.base_color_texture.texture)
 				{
-					matData.DiffuseTexture = textures[material->pbr_metallic_roughness.base_color_texture.texture - data->textures];
+					matData.DiffuseTexture = textures[initialSize + (material->pbr_metallic_roughness.base_color_texture.texture - data->textures)];
 				}
 
 				if (material->normal_texture.texture)
 				{
-					matData.BumpMap = textures[material->normal_texture.texture - data->textures];
+					matData.BumpMap = textures[initialSize + (material->normal_texture.texture - data->textures)];
 				}
 
 				materials.push_back(Material::Create(material->name, matData));
@@ -135,6 +220,18 @@ namespace Hog
 			lightBuffer = Buffer::Create(BufferDescription::Defaults::UniformBuffer, sizeof(LightData) * data->lights_count);
 			size_t lightOffset = 0;
 
+			// Geometry is loaded once per glTF mesh, every further node referencing it only adds an instance.
+			// Its primitives go into one Mesh per alpha mode, so those sharing a material are merged when it is built
+			struct NodeMeshes
+			{
+				Ref<Mesh> Opaque;
+				Ref<Mesh> Transparent;
+			};
+			std::unordered_map<const cgltf_mesh*, NodeMeshes> gltfMeshes;
+			std::vector<Ref<Mesh>> loadedMeshes;
+			MeshOptimizer::Statistics statisticsBefore;
+			MeshOptimizer::Statistics statisticsAfter;
+
 			for (int i = 0; i < data->nodes_count; ++i)
 			{
 				const auto node = &(data->nodes[i]);
@@ -174,24 +271,36 @@ namespace Hog
 					}
 				}
 
-				if (node->mesh)
+				auto instanced = node->mesh ? gltfMeshes.find(node->mesh) : gltfMeshes.end();
+				if (instanced != gltfMeshes.end())
+				{
+					for (const auto& nodeMesh : { instanced->second.Opaque, instanced->second.Transparent })
+					{
+						if (nodeMesh)
+						{
+							nodeMesh->AddInstance(modelMat);
+						}
+					}
+				}
+				else if (node->mesh)
 				{
 					const auto mesh = node->mesh;
+					auto& nodeMeshes = gltfMeshes[mesh];
 					for (int j = 0; j < mesh->primitives_count; ++j)
 					{
 						const auto primitive = &(mesh->primitives[j]);
 
-						auto nodeMesh = Mesh::Create(node->name);
-						if (primitive->material->alpha_mode == cgltf_alpha_mode_opaque)
-						{
-							opaque.push_back(nodeMesh);
-						}
-						else
+						bool isOpaque = !primitive->material || primitive->material->alpha_mode == cgltf_alpha_mode_opaque;
+						auto& nodeMesh = isOpaque ? nodeMeshes.Opaque : nodeMeshes.Transparent;
+						if (!nodeMesh)
 						{
-							transparent.push_back(nodeMesh);
+							nodeMesh = Mesh::Create(node->name);
+							nodeMesh->SetModelMatrix(modelMat);
+							loadedMeshes.push_back(nodeMesh);
+							(isOpaque ? opaque : transparent).push_back(nodeMesh);
 						}
 
-						std::vector<uint16_t> indexData;
+						std::vector<uint32_t> indexData;
 						std::vector<Vertex> vertexData;
 
 						indexData.resize(primitive->indices->count);
@@ -199,15 +308,15 @@ namespace Hog
 						{
 							if (options.SwapFrontFace)
 							{
-								indexData[z + 2] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z));
-								indexData[z + 1] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z + 1));
-								indexData[z + 0] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z + 2));
+								indexData[z + 2] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z));
+								indexData[z + 1] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z + 1));
+								indexData[z + 0] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z + 2));
 							}
 							else
 							{
-								indexData[z + 0] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z));
-								indexData[z + 1] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z + 1));
-								indexData[z + 2] = static_cast<uint16_t>(cgltf_accessor_read_index(primitive->indices, z + 2));
+								indexData[z + 0] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z));
+								indexData[z + 1] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z + 1));
+								indexData[z + 2] = static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, z + 2));
 							}
 						}
 
@@ -258,11 +367,23 @@ namespace Hog
 							}
 						}
 
+						// Quantized files often leave out attributes the material does not need
+						if (normals.size() < positions.size())
+						{
+							HG_CORE_WARN("{}: primitive of mesh {} has no normals, generating them from its triangles", path.filename().string(), mesh->name ? mesh->name : "");
+							GenerateNormals(positions, indexData, options.SwapFrontFace, normals);
+						}
+
+						if (tangent.size() < positions.size())
+						{
+							GenerateTangents(positions, normals, texcoords, indexData, tangent);
+						}
+
 						for (int z = 0; z < vertexData.size(); ++z)
 						{
 							vertexData[z].Position = positions[z];
 							vertexData[z].Normal = normals[z];
-							vertexData[z].TexCoords = texcoords[z];
+							vertexData[z].TexCoords = z < texcoords.size() ? texcoords[z] : glm::vec2(0.0f);
 							vertexData[z].Tangent = tangent[z];
 
 							if (primitive->material)
@@ -271,9 +392,16 @@ namespace Hog
 							}
 						}
 
+						if (options.OptimizeMeshes)
+						{
+							MeshOptimizer::Statistics before;
+							MeshOptimizer::Statistics after;
+							MeshOptimizer::Optimize(vertexData, indexData, {}, &before, &after);
+							statisticsBefore += before;
+							statisticsAfter += after;
+						}
+
 						nodeMesh->AddPrimitive(vertexData, indexData);
-						nodeMesh->Build();
-						nodeMesh->SetModelMatrix(modelMat);
 					}
 				}
 
@@ -308,7 +436,7 @@ namespace Hog
 					std::vector<glm::vec3> frustrumCorners;
 					Math::CalculateFrustrumCorners(frustrumCorners, projection);
 
-					std::vector<uint16_t> indexData = {
+					std::vector<uint32_t> indexData = {
 						7, 6, 5,
 						4, 7, 5,
 
@@ -372,6 +500,18 @@ namespace Hog
 				}
 			}
 
+			if (options.OptimizeMeshes)
+			{
+				HG_CORE_INFO("Optimized meshes of {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", path.filename().string(),
+					statisticsBefore.ACMR(), statisticsAfter.ACMR(), statisticsBefore.ATVR(), statisticsAfter.ATVR());
+			}
+
+			// Built once all instances are known, so the transforms go into the scene buffer with the initial upload
+			for (const auto& mesh : loadedMeshes)
+			{
+				mesh->Build();
+			}
+
 			std::filesystem::current_path(currentPath);
 			cgltf_free(data);
 			return true;
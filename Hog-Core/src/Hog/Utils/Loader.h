@@ -17,6 +17,8 @@ namespace Hog
 			{
 				bool SwapFrontFace = false;
 				bool FlipYPosition = false;
+				// Welds and reorders every primitive for the vertex cache, overdraw and vertex fetch
+				bool OptimizeMeshes = true;
 			};
 
 		public:
@@ -0,0 +1,678 @@
+#include "hgpch.h"
+#include "MeshOptimizer.h"
+
+#include <string_view>
+
+#include <glm/glm.hpp>
+
+namespace Hog
+{
+	namespace Util
+	{
+		namespace
+		{
+			constexpr uint32_t InvalidVertex = UINT32_MAX;
+
+			// FIFO post transform cache, a vertex is cached while fewer than size vertices were inserted after it
+			class VertexCache
+			{
+			public:
+				VertexCache(size_t vertexCount, uint32_t size)
+					: m_Timestamps(vertexCount, 0), m_Size(size), m_Time(size + 1)
+				{
+				}
+
+				// Returns whether the vertex had to be transformed
+				bool Access(uint32_t vertex)
+				{
+					if (m_Time - m_Timestamps[vertex] <= m_Size)
+						return false;
+
+					m_Timestamps[vertex] = m_Time++;
+					return true;
+				}
+
+				uint32_t AccessTriangle(const std::vector<uint32_t>& indices, size_t triangle)
+				{
+					return Access(indices[triangle * 3 + 0]) + Access(indices[triangle * 3 + 1]) + Access(indices[triangle * 3 + 2]);
+				}
+
+				// Evicts every vertex
+				void Flush() { m_Time += m_Size + 1; }
+			private:
+				std::vector<uint32_t> m_Timestamps;
+				uint32_t m_Size;
+				uint32_t m_Time;
+			};
+
+			// Sum of squared distances to a set of planes, kept as the upper triangle of the symmetric 4x4 matrix
+			struct Quadric
+			{
+				double A00 = 0.0, A01 = 0.0, A02 = 0.0, A03 = 0.0;
+				double A11 = 0.0, A12 = 0.0, A13 = 0.0;
+				double A22 = 0.0, A23 = 0.0;
+				double A33 = 0.0;
+				// Summed plane weights, dividing by it turns the error into a mean squared distance
+				double Weight = 0.0;
+
+				// Plane dot(normal, p) + d = 0 with a unit normal
+				void AddPlane(const glm::vec3& normal, float d, float weight)
+				{
+					double a = normal.x, b = normal.y, c = normal.z;
+
+					A00 += weight * a * a; A01 += weight * a * b; A02 += weight * a * c; A03 += weight * a * d;
+					A11 += weight * b * b; A12 += weight * b * c; A13 += weight * b * d;
+					A22 += weight * c * c; A23 += weight * c * d;
+					A33 += weight * d * d;
+					Weight += weight;
+				}
+
+				Quadric& operator+=(const Quadric& other)
+				{
+					A00 += other.A00; A01 += other.A01; A02 += other.A02; A03 += other.A03;
+					A11 += other.A11; A12 += other.A12; A13 += other.A13;
+					A22 += other.A22; A23 += other.A23;
+					A33 += other.A33;
+					Weight += other.Weight;
+					return *this;
+				}
+
+				double Evaluate(const glm::vec3& p) const
+				{
+					double x = p.x, y = p.y, z = p.z;
+					double error = A00 * x * x + A11 * y * y + A22 * z * z + A33
+						+ 2.0 * (A01 * x * y + A02 * x * z + A03 * x + A12 * y * z + A13 * y + A23 * z);
+
+					// Rounding can push a zero error slightly below
+					return Weight > 0.0 ? std::max(error, 0.0) / Weight : 0.0;
+				}
+			};
+
+			uint64_t EdgeKey(uint32_t a, uint32_t b)
+			{
+				return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+			}
+
+			// Index of the corner following corner i in its triangle
+			size_t NextCorner(size_t i)
+			{
+				return i - i % 3 + (i + 1) % 3;
+			}
+		}
+
+		void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const Options& options,
+			Statistics* before, Statistics* after)
+		{
+			HG_PROFILE_FUNCTION();
+
+			if (before)
+			{
+				*before = AnalyzeVertexCache(indices, vertices.size(), options.CacheSize);
+			}
+
+			if (options.WeldVertices)
+			{
+				WeldVertices(vertices, indices);
+			}
+
+			if (options.OptimizeVertexCache)
+			{
+				OptimizeVertexCache(indices, vertices.size(), options.CacheSize);
+			}
+
+			if (options.OptimizeOverdraw)
+			{
+				OptimizeOverdraw(indices, vertices, options.CacheSize, options.OverdrawThreshold);
+			}
+
+			if (options.OptimizeVertexFetch)
+			{
+				OptimizeVertexFetch(vertices, indices);
+			}
+
+			if (after)
+			{
+				*after = AnalyzeVertexCache(indices, vertices.size(), options.CacheSize);
+			}
+		}
+
+		void MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			static_assert(sizeof(Vertex) == 2 * sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec4) + sizeof(int32_t),
+				"Vertices are compared bitwise, they must not contain padding");
+
+			// Keys point into the source vertices, which stay untouched until the end
+			std::unordered_map<std::string_view, uint32_t> unique;
+			unique.reserve(vertices.size());
+
+			std::vector<Vertex> welded;
+			welded.reserve(vertices.size());
+
+			std::vector<uint32_t> remap(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				std::string_view key(reinterpret_cast<const char*>(&vertices[i]), sizeof(Vertex));
+
+				auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(welded.size()));
+				if (inserted)
+				{
+					welded.push_back(vertices[i]);
+				}
+
+				remap[i] = it->second;
+			}
+
+			if (welded.size() == vertices.size())
+				return;
+
+			for (auto& index : indices)
+			{
+				index = remap[index];
+			}
+
+			vertices = std::move(welded);
+		}
+
+		void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+		{
+			HG_PROFILE_FUNCTION();
+
+			size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0)
+				return;
+
+			// Triangles around every vertex, in compressed rows
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (uint32_t index : indices)
+			{
+				liveTriangles[index]++;
+			}
+
+			std::vector<uint32_t> offsets(vertexCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				offsets[v + 1] = offsets[v] + liveTriangles[v];
+			}
+
+			std::vector<uint32_t> adjacency(indices.size());
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+				}
+			}
+
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnd;
+			std::vector<uint32_t> candidates;
+			std::vector<uint32_t> result;
+			result.reserve(indices.size());
+
+			uint32_t cursor = 0;
+			uint32_t fanning = indices[0];
+			while (fanning != InvalidVertex)
+			{
+				// Emit every remaining triangle around the fanning vertex
+				candidates.clear();
+				for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+				{
+					uint32_t triangle = adjacency[a];
+					if (emitted[triangle])
+						continue;
+
+					for (size_t k = 0; k < 3; k++)
+					{
+						uint32_t vertex = indices[triangle * 3 + k];
+						result.push_back(vertex);
+						deadEnd.push_back(vertex);
+						candidates.push_back(vertex);
+						liveTriangles[vertex]--;
+
+						if (time - timestamps[vertex] > cacheSize)
+						{
+							timestamps[vertex] = time++;
+						}
+					}
+
+					emitted[triangle] = true;
+				}
+
+				// Continue with the candidate that entered the cache first, as long as it is still cached after its own fan
+				uint32_t next = InvalidVertex;
+				int64_t bestPriority = -1;
+				for (uint32_t vertex : candidates)
+				{
+					if (liveTriangles[vertex] == 0)
+						continue;
+
+					int64_t priority = 0;
+					if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+					{
+						priority = time - timestamps[vertex];
+					}
+
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						next = vertex;
+					}
+				}
+
+				// Dead end, fall back to recently used vertices and then to the input order
+				while (next == InvalidVertex && !deadEnd.empty())
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+
+					if (liveTriangles[vertex] > 0)
+					{
+						next = vertex;
+					}
+				}
+
+				while (next == InvalidVertex && cursor < vertexCount)
+				{
+					if (liveTriangles[cursor] > 0)
+					{
+						next = cursor;
+					}
+
+					cursor++;
+				}
+
+				fanning = next;
+			}
+
+			indices = std::move(result);
+		}
+
+		void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, uint32_t cacheSize, float threshold)
+		{
+			HG_PROFILE_FUNCTION();
+
+			size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0)
+				return;
+
+			VertexCache cache(vertices.size(), cacheSize);
+
+			// Triangles missing all three vertices start with a cold cache anyway, so moving them costs nothing
+			std::vector<size_t> hardClusters;
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				if (cache.AccessTriangle(indices, t) == 3 || t == 0)
+				{
+					hardClusters.push_back(t);
+				}
+			}
+
+			// Splits the hard clusters further wherever the part so far stays within threshold of the cluster's own ACMR
+			std::vector<size_t> clusters;
+			for (size_t c = 0; c < hardClusters.size(); c++)
+			{
+				size_t start = hardClusters[c];
+				size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+
+				cache.Flush();
+				uint32_t clusterMisses = 0;
+				for (size_t t = start; t < end; t++)
+				{
+					clusterMisses += cache.AccessTriangle(indices, t);
+				}
+
+				float targetACMR = threshold * clusterMisses / static_cast<float>(end - start);
+
+				cache.Flush();
+				clusters.push_back(start);
+
+				uint32_t misses = 0;
+				uint32_t triangles = 0;
+				for (size_t t = start; t < end; t++)
+				{
+					misses += cache.AccessTriangle(indices, t);
+					triangles++;
+
+					if (t + 1 < end && misses <= targetACMR * triangles)
+					{
+						// Sorting may put any cluster first, so each one is measured from a cold cache
+						cache.Flush();
+						clusters.push_back(t + 1);
+						misses = 0;
+						triangles = 0;
+					}
+				}
+			}
+
+			// Area weighted centroid and normal of every cluster
+			std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+			std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+			std::vector<float> areas(clusters.size(), 0.0f);
+			glm::vec3 meshCentroid(0.0f);
+			float meshArea = 0.0f;
+
+			for (size_t c = 0; c < clusters.size(); c++)
+			{
+				size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+				for (size_t t = clusters[c]; t < end; t++)
+				{
+					const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+					const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+					const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+					// Twice the area, the factor cancels out
+					glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					float area = glm::length(normal);
+
+					centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+					normals[c] += normal;
+					areas[c] += area;
+				}
+
+				meshCentroid += centroids[c];
+				meshArea += areas[c];
+			}
+
+			if (meshArea > 0.0f)
+			{
+				meshCentroid /= meshArea;
+			}
+
+			// Clusters facing away from the center occlude the rest of the mesh more often, so they are drawn first
+			std::vector<float> sortKeys(clusters.size(), 0.0f);
+			for (size_t c = 0; c < clusters.size(); c++)
+			{
+				float normalLength = glm::length(normals[c]);
+				if (areas[c] > 0.0f && normalLength > 0.0f)
+				{
+					sortKeys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+				}
+			}
+
+			std::vector<size_t> order(clusters.size());
+			for (size_t c = 0; c < order.size(); c++)
+			{
+				order[c] = c;
+			}
+
+			std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			std::vector<uint32_t> result;
+			result.reserve(indices.size());
+			for (size_t c : order)
+			{
+				size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+				result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+			}
+
+			indices = std::move(result);
+		}
+
+		void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			std::vector<uint32_t> remap(vertices.size(), InvalidVertex);
+			std::vector<Vertex> ordered;
+			ordered.reserve(vertices.size());
+
+			for (auto& index : indices)
+			{
+				if (remap[index] == InvalidVertex)
+				{
+					remap[index] = static_cast<uint32_t>(ordered.size());
+					ordered.push_back(vertices[index]);
+				}
+
+				index = remap[index];
+			}
+
+			vertices = std::move(ordered);
+		}
+
+		MeshOptimizer::Statistics MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+		{
+			Statistics statistics;
+			statistics.Triangles = indices.size() / 3;
+
+			VertexCache cache(vertexCount, cacheSize);
+			std::vector<bool> referenced(vertexCount, false);
+			for (uint32_t index : indices)
+			{
+				statistics.Misses += cache.Access(index);
+
+				if (!referenced[index])
+				{
+					referenced[index] = true;
+					statistics.Vertices++;
+				}
+			}
+
+			return statistics;
+		}
+
+		std::vector<uint32_t> MeshOptimizer::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error)
+		{
+			HG_PROFILE_FUNCTION();
+
+			error = 0.0f;
+			uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+			std::vector<uint32_t> result(indices);
+
+			// Vertices sharing a position only differ in their attributes, the surface is simplified over the positions
+			std::vector<uint32_t> positionVertex(vertexCount);
+			std::vector<uint32_t> wedgeCount(vertexCount, 0);
+			{
+				std::unordered_map<std::string_view, uint32_t> positions;
+				positions.reserve(vertexCount);
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					std::string_view key(reinterpret_cast<const char*>(&vertices[v].Position), sizeof(glm::vec3));
+					positionVertex[v] = positions.try_emplace(key, v).first->second;
+					wedgeCount[positionVertex[v]]++;
+				}
+			}
+
+			// Moving a vertex off a border or a seam would tear the surface open or stretch the attributes across it
+			std::vector<bool> locked(vertexCount, false);
+			{
+				std::unordered_map<uint64_t, uint32_t> edges;
+				edges.reserve(result.size());
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					edges[EdgeKey(positionVertex[result[i]], positionVertex[result[NextCorner(i)]])]++;
+				}
+
+				for (const auto& [edge, count] : edges)
+				{
+					if (count != 2)
+					{
+						locked[edge >> 32] = true;
+						locked[edge & UINT32_MAX] = true;
+					}
+				}
+
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					if (wedgeCount[v] > 1)
+					{
+						locked[v] = true;
+					}
+				}
+			}
+
+			// Planes of the triangles around every position, weighted by their area
+			std::vector<Quadric> quadrics(vertexCount);
+			for (size_t t = 0; t < result.size() / 3; t++)
+			{
+				const glm::vec3& p0 = vertices[result[t * 3 + 0]].Position;
+				const glm::vec3& p1 = vertices[result[t * 3 + 1]].Position;
+				const glm::vec3& p2 = vertices[result[t * 3 + 2]].Position;
+
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float length = glm::length(normal);
+				if (length == 0.0f)
+					continue;
+
+				normal /= length;
+				float d = -glm::dot(normal, p0);
+				for (size_t k = 0; k < 3; k++)
+				{
+					quadrics[positionVertex[result[t * 3 + k]]].AddPlane(normal, d, length * 0.5f);
+				}
+			}
+
+			struct Collapse
+			{
+				// Position that moves, unlocked positions have a single vertex so it is also the vertex
+				uint32_t From;
+				// Vertex the corners of From are replaced with, the one the collapsed edge's triangle uses
+				uint32_t To;
+				double Cost;
+			};
+
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> adjacency(result.size());
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			double maxCost = 0.0;
+
+			// Each pass collapses the cheapest edges that don't share triangles, until the target is reached or nothing may move
+			while (result.size() > targetIndexCount)
+			{
+				size_t triangleCount = result.size() / 3;
+
+				collapses.clear();
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					uint32_t from = positionVertex[result[i]];
+					uint32_t to = result[NextCorner(i)];
+					if (locked[from] || from == positionVertex[to])
+						continue;
+
+					Quadric quadric = quadrics[from];
+					quadric += quadrics[positionVertex[to]];
+					collapses.push_back({ from, to, quadric.Evaluate(vertices[to].Position) });
+				}
+
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+				// Triangles around every position, in compressed rows
+				offsets.assign(vertexCount + 1, 0);
+				for (uint32_t index : result)
+				{
+					offsets[positionVertex[index] + 1]++;
+				}
+
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					offsets[v + 1] += offsets[v];
+				}
+
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					adjacency[fill[positionVertex[result[i]]]++] = static_cast<uint32_t>(i / 3);
+				}
+
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					remap[v] = v;
+				}
+
+				std::fill(touched.begin(), touched.end(), false);
+
+				size_t targetTriangleCount = targetIndexCount / 3;
+				size_t remaining = triangleCount;
+				bool collapsed = false;
+				for (const auto& collapse : collapses)
+				{
+					if (remaining <= targetTriangleCount)
+						break;
+
+					uint32_t target = positionVertex[collapse.To];
+					if (touched[collapse.From] || touched[target])
+						continue;
+
+					// Triangles that keep both corners must not turn over once From moves
+					const glm::vec3& position = vertices[collapse.To].Position;
+					bool flipped = false;
+					uint32_t removed = 0;
+					for (uint32_t a = offsets[collapse.From]; a < offsets[collapse.From + 1] && !flipped; a++)
+					{
+						size_t t = adjacency[a];
+
+						glm::vec3 corners[3];
+						glm::vec3 moved[3];
+						bool degenerate = false;
+						for (size_t k = 0; k < 3; k++)
+						{
+							uint32_t corner = positionVertex[result[t * 3 + k]];
+							corners[k] = vertices[result[t * 3 + k]].Position;
+							moved[k] = corner == collapse.From ? position : corners[k];
+							degenerate = degenerate || corner == target;
+						}
+
+						if (degenerate)
+						{
+							removed++;
+							continue;
+						}
+
+						glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+						glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+						flipped = glm::dot(before, after) <= 0.0f;
+					}
+
+					if (flipped)
+						continue;
+
+					remap[collapse.From] = collapse.To;
+					quadrics[target] += quadrics[collapse.From];
+					maxCost = std::max(maxCost, collapse.Cost);
+					remaining -= std::min<size_t>(removed, remaining);
+					collapsed = true;
+
+					// The neighbourhood stays put for the rest of the pass, so the orientation checks remain valid
+					for (uint32_t a = offsets[collapse.From]; a < offsets[collapse.From + 1]; a++)
+					{
+						for (size_t k = 0; k < 3; k++)
+						{
+							touched[positionVertex[result[adjacency[a] * 3 + k]]] = true;
+						}
+					}
+				}
+
+				if (!collapsed)
+					break;
+
+				// Triangles that lost a corner are dropped
+				size_t write = 0;
+				for (size_t t = 0; t < triangleCount; t++)
+				{
+					uint32_t i0 = remap[result[t * 3 + 0]];
+					uint32_t i1 = remap[result[t * 3 + 1]];
+					uint32_t i2 = remap[result[t * 3 + 2]];
+
+					uint32_t p0 = positionVertex[i0];
+					uint32_t p1 = positionVertex[i1];
+					uint32_t p2 = positionVertex[i2];
+					if (p0 == p1 || p1 == p2 || p0 == p2)
+						continue;
+
+					result[write++] = i0;
+					result[write++] = i1;
+					result[write++] = i2;
+				}
+
+				result.resize(write);
+			}
+
+			error = static_cast<float>(std::sqrt(maxCost));
+			return result;
+		}
+	}
+}
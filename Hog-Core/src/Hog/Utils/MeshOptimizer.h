@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Hog/Renderer/Types.h"
+
+namespace Hog
+{
+	namespace Util
+	{
+		// Reorders indexed triangle lists for the GPU without changing what they draw.
+		// Steps are meant to run in the order Optimize applies them: welding, vertex cache, overdraw and vertex fetch.
+		class MeshOptimizer
+		{
+		public:
+			struct Options
+			{
+				bool WeldVertices = true;
+				bool OptimizeVertexCache = true;
+				bool OptimizeOverdraw = true;
+				bool OptimizeVertexFetch = true;
+				// Size of the simulated post transform cache
+				uint32_t CacheSize = 16;
+				// How much worse than the vertex cache order the overdraw order may make ACMR
+				float OverdrawThreshold = 1.05f;
+			};
+
+			// Result of a FIFO post transform cache simulation, counts add up across meshes
+			struct Statistics
+			{
+				uint64_t Misses = 0;
+				uint64_t Triangles = 0;
+				uint64_t Vertices = 0;
+
+				// Average cache miss ratio, transformed vertices per triangle
+				float ACMR() const { return Triangles ? static_cast<float>(Misses) / Triangles : 0.0f; }
+				// Average transform to vertex ratio, 1 means every vertex is transformed once
+				float ATVR() const { return Vertices ? static_cast<float>(Misses) / Vertices : 0.0f; }
+
+				Statistics& operator+=(const Statistics& other)
+				{
+					Misses += other.Misses;
+					Triangles += other.Triangles;
+					Vertices += other.Vertices;
+					return *this;
+				}
+			};
+
+		public:
+			// Applies every enabled step, before and after receive the cache statistics of the input and the result
+			static void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const Options& options,
+				Statistics* before = nullptr, Statistics* after = nullptr);
+
+			// Merges bitwise identical vertices
+			static void WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+			// Tipsify ordering, fans around recently used vertices that are likely still in the cache
+			static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+			// Splits the cache ordered triangles into clusters and draws outward facing clusters first,
+			// expects the indices to be ordered by OptimizeVertexCache
+			static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, uint32_t cacheSize, float threshold);
+			// Stores vertices in the order they are first referenced, unreferenced vertices are removed
+			static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+			static Statistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+			// Quadric error edge collapse towards targetIndexCount, the result indexes the same vertices.
+			// Collapses move a vertex onto a neighbour, vertices on borders and attribute seams stay in place.
+			// error receives the object space distance the surface moved by, roughly
+			static std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error);
+		};
+	}
+}
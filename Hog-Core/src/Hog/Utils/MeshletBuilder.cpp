@@ -0,0 +1,133 @@
+#include "hgpch.h"
+#include "MeshletBuilder.h"
+
+#include <glm/glm.hpp>
+
+namespace Hog
+{
+	namespace Util
+	{
+		MeshletData MeshletBuilder::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			HG_PROFILE_FUNCTION();
+
+			MeshletData data;
+			data.Triangles.reserve(indices.size());
+
+			// Meshlet that last used every vertex and its local index there, so nothing has to be cleared between meshlets
+			std::vector<uint32_t> owners(vertices.size(), UINT32_MAX);
+			std::vector<uint8_t> localVertices(vertices.size(), 0);
+
+			Meshlet meshlet = {};
+			for (size_t t = 0; t < indices.size() / 3; t++)
+			{
+				uint32_t meshletIndex = static_cast<uint32_t>(data.Meshlets.size());
+
+				uint32_t newVertices = 0;
+				for (size_t k = 0; k < 3; k++)
+				{
+					newVertices += owners[indices[t * 3 + k]] != meshletIndex;
+				}
+
+				if (meshlet.VertexCount + newVertices > MaxVertices || meshlet.TriangleCount == MaxTriangles)
+				{
+					data.Meshlets.push_back(meshlet);
+					meshletIndex++;
+
+					meshlet = {
+						.VertexOffset = static_cast<uint32_t>(data.Vertices.size()),
+						.TriangleOffset = static_cast<uint32_t>(t),
+					};
+				}
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					uint32_t vertex = indices[t * 3 + k];
+					if (owners[vertex] != meshletIndex)
+					{
+						owners[vertex] = meshletIndex;
+						localVertices[vertex] = static_cast<uint8_t>(meshlet.VertexCount++);
+						data.Vertices.push_back(vertex);
+					}
+
+					data.Triangles.push_back(localVertices[vertex]);
+				}
+
+				meshlet.TriangleCount++;
+			}
+
+			if (meshlet.TriangleCount > 0)
+			{
+				data.Meshlets.push_back(meshlet);
+			}
+
+			for (auto& m : data.Meshlets)
+			{
+				ComputeBounds(m, data, vertices);
+			}
+
+			return data;
+		}
+
+		void MeshletBuilder::ComputeBounds(Meshlet& meshlet, const MeshletData& data, const std::vector<Vertex>& vertices)
+		{
+			// Sphere around the bounding box, like the primitive's own
+			glm::vec3 min(std::numeric_limits<float>::max());
+			glm::vec3 max(std::numeric_limits<float>::lowest());
+			for (uint32_t v = 0; v < meshlet.VertexCount; v++)
+			{
+				const glm::vec3& position = vertices[data.Vertices[meshlet.VertexOffset + v]].Position;
+				min = glm::min(min, position);
+				max = glm::max(max, position);
+			}
+
+			glm::vec3 center = (min + max) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t v = 0; v < meshlet.VertexCount; v++)
+			{
+				radius = glm::max(radius, glm::length(vertices[data.Vertices[meshlet.VertexOffset + v]].Position - center));
+			}
+
+			meshlet.BoundingSphere = glm::vec4(center, radius);
+
+			// Cone around the area weighted average of the triangle normals
+			std::vector<glm::vec3> normals;
+			normals.reserve(meshlet.TriangleCount);
+			glm::vec3 axis(0.0f);
+			for (uint32_t t = 0; t < meshlet.TriangleCount; t++)
+			{
+				const uint8_t* triangle = &data.Triangles[(meshlet.TriangleOffset + t) * 3];
+				const glm::vec3& p0 = vertices[data.Vertices[meshlet.VertexOffset + triangle[0]]].Position;
+				const glm::vec3& p1 = vertices[data.Vertices[meshlet.VertexOffset + triangle[1]]].Position;
+				const glm::vec3& p2 = vertices[data.Vertices[meshlet.VertexOffset + triangle[2]]].Position;
+
+				// Twice the area
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float length = glm::length(normal);
+				if (length == 0.0f)
+					continue;
+
+				axis += normal;
+				normals.push_back(normal / length);
+			}
+
+			float axisLength = glm::length(axis);
+			if (axisLength == 0.0f)
+			{
+				meshlet.Cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				return;
+			}
+
+			axis /= axisLength;
+
+			float minDot = 1.0f;
+			for (const auto& normal : normals)
+			{
+				minDot = glm::min(minDot, glm::dot(axis, normal));
+			}
+
+			// Normals more than 90 degrees apart always leave a triangle facing the viewer, a cutoff of 1 never culls
+			meshlet.Cone = glm::vec4(axis, minDot <= 0.0f ? 1.0f : glm::sqrt(1.0f - minDot * minDot));
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Hog/Renderer/Types.h"
+
+namespace Hog
+{
+	namespace Util
+	{
+		// Cluster of triangles small enough for one mesh shader workgroup
+		struct Meshlet
+		{
+			// Object space center in xyz and radius in w
+			glm::vec4 BoundingSphere;
+			// Average triangle normal in xyz, w is the sine of the largest angle between it and any triangle normal.
+			// The meshlet faces away from a viewer at v when dot(center - v, xyz) >= w * length(center - v) + radius
+			glm::vec4 Cone;
+			// Into MeshletData::Vertices
+			uint32_t VertexOffset;
+			uint32_t VertexCount;
+			// In triangles into MeshletData::Triangles, which is also the meshlet's first triangle in the source indices
+			uint32_t TriangleOffset;
+			uint32_t TriangleCount;
+		};
+
+		struct MeshletData
+		{
+			std::vector<Meshlet> Meshlets;
+			// Source vertex of every meshlet local vertex
+			std::vector<uint32_t> Vertices;
+			// Three meshlet local vertices per triangle
+			std::vector<uint8_t> Triangles;
+		};
+
+		class MeshletBuilder
+		{
+		public:
+			static constexpr uint32_t MaxVertices = 64;
+			static constexpr uint32_t MaxTriangles = 124;
+		public:
+			// Splits the triangles into meshlets in the order they come, so each meshlet is a contiguous range of the indices.
+			// Indices ordered by MeshOptimizer::OptimizeVertexCache keep neighbouring triangles together
+			static MeshletData Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		private:
+			static void ComputeBounds(Meshlet& meshlet, const MeshletData& data, const std::vector<Vertex>& vertices);
+		};
+	}
+}
@@ -0,0 +1,34 @@
+#include "hgpch.h"
+
+#include "Hog/Core/Input.h"
+
+namespace Hog {
+
+	// Linux only renders headless, so there is never a window to poll
+
+	bool Input::IsKeyPressed(const KeyCode key)
+	{
+		return false;
+	}
+
+	bool Input::IsMouseButtonPressed(const MouseCode button)
+	{
+		return false;
+	}
+
+	glm::vec2 Input::GetMousePosition()
+	{
+		return { 0.0f, 0.0f };
+	}
+
+	float Input::GetMouseX()
+	{
+		return GetMousePosition().x;
+	}
+
+	float Input::GetMouseY()
+	{
+		return GetMousePosition().y;
+	}
+
+}
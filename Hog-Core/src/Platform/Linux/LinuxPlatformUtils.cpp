@@ -0,0 +1,20 @@
+#include "hgpch.h"
+#include "Hog/Utils/PlatformUtils.h"
+
+namespace Hog {
+
+	// There are no native dialogs without a window, so every dialog behaves as if cancelled
+
+	std::string FileDialogs::OpenFile(const char* filter)
+	{
+		HG_CORE_WARN("File dialogs are not supported on Linux");
+		return std::string();
+	}
+
+	std::string FileDialogs::SaveFile(const char* filter)
+	{
+		HG_CORE_WARN("File dialogs are not supported on Linux");
+		return std::string();
+	}
+
+}